@@ -37,6 +37,7 @@
 #include "imageadapter.h"
 
 #include <gutil/exception.h>
+#include <gutil/misc.h>
 #include <gimage/io.h>
 #include <gimage/view.h>
 
@@ -75,6 +76,109 @@ std::string createHelpText(bool incl_view)
   return out.str();
 }
 
+/*
+ * Returns modification time and size of the given file.
+ */
+
+void getFileStamp(long long stamp[2], const std::string &name)
+{
+  stamp[0]=gutil::getFileModificationTime(name.c_str());
+  stamp[1]=gutil::getFileSize(name.c_str());
+}
+
+}
+
+/*
+ * Takes the image from the prefetch request if it is for the given file and
+ * the file has not been changed since the request has been started. Other
+ * requests are cancelled. 0 is returned if there is no suitable prefetched
+ * image or if prefetching failed.
+ */
+
+ImageAdapterBase *FileImageWindow::loadPrefetched(const std::string &name)
+{
+  ImageAdapterBase *ret=0;
+
+  if (prefetch.valid())
+  {
+    gimage::ImageFuture f=std::move(prefetch);
+
+    if (name == prefetch_name)
+    {
+      try
+      {
+        f.get();
+
+        long long stamp[2];
+        getFileStamp(stamp, name);
+
+        if (stamp[0] == prefetch_stamp[0] && stamp[1] == prefetch_stamp[1])
+        {
+          if (prefetch_u8.getDepth() > 0)
+          {
+            ret=new ImageAdapter<unsigned char>(new gimage::ImageU8(std::move(prefetch_u8)),
+                                                vmin, vmax, true);
+          }
+          else if (prefetch_u16.getDepth() > 0)
+          {
+            ret=new ImageAdapter<unsigned short>(new gimage::ImageU16(std::move(prefetch_u16)),
+                                                 vmin, vmax, true);
+          }
+          else if (prefetch_float.getDepth() > 0)
+          {
+            ret=new ImageAdapter<float>(new gimage::ImageFloat(std::move(prefetch_float)),
+                                        vmin, vmax, true);
+          }
+        }
+      }
+      catch (const gutil::Exception &)
+      {
+        // the image is loaded again synchronously for reporting the error
+      }
+    }
+    else
+    {
+      f.cancel();
+    }
+  }
+
+  prefetch_u8.setSize(0, 0, 0);
+  prefetch_u16.setSize(0, 0, 0);
+  prefetch_float.setSize(0, 0, 0);
+
+  return ret;
+}
+
+/*
+ * Starts loading the image after (or before) the given position in the
+ * background.
+ */
+
+void FileImageWindow::startPrefetch(unsigned int pos, bool down)
+{
+  prefetch=gimage::ImageFuture();
+
+  if (down)
+  {
+    pos++;
+  }
+  else
+  {
+    if (pos == 0)
+    {
+      return;
+    }
+
+    pos--;
+  }
+
+  if (pos < list.size())
+  {
+    prefetch_name=list[pos];
+    getFileStamp(prefetch_stamp, prefetch_name);
+    prefetch=gimage::getImageIO().loadAsync(prefetch_u8, prefetch_u16, prefetch_float,
+                                            prefetch_name.c_str());
+  }
 }
 
 void FileImageWindow::load(unsigned int &pos, bool down, int w, int h, bool size_max)
@@ -85,6 +189,13 @@ void FileImageWindow::load(unsigned int &pos, bool down, int w, int h, bool size
 
   while (adapt == 0 && pos < list.size())
   {
+    adapt=loadPrefetched(list[pos]);
+
+    if (adapt != 0)
+    {
+      break;
+    }
+
     gimage::ImageU8    *imageu8=0;
 
     try
@@ -212,6 +323,13 @@ void FileImageWindow::load(unsigned int &pos, bool down, int w, int h, bool size
   }
 
   updateTitle();
+
+  // load the image that is most likely requested next
+
+  if (adapt != 0)
+  {
+    startPrefetch(pos, down);
+  }
 }
 
 void FileImageWindow::updateTitle()
@@ -418,7 +536,10 @@ FileImageWindow::FileImageWindow(const std::vector<std::string> &files, int firs
 }
 
 FileImageWindow::~FileImageWindow()
-{ }
+{
+  prefetch.cancel();
+  prefetch=gimage::ImageFuture();
+}
 
 void FileImageWindow::onKey(char c, SpecialKey key, int x, int y)
 {
@@ -38,6 +38,9 @@
 
 #include "imagewindow.h"
 
+#include <gimage/image.h>
+#include <gimage/io.h>
+
 #include <string>
 #include <vector>
 #include <limits>
@@ -67,6 +70,16 @@ class FileImageWindow : public ImageWindow
     bool    watch_file;
     int     wid;
 
+    std::string        prefetch_name;
+    long long          prefetch_stamp[2];
+    gimage::ImageU8    prefetch_u8;
+    gimage::ImageU16   prefetch_u16;
+    gimage::ImageFloat prefetch_float;
+    gimage::ImageFuture prefetch;
+
+    ImageAdapterBase *loadPrefetched(const std::string &name);
+    void startPrefetch(unsigned int pos, bool down);
+
     void load(unsigned int &pos, bool down=true, int w=-1, int h=-1,
               bool size_max=false);
 
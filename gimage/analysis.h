@@ -38,9 +38,264 @@
 
 #include "image.h"
 
+#include <gutil/thread.h>
+#include <gutil/semaphore.h>
+
+#include <vector>
+
 namespace gimage
 {
 
+/*
+ * Mapping of integer valued pixels to histogram bins. Values outside the
+ * histogram are mapped to bin size().
+ */
+
+template<class T> class HistogramBins
+{
+  public:
+
+    HistogramBins(int _n, int _bs) : n(_n), bs(_bs) { }
+
+    int size() const
+    {
+      return n;
+    }
+
+    int operator()(T v) const
+    {
+      const long j=(bs == 1) ? static_cast<long>(v) : static_cast<long>(v)/bs;
+      return (j >= 0 && j < n) ? static_cast<int>(j) : n;
+    }
+
+  private:
+
+    int n, bs;
+};
+
+template<> class HistogramBins<float>
+{
+  public:
+
+    HistogramBins(int _n, int _bs) : n(_n), bs(_bs), vmax(static_cast<float>(_n)*_bs) { }
+
+    int size() const
+    {
+      return n;
+    }
+
+    int operator()(float v) const
+    {
+      return (v >= 0 && v < vmax) ? static_cast<int>(v)/bs : n;
+    }
+
+  private:
+
+    int n, bs;
+    float vmax;
+};
+
+/*
+ * Mapping of pixels to n bins that cover the range from vmin to vmax. The
+ * value vmax is counted in the last bin. Values outside the range are mapped
+ * to bin size().
+ */
+
+template<class T> class HistogramRange
+{
+  public:
+
+    HistogramRange(int _n, double _vmin, double _vmax) : n(_n), vmin(_vmin)
+    {
+      scale=0;
+
+      if (_vmax > _vmin)
+      {
+        scale=n/(_vmax-_vmin);
+      }
+    }
+
+    int size() const
+    {
+      return n;
+    }
+
+    int operator()(T v) const
+    {
+      const double f=(v-vmin)*scale;
+      return (f >= 0 && f <= n) ? std::min(static_cast<int>(f), n-1) : n;
+    }
+
+  private:
+
+    int n;
+    double vmin, scale;
+};
+
+/*
+ * Counting of pixels of one image or pixel pairs of two images into the given
+ * histogram array, which must have b1.size()*b2.size() elements. Each thread
+ * counts into a private histogram, which is added at the end.
+ */
+
+template<class T, class B> class HistogramFct : public gutil::ParallelFunction
+{
+  public:
+
+    HistogramFct(unsigned long *_val, const Image<T> &_image1, const Image<T> *_image2,
+                 const B &_b1, const B &_b2) :
+      val(_val), image1(_image1), image2(_image2), b1(_b1), b2(_b2), mutex(1)
+    { }
+
+    void run(long start, long end, long step)
+    {
+      const int w=b1.size();
+      const int h=b2.size();
+      const int n=w*h;
+
+      long width=image1.getWidth();
+      int depth=image1.getDepth();
+
+      if (image2 != 0)
+      {
+        width=std::min(width, image2->getWidth());
+        depth=std::min(depth, image2->getDepth());
+      }
+
+      // for 1D histograms, four interleaved histograms avoid that consecutive
+      // increments of the same bin depend on each other
+
+      const int m=(image2 == 0) ? 4 : 1;
+      std::vector<unsigned long> hist(m*(n+1), 0);
+
+      std::vector<const T *> p1(image1.getDepth());
+      std::vector<const T *> p2(image2 != 0 ? image2->getDepth() : 0);
+
+      for (long k=start; k<=end; k+=step)
+      {
+        for (int d=0; d<image1.getDepth(); d++)
+        {
+          p1[d]=image1.getPtr(0, k, d);
+        }
+
+        if (image2 == 0 && image1.getDepth() == 1)
+        {
+          // fast path for images with one channel
+
+          const T *p=p1[0];
+          unsigned long *hp=&hist[0];
+
+          long i=0;
+
+          while (i+4 <= width)
+          {
+            if (isValid(p+i, 4))
+            {
+              hp[b1(p[i])]++;
+              hp[n+1+b1(p[i+1])]++;
+              hp[2*(n+1)+b1(p[i+2])]++;
+              hp[3*(n+1)+b1(p[i+3])]++;
+              i+=4;
+            }
+            else
+            {
+              break;
+            }
+          }
+
+          for (; i<width; i++)
+          {
+            if (PixelTraits<T>::isValidS(p[i]))
+            {
+              hp[(i&3)*(n+1)+b1(p[i])]++;
+            }
+          }
+        }
+        else if (image2 == 0)
+        {
+          for (long i=0; i<width; i++)
+          {
+            if (isValid(p1, image1.getDepth(), i))
+            {
+              unsigned long *hp=&hist[(i&3)*(n+1)];
+
+              for (int d=0; d<depth; d++)
+              {
+                hp[b1(p1[d][i])]++;
+              }
+            }
+          }
+        }
+        else
+        {
+          for (int d=0; d<image2->getDepth(); d++)
+          {
+            p2[d]=image2->getPtr(0, k, d);
+          }
+
+          for (long i=0; i<width; i++)
+          {
+            if (isValid(p1, image1.getDepth(), i) && isValid(p2, image2->getDepth(), i))
+            {
+              for (int d=0; d<depth; d++)
+              {
+                const int i1=b1(p1[d][i]);
+                const int i2=b2(p2[d][i]);
+
+                hist[(i1 < w && i2 < h) ? i2*w+i1 : n]++;
+              }
+            }
+          }
+        }
+      }
+
+      gutil::Lock lock(mutex);
+
+      for (int j=0; j<m; j++)
+      {
+        const unsigned long *hp=&hist[j*(n+1)];
+
+        for (int i=0; i<n; i++)
+        {
+          val[i]+=hp[i];
+        }
+      }
+    }
+
+  private:
+
+    bool isValid(const T *p, int n) const
+    {
+      bool ret=true;
+
+      for (int i=0; i<n; i++)
+      {
+        ret=ret && PixelTraits<T>::isValidS(p[i]);
+      }
+
+      return ret;
+    }
+
+    bool isValid(const std::vector<const T *> &p, int depth, long i) const
+    {
+      for (int d=0; d<depth; d++)
+      {
+        if (!PixelTraits<T>::isValidS(p[d][i]))
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    unsigned long *val;
+    const Image<T> &image1;
+    const Image<T> *image2;
+    B b1, b2;
+    gutil::Semaphore mutex;
+};
+
 class Histogram
 {
   private:
@@ -79,28 +334,26 @@ class Histogram
       val=0;
       row=0;
 
-      int width=std::max(256, std::min(65536, static_cast<int>(image.maxValue())))/binsize;
+      int width=(std::max(256, std::min(65536, static_cast<int>(image.maxValue())+1))+binsize-1)/binsize;
       setSize(width, 1, binsize);
       clear();
 
-      for (int k=0; k<image.getHeight(); k++)
-      {
-        for (int i=0; i<image.getWidth(); i++)
-        {
-          if (image.isValid(i, k))
-          {
-            for (int d=0; d<image.getDepth(); d++)
-            {
-              T v=image.get(i, k, d);
+      count(image, static_cast<const Image<T> *>(0), HistogramBins<T>(w, binsize), HistogramBins<T>(1, binsize));
+    }
 
-              if (v < w*binsize+binsize-1)
-              {
-                val[static_cast<int>(v)/binsize]++;
-              }
-            }
-          }
-        }
-      }
+    // computes a histogram with the given number of bins over the range from
+    // vmin to vmax from the given image, e.g. for floating point images
+
+    template<class T> Histogram(const Image<T> &image, double vmin, double vmax, int bins)
+    {
+      w=h=bs=0;
+      val=0;
+      row=0;
+
+      setSize(bins, 1, 1);
+      clear();
+
+      count(image, static_cast<const Image<T> *>(0), HistogramRange<T>(w, vmin, vmax), HistogramRange<T>(1, 0, 1));
     }
 
     // computes a correspondence histogram of intensities from the given images
@@ -111,30 +364,28 @@ class Histogram
       val=0;
       row=0;
 
-      int width=std::max(256, std::min(65536, static_cast<int>(image1.maxValue())))/binsize;
-      int height=std::max(256, std::min(65536, static_cast<int>(image2.maxValue())))/binsize;
+      int width=(std::max(256, std::min(65536, static_cast<int>(image1.maxValue())+1))+binsize-1)/binsize;
+      int height=(std::max(256, std::min(65536, static_cast<int>(image2.maxValue())+1))+binsize-1)/binsize;
       setSize(width, height, binsize);
       clear();
 
-      for (int k=0; k<image1.getHeight() && k < image2.getHeight(); k++)
-      {
-        for (int i=0; i<image1.getWidth() && i < image2.getWidth(); i++)
-        {
-          if (image1.isValid(i, k) && image2.isValid(i, k))
-          {
-            for (int d=0; d<image1.getDepth() && d < image2.getDepth(); d++)
-            {
-              T v1=image1.get(i, k, d);
-              T v2=image2.get(i, k, d);
+      count(image1, &image2, HistogramBins<T>(w, binsize), HistogramBins<T>(h, binsize));
+    }
 
-              if (v1 < w*binsize+binsize-1 && v2 < h*binsize+binsize-1)
-              {
-                row[static_cast<int>(v2)/binsize][static_cast<int>(v1)/binsize]++;
-              }
-            }
-          }
-        }
-      }
+    // computes a correspondence histogram with the given number of bins in
+    // both dimensions over the range from vmin to vmax from the given images
+
+    template<class T> Histogram(const Image<T> &image1, const Image<T> &image2, double vmin,
+                                double vmax, int bins)
+    {
+      w=h=bs=0;
+      val=0;
+      row=0;
+
+      setSize(bins, bins, 1);
+      clear();
+
+      count(image1, &image2, HistogramRange<T>(w, vmin, vmax), HistogramRange<T>(h, vmin, vmax));
     }
 
     ~Histogram()
@@ -200,6 +451,41 @@ class Histogram
     // stores the normalized 1D or 2D histogram into the given float image
 
     void convertToImage(ImageFloat &image) const;
+
+  private:
+
+    // counts pixels of image1 or pixel pairs of image1 and image2 into the
+    // histogram, in parallel for big images
+
+    template<class T, class B> void count(const Image<T> &image1, const Image<T> *image2,
+                                          const B &b1, const B &b2)
+    {
+      if (w*h == 0)
+      {
+        return;
+      }
+
+      long height=image1.getHeight();
+
+      if (image2 != 0)
+      {
+        height=std::min(height, image2->getHeight());
+      }
+
+      HistogramFct<T, B> fct(val, image1, image2, b1, b2);
+
+      // private histograms of all threads must not use too much memory
+
+      if (static_cast<double>(image1.getWidth())*height*image1.getDepth() >= 262144 &&
+          w*h <= 4194304)
+      {
+        gutil::runParallel(fct, 0, height-1, 1);
+      }
+      else
+      {
+        fct.run(0, height-1, 1);
+      }
+    }
 };
 
 }
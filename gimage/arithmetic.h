@@ -44,21 +44,23 @@
 namespace gimage
 {
 
-template<class T> Image<T> &operator+=(Image<T> &image, typename Image<T>::work_t s)
+template<class T> const ImageView<T> &operator+=(const ImageView<T> &image, typename ImageView<T>::work_t s)
 {
+  typedef typename ImageView<T>::ptraits ptraits;
+
+  const long xs=image.getXStride();
+
   for (int d=0; d<image.getDepth(); d++)
   {
     for (long k=0; k<image.getHeight(); k++)
     {
-      for (long i=0; i<image.getWidth(); i++)
-      {
-        T v=0;
-
-        v=image.get(i, k, d);
+      T *p=image.getPtr(0, k, d);
 
-        if (image.isValidS(v))
+      for (long i=0; i<image.getWidth(); i++, p+=xs)
+      {
+        if (image.isValidS(*p))
         {
-          image.setLimited(i, k, d, v+s);
+          *p=ptraits::limit(*p+s);
         }
       }
     }
@@ -67,21 +69,30 @@ template<class T> Image<T> &operator+=(Image<T> &image, typename Image<T>::work_
   return image;
 }
 
-template<class T> Image<T> &operator-=(Image<T> &image, typename Image<T>::work_t s)
+template<class T> Image<T> &operator+=(Image<T> &image, typename Image<T>::work_t s)
 {
+  ImageView<T>(image)+=s;
+
+  return image;
+}
+
+template<class T> const ImageView<T> &operator-=(const ImageView<T> &image, typename ImageView<T>::work_t s)
+{
+  typedef typename ImageView<T>::ptraits ptraits;
+
+  const long xs=image.getXStride();
+
   for (int d=0; d<image.getDepth(); d++)
   {
     for (long k=0; k<image.getHeight(); k++)
     {
-      for (long i=0; i<image.getWidth(); i++)
-      {
-        T v=0;
-
-        v=image.get(i, k, d);
+      T *p=image.getPtr(0, k, d);
 
-        if (image.isValidS(v))
+      for (long i=0; i<image.getWidth(); i++, p+=xs)
+      {
+        if (image.isValidS(*p))
         {
-          image.setLimited(i, k, d, v-s);
+          *p=ptraits::limit(*p-s);
         }
       }
     }
@@ -90,21 +101,30 @@ template<class T> Image<T> &operator-=(Image<T> &image, typename Image<T>::work_
   return image;
 }
 
-template<class T> Image<T> &operator*=(Image<T> &image, double s)
+template<class T> Image<T> &operator-=(Image<T> &image, typename Image<T>::work_t s)
+{
+  ImageView<T>(image)-=s;
+
+  return image;
+}
+
+template<class T> const ImageView<T> &operator*=(const ImageView<T> &image, double s)
 {
+  typedef typename ImageView<T>::ptraits ptraits;
+
+  const long xs=image.getXStride();
+
   for (int d=0; d<image.getDepth(); d++)
   {
     for (long k=0; k<image.getHeight(); k++)
     {
-      for (long i=0; i<image.getWidth(); i++)
-      {
-        T v=0;
-
-        v=image.get(i, k, d);
+      T *p=image.getPtr(0, k, d);
 
-        if (image.isValidS(v))
+      for (long i=0; i<image.getWidth(); i++, p+=xs)
+      {
+        if (image.isValidS(*p))
         {
-          image.setLimited(i, k, d, static_cast<typename Image<T>::work_t>(v*s));
+          *p=ptraits::limit(static_cast<typename ImageView<T>::work_t>(*p*s));
         }
       }
     }
@@ -113,21 +133,30 @@ template<class T> Image<T> &operator*=(Image<T> &image, double s)
   return image;
 }
 
-template<class T> Image<T> &operator/=(Image<T> &image, double s)
+template<class T> Image<T> &operator*=(Image<T> &image, double s)
+{
+  ImageView<T>(image)*=s;
+
+  return image;
+}
+
+template<class T> const ImageView<T> &operator/=(const ImageView<T> &image, double s)
 {
+  typedef typename ImageView<T>::ptraits ptraits;
+
+  const long xs=image.getXStride();
+
   for (int d=0; d<image.getDepth(); d++)
   {
     for (long k=0; k<image.getHeight(); k++)
     {
-      for (long i=0; i<image.getWidth(); i++)
-      {
-        T v=0;
+      T *p=image.getPtr(0, k, d);
 
-        v=image.get(i, k, d);
-
-        if (image.isValidS(v))
+      for (long i=0; i<image.getWidth(); i++, p+=xs)
+      {
+        if (image.isValidS(*p))
         {
-          image.setLimited(i, k, d, static_cast<typename Image<T>::work_t>(v/s));
+          *p=ptraits::limit(static_cast<typename ImageView<T>::work_t>(*p/s));
         }
       }
     }
@@ -136,25 +165,41 @@ template<class T> Image<T> &operator/=(Image<T> &image, double s)
   return image;
 }
 
-template<class T> void reciprocal(Image<T> &image)
+template<class T> Image<T> &operator/=(Image<T> &image, double s)
+{
+  ImageView<T>(image)/=s;
+
+  return image;
+}
+
+template<class T> void reciprocal(const ImageView<T> &image)
 {
+  typedef typename ImageView<T>::ptraits ptraits;
+
+  const long xs=image.getXStride();
+
   for (int d=0; d<image.getDepth(); d++)
   {
     for (long k=0; k<image.getHeight(); k++)
     {
-      for (long i=0; i<image.getWidth(); i++)
-      {
-        T v=image.get(i, k, d);
+      T *p=image.getPtr(0, k, d);
 
-        if (image.isValidS(v))
+      for (long i=0; i<image.getWidth(); i++, p+=xs)
+      {
+        if (image.isValidS(*p))
         {
-          image.setLimited(i, k, d, 1/v);
+          *p=ptraits::limit(1/(*p));
         }
       }
     }
   }
 }
 
+template<class T> void reciprocal(Image<T> &image)
+{
+  reciprocal(ImageView<T>(image));
+}
+
 template<class T> Image<T> operator+(const Image<T> &image, typename Image<T>::work_t s)
 {
   Image<T> ret(image);
@@ -242,16 +287,35 @@ template<class T> void fillGammaMap(Image<T> &map, const Image<T> &image, double
 
 template<class T> void rotate180(Image<T> &image)
 {
+  const long w=image.getWidth();
+  const long h=image.getHeight();
+
   for (int j=0; j<image.getDepth(); j++)
   {
-    T *start=image.getPtr(0, 0, j);
-    T *end=start+image.getWidth()*image.getHeight()-1;
+    for (long k=0; k<h-1-k; k++)
+    {
+      T *start=image.getPtr(0, k, j);
+      T *end=image.getPtr(w-1, h-1-k, j);
+
+      for (long i=0; i<w; i++)
+      {
+        T v=start[i];
+        start[i]=end[-i];
+        end[-i]=v;
+      }
+    }
 
-    while (start < end)
+    if ((h & 1) != 0 && w > 0)
     {
-      T v=*start;
-      *start++=*end;
-      *end--=v;
+      T *start=image.getPtr(0, h/2, j);
+      T *end=start+w-1;
+
+      while (start < end)
+      {
+        T v=*start;
+        *start++=*end;
+        *end--=v;
+      }
     }
   }
 }
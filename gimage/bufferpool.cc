@@ -0,0 +1,332 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bufferpool.h"
+
+#include <gutil/semaphore.h>
+
+#include <map>
+#include <vector>
+#include <new>
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
+
+namespace gimage
+{
+
+namespace
+{
+
+const size_t alignment=64;
+
+// bytes that have been requested by the current thread from all pools
+
+thread_local size_t thread_allocated=0;
+
+/**
+ * The header is stored directly in front of the aligned buffer.
+ */
+
+struct BufferHeader
+{
+  void   *raw;
+  size_t size;
+};
+
+size_t getBucketSize(size_t size)
+{
+  if (size <= alignment)
+  {
+    return alignment;
+  }
+
+  size_t b=alignment;
+
+  while (2*b < size)
+  {
+    b*=2;
+  }
+
+  size_t step=b/8;
+
+  return (size+step-1)/step*step;
+}
+
+void *allocateAligned(size_t size)
+{
+  if (size > std::numeric_limits<size_t>::max()-alignment-sizeof(BufferHeader))
+  {
+    return 0;
+  }
+
+  char *raw=static_cast<char *>(malloc(size+alignment+sizeof(BufferHeader)));
+
+  if (raw == 0)
+  {
+    return 0;
+  }
+
+  size_t a=reinterpret_cast<size_t>(raw+sizeof(BufferHeader));
+  a=(a+alignment-1) & ~(alignment-1);
+
+  BufferHeader *header=reinterpret_cast<BufferHeader *>(a)-1;
+  header->raw=raw;
+  header->size=size;
+
+  return reinterpret_cast<void *>(a);
+}
+
+inline BufferHeader *getHeader(void *buffer)
+{
+  return reinterpret_cast<BufferHeader *>(buffer)-1;
+}
+
+inline void freeAligned(void *buffer)
+{
+  free(getHeader(buffer)->raw);
+}
+
+}
+
+struct BufferPoolData
+{
+  BufferPoolData() : mutex(1)
+  {
+    capacity=0;
+    used=0;
+    cached=0;
+    peak=0;
+    hits=0;
+    misses=0;
+  }
+
+  gutil::Semaphore mutex;
+
+  std::map<size_t, std::vector<void *> > bucket;
+
+  size_t capacity;
+  size_t used;
+  size_t cached;
+  size_t peak;
+  unsigned long hits;
+  unsigned long misses;
+
+  // must be called while holding the mutex
+
+  void reduce(size_t bytes)
+  {
+    std::map<size_t, std::vector<void *> >::reverse_iterator it=bucket.rbegin();
+
+    while (cached > bytes && it != bucket.rend())
+    {
+      while (cached > bytes && it->second.size() > 0)
+      {
+        freeAligned(it->second.back());
+        it->second.pop_back();
+        cached-=it->first;
+      }
+
+      ++it;
+    }
+  }
+};
+
+BufferPool::BufferPool()
+{
+  p=new BufferPoolData();
+
+  const char *s=std::getenv("CVKIT_BUFFER_POOL");
+
+  if (s != 0)
+  {
+    long mb=std::atol(s);
+
+    if (mb > 0)
+    {
+      p->capacity=static_cast<size_t>(mb)<<20;
+    }
+  }
+}
+
+BufferPool::~BufferPool()
+{
+  flush();
+  delete p;
+}
+
+void *BufferPool::allocate(size_t size)
+{
+  // sizes that are that large can only result from an overflow and would
+  // overflow while computing the bucket size
+
+  if (size > std::numeric_limits<size_t>::max()/2)
+  {
+    throw std::bad_alloc();
+  }
+
+  size_t bsize=getBucketSize(size);
+
+  thread_allocated+=size;
+
+  {
+    gutil::Lock lock(p->mutex);
+
+    std::map<size_t, std::vector<void *> >::iterator it=p->bucket.find(bsize);
+
+    if (it != p->bucket.end() && it->second.size() > 0)
+    {
+      void *ret=it->second.back();
+      it->second.pop_back();
+
+      p->cached-=bsize;
+      p->used+=bsize;
+      p->hits++;
+
+      return ret;
+    }
+
+    p->misses++;
+    p->used+=bsize;
+    p->peak=std::max(p->peak, p->used+p->cached);
+  }
+
+  void *ret=allocateAligned(bsize);
+
+  if (ret == 0)
+  {
+    // try again after releasing all kept buffers
+
+    flush();
+    ret=allocateAligned(bsize);
+
+    if (ret == 0)
+    {
+      gutil::Lock lock(p->mutex);
+      p->used-=bsize;
+
+      throw std::bad_alloc();
+    }
+  }
+
+  return ret;
+}
+
+void BufferPool::release(void *buffer)
+{
+  if (buffer != 0)
+  {
+    size_t bsize=getHeader(buffer)->size;
+
+    {
+      gutil::Lock lock(p->mutex);
+
+      p->used-=bsize;
+
+      if (p->cached+bsize <= p->capacity)
+      {
+        p->bucket[bsize].push_back(buffer);
+        p->cached+=bsize;
+        buffer=0;
+      }
+    }
+
+    if (buffer != 0)
+    {
+      freeAligned(buffer);
+    }
+  }
+}
+
+void BufferPool::setCapacity(size_t bytes)
+{
+  gutil::Lock lock(p->mutex);
+
+  p->capacity=bytes;
+  p->reduce(bytes);
+}
+
+size_t BufferPool::getCapacity() const
+{
+  gutil::Lock lock(p->mutex);
+
+  return p->capacity;
+}
+
+void BufferPool::flush()
+{
+  gutil::Lock lock(p->mutex);
+
+  p->reduce(0);
+  p->bucket.clear();
+}
+
+BufferPoolStatistics BufferPool::getStatistics() const
+{
+  gutil::Lock lock(p->mutex);
+
+  BufferPoolStatistics ret;
+
+  ret.hits=p->hits;
+  ret.misses=p->misses;
+  ret.used=p->used;
+  ret.cached=p->cached;
+  ret.peak=p->peak;
+
+  return ret;
+}
+
+void BufferPool::resetStatistics()
+{
+  gutil::Lock lock(p->mutex);
+
+  p->hits=0;
+  p->misses=0;
+  p->peak=p->used+p->cached;
+}
+
+size_t BufferPool::getThreadAllocated()
+{
+  return thread_allocated;
+}
+
+BufferPool &getBufferPool()
+{
+  static BufferPool *pool=new BufferPool();
+  return *pool;
+}
+
+}
@@ -0,0 +1,141 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GIMAGE_BUFFERPOOL_H
+#define GIMAGE_BUFFERPOOL_H
+
+#include <cstddef>
+
+namespace gimage
+{
+
+/**
+ * Statistics of a buffer pool.
+ */
+
+struct BufferPoolStatistics
+{
+  unsigned long hits;   /**< allocations that were served from the pool */
+  unsigned long misses; /**< allocations that required new memory */
+  size_t used;          /**< bytes that are currently handed out */
+  size_t cached;        /**< bytes that are currently kept for reuse */
+  size_t peak;          /**< maximum of used+cached bytes */
+};
+
+struct BufferPoolData;
+
+/**
+ * Pool of 64 byte aligned memory buffers. Released buffers are kept for
+ * reuse, as long as the total size of all kept buffers does not exceed the
+ * capacity. The requested sizes are rounded up to buckets with a granularity
+ * of 1/8 of the next smaller power of two, so that buffers of similar size
+ * can be exchanged.
+ *
+ * The initial capacity is 0, i.e. nothing is kept, unless the environment
+ * variable CVKIT_BUFFER_POOL defines the capacity in MB.
+ *
+ * Thread safety:
+ *
+ * All methods can be called concurrently.
+ */
+
+class BufferPool
+{
+  public:
+
+    BufferPool();
+    ~BufferPool();
+
+    /**
+     * Returns a 64 byte aligned buffer of at least the given size. Throws
+     * std::bad_alloc if the memory cannot be allocated.
+     */
+
+    void *allocate(size_t size);
+
+    /**
+     * Returns a buffer that has been allocated by this pool. A 0 pointer is
+     * ignored.
+     */
+
+    void release(void *buffer);
+
+    /**
+     * Sets the maximum number of bytes that are kept for reuse. Kept buffers
+     * are freed if necessary.
+     */
+
+    void setCapacity(size_t bytes);
+    size_t getCapacity() const;
+
+    /**
+     * Frees all buffers that are kept for reuse.
+     */
+
+    void flush();
+
+    /**
+     * Returns the current statistics. Hits, misses and the peak are counted
+     * since creation or since the last call to resetStatistics().
+     */
+
+    BufferPoolStatistics getStatistics() const;
+    void resetStatistics();
+
+    /**
+     * Returns the number of bytes that the calling thread has requested from
+     * all pools so far, regardless if they have been served from the pool.
+     */
+
+    static size_t getThreadAllocated();
+
+  private:
+
+    BufferPool(const BufferPool &);
+    BufferPool &operator=(const BufferPool &);
+
+    BufferPoolData *p;
+};
+
+/**
+ * Returns the global buffer pool that is used for the pixels of all images.
+ */
+
+BufferPool &getBufferPool();
+
+}
+
+#endif
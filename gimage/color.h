@@ -164,7 +164,7 @@ void hsvToRGB(T &red, T &green, T &blue, T maxval, float hue, float sat, float v
  */
 
 template<class T>
-void imageToGrey(Image<T> &ret, const Image<T> &image)
+void imageToGrey(Image<T> &ret, const ImageView<const T> &image)
 {
   T red, green, blue;
 
@@ -172,13 +172,19 @@ void imageToGrey(Image<T> &ret, const Image<T> &image)
 
   ret.setSize(image.getWidth(), image.getHeight(), 1);
 
+  const long xs=image.getXStride();
+
   for (long k=0; k<image.getHeight(); k++)
   {
+    const T *rp=image.getPtr(0, k, 0);
+    const T *gp=image.getPtr(0, k, 1);
+    const T *bp=image.getPtr(0, k, 2);
+
     for (long i=0; i<image.getWidth(); i++)
     {
-      red=image.get(i, k, 0);
-      green=image.get(i, k, 1);
-      blue=image.get(i, k, 2);
+      red=rp[i*xs];
+      green=gp[i*xs];
+      blue=bp[i*xs];
 
       if (image.isValidS(red) && image.isValidS(green) && image.isValidS(blue))
       {
@@ -196,7 +202,7 @@ void imageToGrey(Image<T> &ret, const Image<T> &image)
 }
 
 template<>
-inline void imageToGrey<float>(Image<float> &ret, const Image<float> &image)
+inline void imageToGrey<float>(Image<float> &ret, const ImageView<const float> &image)
 {
   float red, green, blue;
 
@@ -204,13 +210,19 @@ inline void imageToGrey<float>(Image<float> &ret, const Image<float> &image)
 
   ret.setSize(image.getWidth(), image.getHeight(), 1);
 
+  const long xs=image.getXStride();
+
   for (long k=0; k<image.getHeight(); k++)
   {
+    const float *rp=image.getPtr(0, k, 0);
+    const float *gp=image.getPtr(0, k, 1);
+    const float *bp=image.getPtr(0, k, 2);
+
     for (long i=0; i<image.getWidth(); i++)
     {
-      red=image.get(i, k, 0);
-      green=image.get(i, k, 1);
-      blue=image.get(i, k, 2);
+      red=rp[i*xs];
+      green=gp[i*xs];
+      blue=bp[i*xs];
 
       if (image.isValidS(red) && image.isValidS(green) && image.isValidS(blue))
       {
@@ -224,35 +236,42 @@ inline void imageToGrey<float>(Image<float> &ret, const Image<float> &image)
   }
 }
 
+template<class T>
+void imageToGrey(Image<T> &ret, const Image<T> &image)
+{
+  imageToGrey(ret, ImageView<const T>(image));
+}
+
 /**
  * Returns a color image from an intensity image by using the same value for R, G and B.
  */
 
 template<class T, class traits>
-void imageToColor(Image<T, traits> &ret, const Image<T, traits> &image)
+void imageToColor(Image<T, traits> &ret, const ImageView<const T, traits> &image)
 {
   assert(image.getDepth() == 1);
 
   ret.setSize(image.getWidth(), image.getHeight(), 3);
 
-  for (long k=0; k<image.getHeight(); k++)
+  for (int j=0; j<3; j++)
   {
-    for (long i=0; i<image.getWidth(); i++)
-    {
-      ret.set(i, k, 0, image.get(i, k, 0));
-      ret.set(i, k, 1, image.get(i, k, 0));
-      ret.set(i, k, 2, image.get(i, k, 0));
-    }
+    ImageView<T, traits>(ret).channel(j).copyFrom(image.channel(0));
   }
 }
 
+template<class T, class traits>
+void imageToColor(Image<T, traits> &ret, const Image<T, traits> &image)
+{
+  imageToColor(ret, ImageView<const T, traits>(image));
+}
+
 /**
  * Returns an 8 bit color image from an intensity image or from color channel 0
  * of a color image using JET color encoding.
  */
 
 template<class T>
-void imageToJET(ImageU8 &ret, const Image<T> &image, double imin=0, double imax=-1)
+void imageToJET(ImageU8 &ret, const ImageView<const T> &image, double imin=0, double imax=-1)
 {
   ret.setSize(image.getWidth(), image.getHeight(), 3);
 
@@ -299,22 +318,27 @@ void imageToJET(ImageU8 &ret, const Image<T> &image, double imin=0, double imax=
   }
 }
 
+template<class T>
+void imageToJET(ImageU8 &ret, const Image<T> &image, double imin=0, double imax=-1)
+{
+  imageToJET(ret, ImageView<const T>(image), imin, imax);
+}
+
 /**
- * Returns an image of one component of a multi-component image.
+ * Returns an image of one component of a multi-component image. Use
+ * ImageView::channel() for accessing one component without copying.
  */
 
 template<class T, class traits>
-void imageSelect(Image<T, traits> &ret, const Image<T, traits> &image, int j)
+void imageSelect(Image<T, traits> &ret, const ImageView<const T, traits> &image, int j)
 {
-  ret.setSize(image.getWidth(), image.getHeight(), 1);
+  ret.setImage(image.channel(j));
+}
 
-  for (long k=0; k<image.getHeight(); k++)
-  {
-    for (long i=0; i<image.getWidth(); i++)
-    {
-      ret.set(i, k, 0, image.get(i, k, j));
-    }
-  }
+template<class T, class traits>
+void imageSelect(Image<T, traits> &ret, const Image<T, traits> &image, int j)
+{
+  imageSelect(ret, ImageView<const T, traits>(image), j);
 }
 
 /**
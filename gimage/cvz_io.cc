@@ -0,0 +1,1067 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cvz_io.h"
+#include "size.h"
+
+#include <gutil/fixedint.h>
+#include <gutil/thread.h>
+#include <gutil/semaphore.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <limits>
+#include <cstring>
+
+#include <zlib.h>
+
+namespace gimage
+{
+
+namespace
+{
+
+/*
+ * File layout, all numbers are stored with the least significant byte
+ * first:
+ *
+ * "CVZ1"/"CVT1"    magic
+ * uint32           bytes per sample, i.e. 1 for uint8, 2 for uint16 and 4
+ *                  for float
+ * uint32           depth, width, height and tile size
+ * uint32           number of pyramid levels, only for "CVT1"
+ * uint64 [n+1]     start offset of the compressed data of all n tiles in row
+ *                  major order, followed by the end offset of the last tile
+ * ...              tile offsets of all further pyramid levels
+ * ...              compressed tiles
+ *
+ * Level 0 is the full resolution image. Level l is the image of level l-1,
+ * downscaled by 2 with downscaleImage(). There are as many levels as needed
+ * for the last level to fit into one tile.
+ *
+ * Each tile is compressed separately with zlib. The uncompressed data
+ * contains all residuals of the first color channel, followed by the
+ * residuals of the next channel, etc. The residuals of each channel are
+ * split into byte planes, beginning with the most significant byte. A
+ * residual is the difference of the sample to the prediction left+up-upleft,
+ * computed modulo 2^bits on the bit representation of samples. The
+ * neighbours outside the tile are 0. The sign of the residual is moved into
+ * the least significant bit, so that small residuals only need the lowest
+ * byte plane.
+ */
+
+const char cvz_magic[4]={'C', 'V', 'Z', '1'};
+const char cvt_magic[4]={'C', 'V', 'T', '1'};
+const long cvz_header_size=24;
+const long cvt_header_size=28;
+
+void writeU32(std::ostream &out, gutil::uint32 v)
+{
+  unsigned char b[4];
+
+  for (int i=0; i<4; i++)
+  {
+    b[i]=static_cast<unsigned char>((v>>(8*i))&0xff);
+  }
+
+  out.write(reinterpret_cast<char *>(b), 4);
+}
+
+void writeU64(std::ostream &out, gutil::uint64 v)
+{
+  unsigned char b[8];
+
+  for (int i=0; i<8; i++)
+  {
+    b[i]=static_cast<unsigned char>((v>>(8*i))&0xff);
+  }
+
+  out.write(reinterpret_cast<char *>(b), 8);
+}
+
+gutil::uint32 readU32(std::istream &in)
+{
+  unsigned char b[4];
+  gutil::uint32 ret=0;
+
+  in.read(reinterpret_cast<char *>(b), 4);
+
+  for (int i=3; i>=0; i--)
+  {
+    ret=(ret<<8)|b[i];
+  }
+
+  return ret;
+}
+
+gutil::uint64 readU64(std::istream &in)
+{
+  unsigned char b[8];
+  gutil::uint64 ret=0;
+
+  in.read(reinterpret_cast<char *>(b), 8);
+
+  for (int i=7; i>=0; i--)
+  {
+    ret=(ret<<8)|b[i];
+  }
+
+  return ret;
+}
+
+struct CVZHeader
+{
+  int  type;
+  int  depth;
+  long width, height;
+  long tile, tcols, trows;
+  int  levels;
+  std::streamoff table, data, size;
+};
+
+/*
+ * Returns the header with the size and tile table of the given pyramid
+ * level.
+ */
+
+CVZHeader getCVZLevel(const CVZHeader &header, int l)
+{
+  CVZHeader ret=header;
+
+  for (int i=0; i<l; i++)
+  {
+    ret.table+=static_cast<std::streamoff>(ret.tcols*ret.trows+1)*8;
+    ret.width=(ret.width+1)/2;
+    ret.height=(ret.height+1)/2;
+    ret.tcols=(ret.width+ret.tile-1)/ret.tile;
+    ret.trows=(ret.height+ret.tile-1)/ret.tile;
+  }
+
+  return ret;
+}
+
+void readCVZHeader(std::istream &in, CVZHeader &header, const char *name)
+{
+  char magic[4];
+
+  in.read(magic, 4);
+
+  if (memcmp(magic, cvz_magic, 4) != 0 && memcmp(magic, cvt_magic, 4) != 0)
+  {
+    throw gutil::IOException("Not a CVZ image ("+std::string(name)+")");
+  }
+
+  header.type=static_cast<int>(readU32(in));
+  header.depth=static_cast<int>(readU32(in));
+  header.width=static_cast<long>(readU32(in));
+  header.height=static_cast<long>(readU32(in));
+  header.tile=static_cast<long>(readU32(in));
+  header.levels=1;
+  header.table=cvz_header_size;
+
+  if (memcmp(magic, cvt_magic, 4) == 0)
+  {
+    header.levels=static_cast<int>(readU32(in));
+    header.table=cvt_header_size;
+  }
+
+  if ((header.type != 1 && header.type != 2 && header.type != 4) || header.depth < 1 ||
+      header.tile < 1 || header.levels < 1 ||
+      header.width > std::numeric_limits<int>::max() ||
+      header.height > std::numeric_limits<int>::max() ||
+      static_cast<double>(header.width)*header.height*header.depth*header.type >
+      static_cast<double>(std::numeric_limits<long>::max()))
+  {
+    throw gutil::IOException("Unsupported CVZ image ("+std::string(name)+")");
+  }
+
+  // a tile that is bigger than the image is the same as a tile of the size
+  // of the image
+
+  header.tile=std::min(header.tile, std::max(1l, std::max(header.width, header.height)));
+
+  header.tcols=(header.width+header.tile-1)/header.tile;
+  header.trows=(header.height+header.tile-1)/header.tile;
+
+  // the tile tables of all levels must be contained in the file and there
+  // must not be more levels than needed for the last level to fit into one
+  // tile
+
+  in.seekg(0, std::ios::end);
+  header.size=in.tellg();
+  header.data=header.table;
+
+  // zlib cannot compress data by more than a factor of about 1032
+
+  if (static_cast<double>(header.width)*header.height*header.depth*header.type >
+      1032.0*static_cast<double>(header.size))
+  {
+    throw gutil::IOException("Corrupt CVZ image ("+std::string(name)+")");
+  }
+
+  CVZHeader lheader=header;
+
+  for (int l=0; l<header.levels; l++)
+  {
+    if (l > 0)
+    {
+      if (lheader.width <= header.tile && lheader.height <= header.tile)
+      {
+        throw gutil::IOException("Corrupt CVZ image ("+std::string(name)+")");
+      }
+
+      lheader=getCVZLevel(lheader, 1);
+    }
+
+    if (lheader.tcols > 0 && lheader.trows > (header.size/8)/lheader.tcols)
+    {
+      throw gutil::IOException("Corrupt CVZ image ("+std::string(name)+")");
+    }
+
+    header.data+=static_cast<std::streamoff>(lheader.tcols*lheader.trows+1)*8;
+
+    if (header.data > header.size)
+    {
+      throw gutil::IOException("Corrupt CVZ image ("+std::string(name)+")");
+    }
+  }
+}
+
+void readCVZHeader(const char *name, CVZHeader &header)
+{
+  try
+  {
+    std::ifstream in;
+    in.exceptions(std::ios_base::failbit | std::ios_base::badbit | std::ios_base::eofbit);
+    in.open(name, std::ios::binary);
+
+    readCVZHeader(in, header, name);
+
+    in.close();
+  }
+  catch (const std::ios_base::failure &ex)
+  {
+    throw gutil::IOException(ex.what());
+  }
+}
+
+/*
+ * Unsigned integer type of the same size as the sample type, which is used
+ * for prediction.
+ */
+
+template<class T> struct CVZBits
+{
+  typedef T bits_t;
+};
+
+template<> struct CVZBits<float>
+{
+  typedef gutil::uint32 bits_t;
+};
+
+template<class T> inline typename CVZBits<T>::bits_t toBits(T v)
+{
+  typename CVZBits<T>::bits_t ret;
+  memcpy(&ret, &v, sizeof(T));
+  return ret;
+}
+
+template<class T> inline T fromBits(typename CVZBits<T>::bits_t v)
+{
+  T ret;
+  memcpy(&ret, &v, sizeof(T));
+  return ret;
+}
+
+template<class U> inline U zigzag(U v)
+{
+  U s=static_cast<U>(0-static_cast<U>(v>>(8*sizeof(U)-1)));
+  return static_cast<U>(static_cast<U>(v<<1)^s);
+}
+
+template<class U> inline U unzigzag(U v)
+{
+  U s=static_cast<U>(0-static_cast<U>(v&1));
+  return static_cast<U>(static_cast<U>(v>>1)^s);
+}
+
+/*
+ * Encodes the given window of the image into one compressed tile.
+ */
+
+template<class T> void encodeTile(std::vector<unsigned char> &out,
+                                  std::vector<unsigned char> &buffer, const Image<T> &image,
+                                  long x0, long y0, long tw, long th, int level)
+{
+  typedef typename CVZBits<T>::bits_t U;
+
+  const int  nb=static_cast<int>(sizeof(U));
+  const long n=tw*th;
+
+  buffer.resize(n*nb*image.getDepth());
+
+  for (int d=0; d<image.getDepth(); d++)
+  {
+    unsigned char *plane=&buffer[n*nb*d];
+
+    for (long k=0; k<th; k++)
+    {
+      const T *p=image.getPtr(x0, y0+k, d);
+      const T *q=(k > 0 ? image.getPtr(x0, y0+k-1, d) : 0);
+      U a=0, c=0;
+
+      for (long i=0; i<tw; i++)
+      {
+        U v=toBits(p[i]);
+        U b=(q != 0 ? toBits(q[i]) : 0);
+        U r=zigzag(static_cast<U>(v-static_cast<U>(a+b-c)));
+
+        for (int j=0; j<nb; j++)
+        {
+          plane[j*n+k*tw+i]=static_cast<unsigned char>((r>>(8*(nb-1-j)))&0xff);
+        }
+
+        a=v;
+        c=b;
+      }
+    }
+  }
+
+  // level 1 only looks for runs, which is faster and compresses the byte
+  // planes of residuals about as well as searching for matches
+
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+
+  if (deflateInit2(&strm, level, Z_DEFLATED, 15, 8,
+                   level == 1 ? Z_RLE : Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    throw gutil::IOException("Cannot initialize compression");
+  }
+
+  out.resize(deflateBound(&strm, static_cast<uLong>(buffer.size())));
+
+  strm.next_in=buffer.data();
+  strm.avail_in=static_cast<uInt>(buffer.size());
+  strm.next_out=out.data();
+  strm.avail_out=static_cast<uInt>(out.size());
+
+  int ret=deflate(&strm, Z_FINISH);
+
+  out.resize(strm.total_out);
+  deflateEnd(&strm);
+
+  if (ret != Z_STREAM_END)
+  {
+    throw gutil::IOException("Cannot compress image data");
+  }
+}
+
+/*
+ * Decodes one compressed tile of the given size.
+ */
+
+template<class T> void decodeTile(Image<T> &tile, std::vector<unsigned char> &buffer,
+                                  const std::vector<unsigned char> &data, long tw, long th,
+                                  int depth)
+{
+  typedef typename CVZBits<T>::bits_t U;
+
+  const int  nb=static_cast<int>(sizeof(U));
+  const long n=tw*th;
+
+  buffer.resize(n*nb*depth);
+
+  uLongf size=static_cast<uLongf>(buffer.size());
+
+  if (uncompress(buffer.data(), &size, data.data(), static_cast<uLong>(data.size())) != Z_OK ||
+      size != buffer.size())
+  {
+    throw gutil::IOException("Cannot decompress image data");
+  }
+
+  tile.setSize(tw, th, depth);
+
+  for (int d=0; d<depth; d++)
+  {
+    const unsigned char *plane=&buffer[n*nb*d];
+
+    for (long k=0; k<th; k++)
+    {
+      T *p=tile.getPtr(0, k, d);
+      const T *q=(k > 0 ? tile.getPtr(0, k-1, d) : 0);
+      U a=0, c=0;
+
+      for (long i=0; i<tw; i++)
+      {
+        U r=0;
+
+        for (int j=0; j<nb; j++)
+        {
+          r=static_cast<U>((r<<8)|plane[j*n+k*tw+i]);
+        }
+
+        U b=(q != 0 ? toBits(q[i]) : 0);
+        U v=static_cast<U>(unzigzag(r)+static_cast<U>(a+b-c));
+
+        p[i]=fromBits<T>(v);
+
+        a=v;
+        c=b;
+      }
+    }
+  }
+}
+
+/*
+ * Reads and decodes the tile at the given tile column and row.
+ */
+
+template<class T> void readTile(std::istream &in, Image<T> &tile,
+                                std::vector<unsigned char> &data,
+                                std::vector<unsigned char> &buffer, const CVZHeader &header,
+                                long tx, long ty, const char *name)
+{
+  in.seekg(header.table+static_cast<std::streamoff>(ty*header.tcols+tx)*8);
+
+  gutil::uint64 start=readU64(in);
+  gutil::uint64 end=readU64(in);
+
+  if (end < start || start < static_cast<gutil::uint64>(header.data) ||
+      end > static_cast<gutil::uint64>(header.size))
+  {
+    throw gutil::IOException("Corrupt CVZ image ("+std::string(name)+")");
+  }
+
+  data.resize(static_cast<size_t>(end-start));
+
+  in.seekg(static_cast<std::streamoff>(start));
+  in.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+
+  decodeTile(tile, buffer, data, std::min(header.tile, header.width-tx*header.tile),
+             std::min(header.tile, header.height-ty*header.tile), header.depth);
+}
+
+template<class T> class CVZEncodeFct : public gutil::ParallelFunction
+{
+  private:
+
+    const Image<T> &image;
+    long tile, tcols;
+    int  level;
+    std::vector<std::vector<unsigned char> > &data;
+
+    gutil::Semaphore mutex;
+    std::exception_ptr error;
+
+    CVZEncodeFct(const CVZEncodeFct<T> &);
+    CVZEncodeFct<T> &operator=(const CVZEncodeFct<T> &);
+
+  public:
+
+    CVZEncodeFct(const Image<T> &_image, long _tile, int _level,
+                 std::vector<std::vector<unsigned char> > &_data) : image(_image), tile(_tile),
+      level(_level), data(_data), mutex(1)
+    {
+      tcols=(image.getWidth()+tile-1)/tile;
+    }
+
+    void run(long start, long end, long step)
+    {
+      std::vector<unsigned char> buffer;
+
+      for (long j=start; j<=end; j+=step)
+      {
+        try
+        {
+          long x0=(j%tcols)*tile;
+          long y0=(j/tcols)*tile;
+
+          encodeTile(data[j], buffer, image, x0, y0, std::min(tile, image.getWidth()-x0),
+                     std::min(tile, image.getHeight()-y0), level);
+        }
+        catch (...)
+        {
+          gutil::Lock lock(mutex);
+
+          if (!error)
+          {
+            error=std::current_exception();
+          }
+        }
+      }
+    }
+
+    void rethrow()
+    {
+      if (error)
+      {
+        std::rethrow_exception(error);
+      }
+    }
+};
+
+/*
+ * Pyramid levels are only stored for files with the suffix .cvt.
+ */
+
+bool isCVT(const char *name)
+{
+  std::string s=name;
+
+  return s.size() > 4 && (s.rfind(".cvt") == s.size()-4 || s.rfind(".CVT") == s.size()-4);
+}
+
+inline long ceilDiv(long a, long b)
+{
+  return (a+b-1)/b;
+}
+
+/*
+ * Decodes tiles in parallel. Each work unit corresponds to one tile and
+ * computes all pixels of the downscaled image whose first source pixel is in
+ * this tile. Thus, the units do not overlap in the target image. Neighbouring
+ * tiles are decoded as well, if the downscale factor is not a divisor of the
+ * tile size.
+ */
+
+template<class T> class CVZDecodeFct : public gutil::ParallelFunction
+{
+  private:
+
+    const char *name;
+    const CVZHeader &header;
+    Image<T> &image;
+    int  ds;
+    long x, y, w, h;
+    long tx0, ty0, tx1;
+
+    gutil::Semaphore mutex;
+    std::exception_ptr error;
+
+    CVZDecodeFct(const CVZDecodeFct<T> &);
+    CVZDecodeFct<T> &operator=(const CVZDecodeFct<T> &);
+
+    void decodeUnit(std::istream &in, std::vector<Image<T> > &tile,
+                    std::vector<unsigned char> &data, std::vector<unsigned char> &buffer,
+                    std::vector<typename Image<T>::work_t> &vline, std::vector<int> &nline,
+                    long tx, long ty)
+    {
+      const long tsize=header.tile;
+      const int  depth=header.depth;
+
+      // window in target image
+
+      const long i0=std::max(std::max(0l, -x), ceilDiv(tx*tsize, ds)-x);
+      const long i1=std::min(std::min(w, ceilDiv(header.width, ds)-x),
+                             ceilDiv((tx+1)*tsize, ds)-x);
+      const long k0=std::max(std::max(0l, -y), ceilDiv(ty*tsize, ds)-y);
+      const long k1=std::min(std::min(h, ceilDiv(header.height, ds)-y),
+                             ceilDiv((ty+1)*tsize, ds)-y);
+
+      if (i0 >= i1 || k0 >= k1)
+      {
+        return;
+      }
+
+      // corresponding window in source image
+
+      const long sx0=(x+i0)*ds;
+      const long sx1=std::min(header.width, (x+i1)*ds);
+      const long sy0=(y+k0)*ds;
+      const long sy1=std::min(header.height, (y+k1)*ds);
+
+      const long ni=i1-i0;
+
+      if (ds > 1)
+      {
+        vline.assign(ni*(k1-k0)*depth, 0);
+        nline.assign(ni*(k1-k0)*depth, 0);
+      }
+
+      // decode all tiles that are needed
+
+      const long fty=sy0/tsize, ftx=sx0/tsize;
+      const long nty=(sy1-1)/tsize-fty+1, ntx=(sx1-1)/tsize-ftx+1;
+
+      if (static_cast<long>(tile.size()) < ntx*nty)
+      {
+        tile.resize(ntx*nty);
+      }
+
+      for (long ty2=0; ty2<nty; ty2++)
+      {
+        for (long tx2=0; tx2<ntx; tx2++)
+        {
+          readTile(in, tile[ty2*ntx+tx2], data, buffer, header, ftx+tx2, fty+ty2, name);
+        }
+      }
+
+      // copy or accumulate source pixels in row major order
+
+      for (int d=0; d<depth; d++)
+      {
+        for (long r=sy0; r<sy1; r++)
+        {
+          const long ty2=r/tsize-fty;
+          const long oy=r/tsize*tsize;
+
+          for (long tx2=0; tx2<ntx; tx2++)
+          {
+            const Image<T> &t=tile[ty2*ntx+tx2];
+            const long ox=(ftx+tx2)*tsize;
+            const long c0=std::max(sx0, ox);
+            const long c1=std::min(sx1, ox+t.getWidth());
+            const T *p=t.getPtr(0, r-oy, d);
+
+            if (ds == 1)
+            {
+              std::copy(p+c0-ox, p+c1-ox, image.getPtr(c0-x, r-y, d));
+            }
+            else
+            {
+              const long j=((r/ds-y-k0)*ni)*depth+d;
+
+              for (long c=c0; c<c1; c++)
+              {
+                const T v=p[c-ox];
+
+                if (image.isValidS(v))
+                {
+                  const long jj=j+(c/ds-x-i0)*depth;
+
+                  vline[jj]+=v;
+                  nline[jj]++;
+                }
+              }
+            }
+          }
+        }
+      }
+
+      // store downscaled pixels
+
+      if (ds > 1)
+      {
+        long j=0;
+
+        for (long k=k0; k<k1; k++)
+        {
+          for (long i=i0; i<i1; i++)
+          {
+            for (int d=0; d<depth; d++)
+            {
+              if (nline[j] > 0)
+              {
+                image.set(i, k, d, static_cast<typename Image<T>::store_t>(vline[j]/nline[j]));
+              }
+
+              j++;
+            }
+          }
+        }
+      }
+    }
+
+  public:
+
+    CVZDecodeFct(const char *_name, const CVZHeader &_header, Image<T> &_image, int _ds,
+                 long _x, long _y, long _w, long _h, long _tx0, long _ty0, long _tx1) :
+      name(_name), header(_header), image(_image), ds(_ds), x(_x), y(_y), w(_w), h(_h),
+      tx0(_tx0), ty0(_ty0), tx1(_tx1), mutex(1)
+    { }
+
+    void run(long start, long end, long step)
+    {
+      std::vector<Image<T> > tile;
+      std::vector<unsigned char> data, buffer;
+      std::vector<typename Image<T>::work_t> vline;
+      std::vector<int> nline;
+
+      try
+      {
+        std::ifstream in;
+        in.exceptions(std::ios_base::failbit | std::ios_base::badbit | std::ios_base::eofbit);
+        in.open(name, std::ios::binary);
+
+        const long n=tx1-tx0+1;
+
+        for (long j=start; j<=end; j+=step)
+        {
+          decodeUnit(in, tile, data, buffer, vline, nline, tx0+j%n, ty0+j/n);
+        }
+
+        in.close();
+      }
+      catch (...)
+      {
+        gutil::Lock lock(mutex);
+
+        if (!error)
+        {
+          error=std::current_exception();
+        }
+      }
+    }
+
+    void rethrow()
+    {
+      if (error)
+      {
+        std::rethrow_exception(error);
+      }
+    }
+};
+
+template<class T> void loadCVZ(Image<T> &image, const char *name, const CVZHeader &fheader,
+                               int ds, long x, long y, long w, long h)
+{
+  ds=std::max(1, ds);
+
+  // use the pyramid level with the biggest downscale factor that is a divisor
+  // of the requested factor
+
+  int l=0;
+
+  while (l+1 < fheader.levels && ds%2 == 0)
+  {
+    ds/=2;
+    l++;
+  }
+
+  const CVZHeader header=getCVZLevel(fheader, l);
+
+  if (w < 0)
+  {
+    w=(header.width+ds-1)/ds;
+  }
+
+  if (h < 0)
+  {
+    h=(header.height+ds-1)/ds;
+  }
+
+  image.setSize(w, h, header.depth);
+  image.clear();
+
+  // range of tiles that contain the first source pixel of target pixels
+
+  const long sx0=std::max(0l, x)*ds;
+  const long sx1=std::min(header.width, (x+w)*ds);
+  const long sy0=std::max(0l, y)*ds;
+  const long sy1=std::min(header.height, (y+h)*ds);
+
+  if (sx0 >= sx1 || sy0 >= sy1)
+  {
+    return;
+  }
+
+  const long tx0=sx0/header.tile;
+  const long tx1=(sx1-1)/header.tile;
+  const long ty0=sy0/header.tile;
+  const long ty1=(sy1-1)/header.tile;
+
+  try
+  {
+    CVZDecodeFct<T> fct(name, header, image, ds, x, y, w, h, tx0, ty0, tx1);
+    gutil::runParallel(fct, 0, (tx1-tx0+1)*(ty1-ty0+1)-1, 1);
+    fct.rethrow();
+  }
+  catch (const std::ios_base::failure &ex)
+  {
+    throw gutil::IOException(ex.what());
+  }
+}
+
+template<class T> void saveCVZ(const Image<T> &image, const char *name, long tile, int level,
+                               bool pyramid)
+{
+  // create pyramid levels, each from the previous one
+
+  std::vector<Image<T> > plevel;
+
+  if (pyramid)
+  {
+    const Image<T> *prev=&image;
+
+    while (prev->getWidth() > tile || prev->getHeight() > tile)
+    {
+      plevel.push_back(downscaleImage(*prev, 2));
+      prev=&plevel.back();
+    }
+  }
+
+  // compress tiles of all levels in parallel
+
+  std::vector<std::vector<std::vector<unsigned char> > > data(plevel.size()+1);
+
+  for (size_t l=0; l<data.size(); l++)
+  {
+    const Image<T> &limage=(l == 0 ? image : plevel[l-1]);
+    const long tcols=(limage.getWidth()+tile-1)/tile;
+    const long trows=(limage.getHeight()+tile-1)/tile;
+
+    data[l].resize(tcols*trows);
+
+    CVZEncodeFct<T> fct(limage, tile, level, data[l]);
+    gutil::runParallel(fct, 0, tcols*trows-1, 1);
+    fct.rethrow();
+  }
+
+  // write header, tile offsets and tiles
+
+  try
+  {
+    std::ofstream out;
+    out.exceptions(std::ios_base::failbit | std::ios_base::badbit | std::ios_base::eofbit);
+    out.open(name, std::ios::binary);
+
+    out.write(pyramid ? cvt_magic : cvz_magic, 4);
+    writeU32(out, static_cast<gutil::uint32>(sizeof(T)));
+    writeU32(out, static_cast<gutil::uint32>(image.getDepth()));
+    writeU32(out, static_cast<gutil::uint32>(image.getWidth()));
+    writeU32(out, static_cast<gutil::uint32>(image.getHeight()));
+    writeU32(out, static_cast<gutil::uint32>(tile));
+
+    gutil::uint64 pos=cvz_header_size;
+
+    if (pyramid)
+    {
+      writeU32(out, static_cast<gutil::uint32>(data.size()));
+      pos=cvt_header_size;
+    }
+
+    for (size_t l=0; l<data.size(); l++)
+    {
+      pos+=8*(data[l].size()+1);
+    }
+
+    for (size_t l=0; l<data.size(); l++)
+    {
+      for (size_t i=0; i<data[l].size(); i++)
+      {
+        writeU64(out, pos);
+        pos+=data[l][i].size();
+      }
+
+      writeU64(out, pos);
+    }
+
+    for (size_t l=0; l<data.size(); l++)
+    {
+      for (size_t i=0; i<data[l].size(); i++)
+      {
+        out.write(reinterpret_cast<const char *>(data[l][i].data()),
+                  static_cast<std::streamsize>(data[l][i].size()));
+      }
+    }
+
+    out.close();
+  }
+  catch (const std::ios_base::failure &ex)
+  {
+    throw gutil::IOException(ex.what());
+  }
+}
+}
+
+CVZImageIO::CVZImageIO(int _level, long _tile)
+{
+  setCompressionLevel(_level);
+  setTileSize(_tile);
+}
+
+BasicImageIO *CVZImageIO::create() const
+{
+  return new CVZImageIO(level, tile);
+}
+
+void CVZImageIO::setCompressionLevel(int _level)
+{
+  level=std::max(0, std::min(9, _level));
+}
+
+void CVZImageIO::setTileSize(long _tile)
+{
+  tile=std::max(1l, _tile);
+}
+
+bool CVZImageIO::handlesFile(const char *name, bool /* reading */) const
+{
+  std::string s=name;
+
+  if (s.size() <= 4)
+  {
+    return false;
+  }
+
+  if (s.rfind(".cvz") == s.size()-4 || s.rfind(".CVZ") == s.size()-4 || isCVT(name))
+  {
+    return true;
+  }
+
+  return false;
+}
+
+void CVZImageIO::loadHeader(const char *name, long &width, long &height, int &depth) const
+{
+  CVZHeader header;
+
+  if (!handlesFile(name, true))
+  {
+    throw gutil::IOException("Can only load CVZ image ("+std::string(name)+")");
+  }
+
+  readCVZHeader(name, header);
+
+  width=header.width;
+  height=header.height;
+  depth=header.depth;
+}
+
+void CVZImageIO::load(ImageU8 &image, const char *name, int ds, long x, long y, long w,
+                      long h) const
+{
+  CVZHeader header;
+
+  if (!handlesFile(name, true))
+  {
+    throw gutil::IOException("Can only load CVZ image ("+std::string(name)+")");
+  }
+
+  readCVZHeader(name, header);
+
+  if (header.type == 4)
+  {
+    throw gutil::IOException("A float image cannot be loaded as 8 bit image ("+std::string(name)+")");
+  }
+
+  if (header.type == 2)
+  {
+    throw gutil::IOException("A 16 bit image cannot be loaded as 8 bit image ("+std::string(name)+")");
+  }
+
+  loadCVZ(image, name, header, ds, x, y, w, h);
+}
+
+void CVZImageIO::load(ImageU16 &image, const char *name, int ds, long x, long y, long w,
+                      long h) const
+{
+  CVZHeader header;
+
+  if (!handlesFile(name, true))
+  {
+    throw gutil::IOException("Can only load CVZ image ("+std::string(name)+")");
+  }
+
+  readCVZHeader(name, header);
+
+  if (header.type == 4)
+  {
+    throw gutil::IOException("A float image cannot be loaded as 16 bit image ("+std::string(name)+")");
+  }
+
+  if (header.type == 2)
+  {
+    loadCVZ(image, name, header, ds, x, y, w, h);
+  }
+  else
+  {
+    ImageU8 imageu8;
+    loadCVZ(imageu8, name, header, ds, x, y, w, h);
+    image.setImageLimited(imageu8);
+  }
+}
+
+void CVZImageIO::load(ImageFloat &image, const char *name, int ds, long x, long y, long w,
+                      long h) const
+{
+  CVZHeader header;
+
+  if (!handlesFile(name, true))
+  {
+    throw gutil::IOException("Can only load CVZ image ("+std::string(name)+")");
+  }
+
+  readCVZHeader(name, header);
+
+  if (header.type == 4)
+  {
+    loadCVZ(image, name, header, ds, x, y, w, h);
+  }
+  else
+  {
+    ImageU16 imageu16;
+    load(imageu16, name, ds, x, y, w, h);
+    image.setImageLimited(imageu16);
+  }
+}
+
+void CVZImageIO::save(const ImageU8 &image, const char *name) const
+{
+  if (!handlesFile(name, false))
+  {
+    throw gutil::IOException("Can only save CVZ image ("+std::string(name)+")");
+  }
+
+  saveCVZ(image, name, tile, level, isCVT(name));
+}
+
+void CVZImageIO::save(const ImageU16 &image, const char *name) const
+{
+  if (!handlesFile(name, false))
+  {
+    throw gutil::IOException("Can only save CVZ image ("+std::string(name)+")");
+  }
+
+  saveCVZ(image, name, tile, level, isCVT(name));
+}
+
+void CVZImageIO::save(const ImageFloat &image, const char *name) const
+{
+  if (!handlesFile(name, false))
+  {
+    throw gutil::IOException("Can only save CVZ image ("+std::string(name)+")");
+  }
+
+  saveCVZ(image, name, tile, level, isCVT(name));
+}
+
+}
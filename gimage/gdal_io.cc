@@ -37,12 +37,19 @@
 #include "gdal_io.h"
 
 #include <gutil/misc.h>
+#include <gutil/thread.h>
+#include <gutil/semaphore.h>
 
 #include <gdal.h>
 #include <cpl_string.h>
 #include <ios>
 #include <valarray>
+#include <vector>
+#include <algorithm>
 #include <set>
+#include <cstdlib>
+#include <cmath>
+#include <exception>
 
 namespace gimage
 {
@@ -125,10 +132,39 @@ int getMaxBand(GDALDatasetH gd, double &mm)
 
 }
 
+namespace
+{
+
+/*
+ * Sets the size of the block cache from the environment variable
+ * CVKIT_GDAL_CACHE. Returns true if the variable is set.
+ */
+
+bool initCacheSize()
+{
+  const char *s=std::getenv("CVKIT_GDAL_CACHE");
+
+  if (s != 0)
+  {
+    GDALImageIO::setCacheSize(std::atoll(s)*1024*1024);
+    return true;
+  }
+
+  return false;
+}
+
+}
+
 GDALImageIO::GDALImageIO()
 {
   GDALAllRegister();
   CPLSetErrorHandler(customGDALErrorHandler);
+
+  // the cache is global, thus a size that is set later by the application
+  // must not be overwritten by creating further objects
+
+  static const bool cache_init=initCacheSize();
+  (void) cache_init;
 }
 
 GDALImageIO::~GDALImageIO()
@@ -141,6 +177,16 @@ BasicImageIO *GDALImageIO::create() const
   return new GDALImageIO();
 }
 
+void GDALImageIO::setCacheSize(long long size)
+{
+  GDALSetCacheMax64(static_cast<GIntBig>(std::max(0ll, size)));
+}
+
+long long GDALImageIO::getCacheSize()
+{
+  return static_cast<long long>(GDALGetCacheMax64());
+}
+
 bool GDALImageIO::handlesFile(const char *name, bool reading) const
 {
   std::string s=name;
@@ -332,6 +378,280 @@ int convertColorTable(GDALColorTableH gct, std::valarray<short> &rgba)
   return n;
 }
 
+/*
+ * Returns the index of the overview that GDAL would use for reading the
+ * window of wf x hf pixels of the band into w x h pixels with averaging,
+ * i.e. the most downsampled overview with a resolution that is lower than
+ * the requested one, or -1 for the band itself. Selecting the overview
+ * before splitting the window into strips ensures that all strips are read
+ * from the same overview.
+ */
+
+int selectOverview(GDALRasterBandH gb, long wf, long hf, long w, long h)
+{
+  const double bw=GDALGetRasterBandXSize(gb);
+  const double bh=GDALGetRasterBandYSize(gb);
+
+  double res=static_cast<double>(hf)/h;
+
+  if (static_cast<double>(wf)/w < res || h == 1)
+  {
+    res=static_cast<double>(wf)/w;
+  }
+
+  // GDAL uses a threshold of 1 for averaging, which is slightly increased
+  // against numerical instability
+
+  res*=1.01;
+
+  int ret=-1;
+  double best=0;
+  int n=GDALGetOverviewCount(gb);
+
+  for (int i=0; i<n; i++)
+  {
+    GDALRasterBandH ov=GDALGetOverview(gb, i);
+
+    if (ov == 0 || GDALGetRasterBandXSize(ov) > bw || GDALGetRasterBandYSize(ov) > bh)
+    {
+      continue;
+    }
+
+    const double fx=bw/GDALGetRasterBandXSize(ov);
+    const double fy=bh/GDALGetRasterBandYSize(ov);
+    const double f=std::min(fx, fy);
+
+    if (f < res && f > best)
+    {
+      ret=i;
+      best=f;
+    }
+  }
+
+  return ret;
+}
+
+/*
+ * Splits the h rows of the target image into strips. Target row k starts at
+ * row y0+k*r of the raster band. The boundaries of strips are the block
+ * boundaries of the raster band with blocks of bh rows. Strips contain at
+ * least 256 rows of the raster band. The target rows of strip j are
+ * strip[j] to strip[j+1]-1.
+ */
+
+void getStrips(std::vector<long> &strip, double y0, double r, long h, int bh)
+{
+  const double sh=static_cast<double>(bh)*std::max(1, (256+bh-1)/bh);
+
+  strip.clear();
+  strip.push_back(0);
+
+  while (strip.back() < h)
+  {
+    // first target row that starts after the next block boundary
+
+    const double b=(std::floor((y0+strip.back()*r)/sh)+1)*sh;
+    const long k=static_cast<long>(std::ceil((b-y0)/r));
+
+    strip.push_back(std::min(h, std::max(strip.back()+1, k)));
+  }
+}
+
+/*
+ * Reads strips of rows of the selected bands in parallel. Each thread uses
+ * its own dataset handle, except the thread that reads the first strip,
+ * which uses the dataset handle of the caller.
+ */
+
+template<class T> class GDALLoadFct : public gutil::ParallelFunction
+{
+  private:
+
+    GDALDatasetH gd;
+    const char *name;
+    GDALDataType gt;
+    Image<T> &image;
+    const std::vector<int> &band;
+    const std::valarray<short> &rgba;
+    int  rgba_count;
+    int  ds, ov;
+    long xf, yf, x, y, w;
+    double dx0, dxs, dy0, dr;
+    long ox, oy, ow, oh;
+    const std::vector<long> &strip;
+
+    gutil::Semaphore mutex;
+    std::exception_ptr error;
+
+    GDALLoadFct(const GDALLoadFct<T> &);
+    GDALLoadFct<T> &operator=(const GDALLoadFct<T> &);
+
+    /*
+     * Reads the target rows r0 to r1-1 of the given band into p. Downscaled
+     * rows are read from the selected overview with a floating point window,
+     * which gives the same source coordinates for each target row as reading
+     * all rows at once.
+     */
+
+    CPLErr readRows(GDALDatasetH sgd, int j, void *p, GDALDataType pt, int psize, long r0,
+                    long r1)
+    {
+      GDALRasterBandH gb=GDALGetRasterBand(sgd, j);
+
+      if (ds == 1)
+      {
+        return GDALRasterIO(gb, GF_Read, xf, yf+r0, w, r1-r0, p, w, r1-r0, pt, psize,
+                            w*psize);
+      }
+
+      if (ov >= 0)
+      {
+        gb=GDALGetOverview(gb, ov);
+      }
+
+      GDALRasterIOExtraArg arg;
+      INIT_RASTERIO_EXTRA_ARG(arg);
+      arg.eResampleAlg=GRIORA_Average;
+      arg.bFloatingPointWindowValidity=TRUE;
+      arg.dfXOff=dx0;
+      arg.dfXSize=dxs;
+      arg.dfYOff=dy0+r0*dr;
+      arg.dfYSize=(r1-r0)*dr;
+
+      // the integer window of a strip covers its floating point window, but
+      // is limited to the integer window of all rows, to which GDAL clips
+      // the source pixels
+
+      long iy0=oy, iy1=oy+oh;
+
+      if (r0 > 0)
+      {
+        iy0=std::max(iy0, static_cast<long>(std::floor(arg.dfYOff)));
+      }
+
+      if (r1 < static_cast<long>(strip.back()))
+      {
+        iy1=std::min(iy1, static_cast<long>(std::ceil(arg.dfYOff+arg.dfYSize)));
+      }
+
+      return GDALRasterIOEx(gb, GF_Read, ox, iy0, ow, iy1-iy0, p, w, r1-r0, pt, psize,
+                            w*psize, &arg);
+    }
+
+  public:
+
+    GDALLoadFct(GDALDatasetH _gd, const char *_name, GDALDataType _gt, Image<T> &_image,
+                const std::vector<int> &_band,
+                const std::valarray<short> &_rgba, int _rgba_count, int _ds, int _ov,
+                long _xf, long _yf, long _x, long _y, long _w, double _dx0, double _dxs,
+                double _dy0, double _dr, long _ox, long _oy, long _ow, long _oh,
+                const std::vector<long> &_strip) :
+      gd(_gd), name(_name), gt(_gt), image(_image), band(_band),
+      rgba(_rgba), rgba_count(_rgba_count), ds(_ds), ov(_ov), xf(_xf), yf(_yf), x(_x), y(_y),
+      w(_w), dx0(_dx0), dxs(_dxs), dy0(_dy0), dr(_dr), ox(_ox), oy(_oy), ow(_ow), oh(_oh),
+      strip(_strip), mutex(1)
+    { }
+
+    void run(long start, long end, long step)
+    {
+      GDALDatasetH sgd=gd;
+
+      if (start != 0)
+      {
+        sgd=GDALOpen(name, GA_ReadOnly);
+      }
+
+      try
+      {
+        if (sgd == 0)
+        {
+          throw gutil::IOException("File is not supported by GDAL ("+std::string(name)+")");
+        }
+
+        std::vector<T> p;
+        std::vector<short> pi;
+
+        for (long t=start; t<=end; t+=step)
+        {
+          const long r0=strip[t];
+          const long r1=strip[t+1];
+
+          if (rgba_count < 0)
+          {
+            p.resize(w*(r1-r0));
+
+            for (size_t d=0; d<band.size(); d++)
+            {
+              if (readRows(sgd, band[d], p.data(), gt, sizeof(T), r0, r1) >= CE_Failure)
+              {
+                std::ostringstream s;
+                s << "Cannot read raster band " << band[d]-1 << " of image (" << name << ")";
+                throw gutil::IOException(s.str());
+              }
+
+              for (long k=r0; k<r1; k++)
+              {
+                for (long i=0; i<w; i++)
+                {
+                  image.set(x+i, y+k, static_cast<int>(d), p[(k-r0)*w+i]);
+                }
+              }
+            }
+          }
+          else
+          {
+            pi.resize(w*(r1-r0));
+
+            if (readRows(sgd, 1, pi.data(), GDT_Int16, sizeof(short), r0, r1) >= CE_Failure)
+            {
+              std::ostringstream s;
+              s << "Cannot read raster band 1 of image (" << name << ") with color table";
+              throw gutil::IOException(s.str());
+            }
+
+            for (long k=r0; k<r1; k++)
+            {
+              for (long i=0; i<w; i++)
+              {
+                int j=pi[(k-r0)*w+i];
+
+                if (j >= 0 && j < rgba_count)
+                {
+                  j<<=2;
+                  image.set(x+i, y+k, 0, static_cast<T>(rgba[j++]));
+                  image.set(x+i, y+k, 1, static_cast<T>(rgba[j++]));
+                  image.set(x+i, y+k, 2, static_cast<T>(rgba[j++]));
+                }
+              }
+            }
+          }
+        }
+      }
+      catch (...)
+      {
+        gutil::Lock lock(mutex);
+
+        if (!error)
+        {
+          error=std::current_exception();
+        }
+      }
+
+      if (sgd != 0 && sgd != gd)
+      {
+        GDALClose(sgd);
+      }
+    }
+
+    void rethrow()
+    {
+      if (error)
+      {
+        std::rethrow_exception(error);
+      }
+    }
+};
+
 template<class T> void loadInternal(Image<T> &image, GDALDataType gt,
                                     const char *name, int ds, long x, long y, long w, long h)
 {
@@ -441,85 +761,86 @@ template<class T> void loadInternal(Image<T> &image, GDALDataType gt,
       hf=h*ds;
     }
 
-    // loading bands directly or via color table
+    // select bands for reading directly or via color table
 
-    GDALRasterIOExtraArg arg;
-    INIT_RASTERIO_EXTRA_ARG(arg);
-    arg.eResampleAlg=GRIORA_Average;
+    std::vector<int> band;
 
     if (rgba_count < 0)
     {
-      T *p=new T [w*h];
-      int d=0;
       int n=GDALGetRasterCount(gd);
 
       for (int j=0; j<n; j++)
       {
-        GDALRasterBandH gb=GDALGetRasterBand(gd, j+1);
-
-        if (getMaxValue(GDALGetRasterDataType(gb)) > 0)
+        if (getMaxValue(GDALGetRasterDataType(GDALGetRasterBand(gd, j+1))) > 0)
         {
-          if (GDALRasterIOEx(gb, GF_Read, xf, yf, wf, hf, p, w, h, gt,
-                           sizeof(T), w*sizeof(T), &arg) < CE_Failure)
-          {
-            for (int k=0; k<h; k++)
-            {
-              for (int i=0; i<w; i++)
-              {
-                image.set(x+i, y+k, d, p[k*w+i]);
-              }
-            }
-          }
-          else
-          {
-            delete [] p;
-
-            std::ostringstream s;
-            s << "Cannot read raster band " << j << " of image (" << name << ")";
-            throw gutil::IOException(s.str());
-          }
-
-          d++;
+          band.push_back(j+1);
         }
       }
-
-      delete [] p;
     }
     else
     {
-      short *p=new short [w*h];
+      band.push_back(1);
+    }
 
-      GDALRasterBandH gb=GDALGetRasterBand(gd, 1);
+    // downscaled images are read from the overview that GDAL would choose
+    // for the whole window, with the window in coordinates of the overview
 
-      if (GDALRasterIOEx(gb, GF_Read, xf, yf, wf, hf, p, w, h, GDT_Int16,
-                       sizeof(short), w*sizeof(short), &arg) < CE_Failure)
-      {
-        for (int k=0; k<h; k++)
-        {
-          for (int i=0; i<w; i++)
-          {
-            int j=p[k*w+i];
+    int    ov=-1;
+    double dx0=static_cast<double>(xf), dxs=static_cast<double>(wf);
+    double dy0=static_cast<double>(yf), dr=1;
+    long   ox=xf, oy=yf, ow=wf, oh=hf;
+    GDALRasterBandH gb=GDALGetRasterBand(gd, band[0]);
 
-            if (j >= 0 && j < rgba_count)
-            {
-              j<<=2;
-              image.set(x+i, y+k, 0, static_cast<T>(rgba[j++]));
-              image.set(x+i, y+k, 1, static_cast<T>(rgba[j++]));
-              image.set(x+i, y+k, 2, static_cast<T>(rgba[j++]));
-            }
-          }
-        }
-      }
-      else
+    if (ds > 1 && w > 0 && h > 0)
+    {
+      ov=selectOverview(gb, wf, hf, w, h);
+
+      double fx=1, fy=1;
+
+      if (ov >= 0)
       {
-        delete [] p;
+        GDALRasterBandH ob=GDALGetOverview(gb, ov);
 
-        std::ostringstream s;
-        s << "Cannot read raster band 1 of image (" << name << ") with color table";
-        throw gutil::IOException(s.str());
+        fx=static_cast<double>(GDALGetRasterBandXSize(gb))/GDALGetRasterBandXSize(ob);
+        fy=static_cast<double>(GDALGetRasterBandYSize(gb))/GDALGetRasterBandYSize(ob);
+        gb=ob;
       }
 
-      delete [] p;
+      dx0=xf/fx;
+      dxs=wf/fx;
+      dy0=yf/fy;
+      dr=hf/fy/h;
+
+      // integer window of all rows, rounded as GDAL does for overviews
+
+      const long bw=GDALGetRasterBandXSize(gb);
+      const long bh=GDALGetRasterBandYSize(gb);
+
+      ox=std::min(bw-1, static_cast<long>(dx0+0.5));
+      oy=std::min(bh-1, static_cast<long>(dy0+0.5));
+      ow=std::min(bw-ox, std::max(1L, static_cast<long>(dxs+0.5)));
+      oh=std::min(bh-oy, std::max(1L, static_cast<long>(h*dr+0.5)));
+    }
+
+    // split rows into strips that are aligned to the blocks of the raster
+    // band
+
+    std::vector<long> strip;
+
+    int bw=0, bh=0;
+    GDALGetBlockSize(gb, &bw, &bh);
+
+    getStrips(strip, dy0, dr, h, std::max(1, bh));
+
+    // read strips in parallel with one dataset handle per thread
+
+    if (w > 0 && h > 0)
+    {
+      GDALLoadFct<T> fct(gd, name, gt, image, band, rgba, rgba_count, ds, ov, xf, yf, x, y, w,
+                         dx0, dxs, dy0, dr, ox, oy, ow, oh, strip);
+
+      gutil::runParallel(fct, 0, static_cast<long>(strip.size())-2, 1);
+      fct.rethrow();
     }
   }
   catch (...)
@@ -554,8 +875,12 @@ void GDALImageIO::load(ImageFloat &image, const char *name, int ds, long x,
 namespace
 {
 
-template <class T> void saveInternal(const Image<T> &image, const char *name,
-                                     GDALDataType gt)
+/**
+ * Creates a new data set for storing an image with the given size and type.
+ */
+
+GDALDatasetH createDataset(const char *name, long width, long height, int depth,
+                           GDALDataType gt)
 {
   std::string s=name;
   GDALDriverH gdriver=0;
@@ -578,21 +903,29 @@ template <class T> void saveInternal(const Image<T> &image, const char *name,
 
   gp[0]=0;
 
-  if (image.getDepth() >= 3)
+  if (depth >= 3)
   {
     gp[0]=(char *) "PHOTOMETRIC=RGB";
   }
 
   gp[1]=0;
 
-  GDALDatasetH gd=GDALCreate(gdriver, name, image.getWidth(),
-                             image.getHeight(), image.getDepth(), gt, gp);
+  GDALDatasetH gd=GDALCreate(gdriver, name, width, height, depth, gt, gp);
 
   if (gd == 0)
   {
     throw gutil::IOException("Cannot save image ("+std::string(name)+")");
   }
 
+  return gd;
+}
+
+template <class T> void saveInternal(const Image<T> &image, const char *name,
+                                     GDALDataType gt)
+{
+  GDALDatasetH gd=createDataset(name, image.getWidth(), image.getHeight(), image.getDepth(),
+                                gt);
+
   try
   {
     // store image
@@ -632,6 +965,90 @@ template <class T> void saveInternal(const Image<T> &image, const char *name,
   GDALClose(gd);
 }
 
+/**
+ * Writes bands of rows into a data set with windowed raster IO. The data set
+ * is created with the first band, since it depends on the pixel type.
+ */
+
+class GDALImageWriter : public ImageWriter
+{
+  private:
+
+    std::string  name;
+    GDALDatasetH gd;
+
+    template<class T> void writeGDALRows(const Image<T> &band, long k, GDALDataType gt)
+    {
+      if (k == 0)
+      {
+        gd=createDataset(name.c_str(), getWidth(), getHeight(), getDepth(), gt);
+      }
+
+      std::vector<T> p(getWidth()*band.getHeight());
+
+      for (int d=0; d<getDepth(); d++)
+      {
+        GDALRasterBandH gb=GDALGetRasterBand(gd, d+1);
+
+        for (long j=0; j<band.getHeight(); j++)
+        {
+          const T *row=band.getPtr(0, j, d);
+          std::copy(row, row+getWidth(), p.begin()+j*getWidth());
+        }
+
+        if (GDALRasterIO(gb, GF_Write, 0, static_cast<int>(k), static_cast<int>(getWidth()),
+                         static_cast<int>(band.getHeight()), p.data(),
+                         static_cast<int>(getWidth()), static_cast<int>(band.getHeight()), gt,
+                         sizeof(T), getWidth()*sizeof(T)) >= CE_Failure)
+        {
+          throw gutil::IOException("Cannot save image ("+name+")");
+        }
+      }
+    }
+
+  public:
+
+    GDALImageWriter(const char *_name, long width, long height, int depth) :
+      ImageWriter(width, height, depth), name(_name)
+    {
+      gd=0;
+    }
+
+    ~GDALImageWriter()
+    {
+      if (gd != 0)
+      {
+        GDALClose(gd);
+      }
+    }
+
+  protected:
+
+    void writeRows(const ImageU8 &band, long k)
+    {
+      writeGDALRows(band, k, GDT_Byte);
+    }
+
+    void writeRows(const ImageU16 &band, long k)
+    {
+      writeGDALRows(band, k, GDT_UInt16);
+    }
+
+    void writeRows(const ImageFloat &band, long k)
+    {
+      writeGDALRows(band, k, GDT_Float32);
+    }
+
+    void finish()
+    {
+      if (gd != 0)
+      {
+        GDALClose(gd);
+        gd=0;
+      }
+    }
+};
+
 }
 
 void GDALImageIO::save(const ImageU8 &image, const char *name) const
@@ -649,4 +1066,15 @@ void GDALImageIO::save(const ImageFloat &image, const char *name) const
   saveInternal(image, name, GDT_Float32);
 }
 
+ImageWriter *GDALImageIO::openWriter(const char *name, long width, long height,
+                                     int depth) const
+{
+  if (!handlesFile(name, false))
+  {
+    throw gutil::IOException("Saving is only supported as TIF ("+std::string(name)+")");
+  }
+
+  return new GDALImageWriter(name, width, height, depth);
+}
+
 }
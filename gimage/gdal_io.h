@@ -70,6 +70,23 @@ class GDALImageIO : public BasicImageIO
     void save(const ImageU8 &image, const char *name) const;
     void save(const ImageU16 &image, const char *name) const;
     void save(const ImageFloat &image, const char *name) const;
+
+    /**
+     * Images are read in bands by loading windows of the raster. Writing in
+     * bands is supported for TIFF.
+     */
+
+    ImageWriter *openWriter(const char *name, long width, long height, int depth) const;
+
+    /**
+     * Sets the maximum size of the block cache of GDAL in bytes. The cache
+     * is shared by all GDAL datasets. The initial size can also be given in
+     * MB by the environment variable CVKIT_GDAL_CACHE, which is read when
+     * the first GDALImageIO object is created.
+     */
+
+    static void setCacheSize(long long size);
+    static long long getCacheSize();
 };
 
 }
@@ -37,6 +37,8 @@
 #ifndef GIMAGE_IMAGE_H
 #define GIMAGE_IMAGE_H
 
+#include "bufferpool.h"
+
 #include <gutil/fixedint.h>
 
 #include <limits>
@@ -47,7 +49,9 @@
 #include <cmath>
 #include <vector>
 #include <utility>
+#include <type_traits>
 #include <exception>
+#include <new>
 
 #include <iostream>
 
@@ -124,8 +128,14 @@ struct PixelTraits<float>
   static inline bool isValidS(store_t v)  { return std::isfinite(v); }
 };
 
+template<class T, class traits=PixelTraits<typename std::remove_const<T>::type> >
+class ImageView;
+
 /**
  * Definition of an image.
+ *
+ * The pixels are stored in one 64 byte aligned buffer, layer after layer and
+ * row after row, without gaps between rows.
  */
 
 template<class T, class traits=PixelTraits<T> > class Image
@@ -135,8 +145,26 @@ template<class T, class traits=PixelTraits<T> > class Image
     int  depth;
     long width, height, n;
     T    *pixel;
-    T    **row;
-    T ** *img;
+
+    /**
+     * Allocation of aligned memory for n pixels through the global buffer
+     * pool, which may reuse buffers of released images.
+     */
+
+    static T *allocPixels(long n)
+    {
+      return static_cast<T *>(getBufferPool().allocate(n*sizeof(T)));
+    }
+
+    static void freePixels(T *p)
+    {
+      getBufferPool().release(p);
+    }
+
+    long offset(long i, long k, int j) const
+    {
+      return (j*height+k)*width+i;
+    }
 
   public:
 
@@ -151,8 +179,6 @@ template<class T, class traits=PixelTraits<T> > class Image
       height=0;
       n=0;
       pixel=0;
-      row=0;
-      img=0;
 
       setSize(w, h, d);
     }
@@ -164,8 +190,6 @@ template<class T, class traits=PixelTraits<T> > class Image
       height=0;
       n=0;
       pixel=0;
-      row=0;
-      img=0;
 
       setSize(a.getWidth(), a.getHeight(), a.getDepth());
 
@@ -179,16 +203,12 @@ template<class T, class traits=PixelTraits<T> > class Image
       height=a.height;
       n=a.n;
       pixel=a.pixel;
-      row=a.row;
-      img=a.img;
 
       a.depth=0;
       a.width=0;
       a.height=0;
       a.n=0;
       a.pixel=0;
-      a.row=0;
-      a.img=0;
     }
 
     /**
@@ -204,32 +224,11 @@ template<class T, class traits=PixelTraits<T> > class Image
       width=w;
       height=h;
       n=-width*height*depth; // negative n means managing foreign memory
-
       pixel=0;
-      row=0;
-      img=0;
 
       if (n < 0)
       {
-        long m=height*depth;
-
         pixel=p;
-        row=new T*[m];
-        img=new T **[depth];
-
-        row[0]=pixel;
-
-        for (long k=1; k<m; k++)
-        {
-          row[k]=row[k-1]+width;
-        }
-
-        img[0]=row;
-
-        for (int j=1; j<depth; j++)
-        {
-          img[j]=img[j-1]+height;
-        }
       }
     }
 
@@ -237,13 +236,15 @@ template<class T, class traits=PixelTraits<T> > class Image
     {
       if (n >= 0)
       {
-        delete [] pixel;
+        freePixels(pixel);
       }
-
-      delete [] row;
-      delete [] img;
     }
 
+    /**
+      Sets the size of the image. The content of the image is undefined
+      afterwards.
+    */
+
     void setSize(long w, long h, long d)
     {
       if (width != w || height != h || depth != d)
@@ -253,51 +254,26 @@ template<class T, class traits=PixelTraits<T> > class Image
           throw std::runtime_error("Cannot change size, because image is used as a wrapper");
         }
 
-        if (pixel != 0)
-        {
-          delete [] pixel;
-        }
+        // reject negative sizes and sizes that would overflow
 
-        if (row != 0)
+        if (w < 0 || h < 0 || d < 0 ||
+            static_cast<double>(w)*h*d*sizeof(T) >
+            static_cast<double>(std::numeric_limits<size_t>::max()/2))
         {
-          delete [] row;
+          throw std::bad_alloc();
         }
 
-        if (img != 0)
-        {
-          delete [] img;
-        }
+        freePixels(pixel);
 
         depth=d;
         width=w;
         height=h;
         n=width*height*depth;
-
         pixel=0;
-        row=0;
-        img=0;
 
         if (n > 0)
         {
-          long m=height*depth;
-
-          pixel=new T[n];
-          row=new T*[m];
-          img=new T **[depth];
-
-          row[0]=pixel;
-
-          for (long k=1; k<m; k++)
-          {
-            row[k]=row[k-1]+width;
-          }
-
-          img[0]=row;
-
-          for (int j=1; j<depth; j++)
-          {
-            img[j]=img[j-1]+height;
-          }
+          pixel=allocPixels(n);
         }
       }
     }
@@ -318,8 +294,6 @@ template<class T, class traits=PixelTraits<T> > class Image
       std::swap(height, a.height);
       std::swap(n, a.n);
       std::swap(pixel, a.pixel);
-      std::swap(row, a.row);
-      std::swap(img, a.img);
 
       return *this;
     }
@@ -345,11 +319,7 @@ template<class T, class traits=PixelTraits<T> > class Image
       }
       else
       {
-        long pn=std::abs(n);
-        for (long i=0; i<pn; i++)
-        {
-          pixel[i]=inv;
-        }
+        *this=inv;
       }
     }
 
@@ -368,6 +338,26 @@ template<class T, class traits=PixelTraits<T> > class Image
       return depth;
     }
 
+    /**
+      Returns the number of store_t elements from the start of one row to
+      the start of the next row, which is always the width.
+    */
+
+    long getRowStride() const
+    {
+      return width;
+    }
+
+    /**
+      Returns the number of store_t elements from the start of one layer to
+      the start of the next layer.
+    */
+
+    long getPlaneStride() const
+    {
+      return width*height;
+    }
+
     const char *getTypeDescription() const
     {
       return ptraits::description();
@@ -385,9 +375,11 @@ template<class T, class traits=PixelTraits<T> > class Image
 
     bool isValid(long i, long k) const
     {
+      const T *p=pixel+offset(i, k, 0);
+
       for (int j=0; j<depth; j++)
       {
-        if (!isValidS(img[j][k][i]))
+        if (!isValidS(p[j*width*height]))
         {
           return false;
         }
@@ -417,23 +409,24 @@ template<class T, class traits=PixelTraits<T> > class Image
       fast, direct access.
 
       Increment for next pixel in same row: 1
-      Increment for pixel in next row is: getWidth()
-      Increment for same pixel in next color channel: getWidth()*getHeight()
+      Increment for pixel in next row is: getRowStride(), i.e. getWidth()
+      Increment for same pixel in next color channel: getPlaneStride(), i.e.
+      getWidth()*getHeight()
     */
 
     T *getPtr(long i, long k, int j=0) const
     {
-      return &(img[j][k][i]);
+      return pixel+offset(i, k, j);
     }
 
     store_t get(long i, long k, int j=0) const
     {
-      return img[j][k][i];
+      return pixel[offset(i, k, j)];
     }
 
     work_t getW(long i, long k, int j=0) const
     {
-      return static_cast<work_t>(img[j][k][i]);
+      return static_cast<work_t>(pixel[offset(i, k, j)]);
     }
 
     /**
@@ -452,7 +445,7 @@ template<class T, class traits=PixelTraits<T> > class Image
       j=std::max(0, j);
       j=std::min(depth-1, j);
 
-      return static_cast<work_t>(img[j][k][i]);
+      return static_cast<work_t>(pixel[offset(i, k, j)]);
     }
 
     void getBounds(std::vector<work_t> &p, long i, long k) const
@@ -465,7 +458,7 @@ template<class T, class traits=PixelTraits<T> > class Image
 
       for (int j=0; j<depth; j++)
       {
-        p[j]=static_cast<work_t>(img[j][k][i]);
+        p[j]=static_cast<work_t>(pixel[offset(i, k, j)]);
       }
     }
 
@@ -480,7 +473,7 @@ template<class T, class traits=PixelTraits<T> > class Image
 
       if (j >= 0 && j < depth && i >= 0 && i < width && k >= 0 && k < height)
       {
-        ret=static_cast<work_t>(img[j][k][i]);
+        ret=static_cast<work_t>(pixel[offset(i, k, j)]);
       }
 
       return ret;
@@ -492,7 +485,7 @@ template<class T, class traits=PixelTraits<T> > class Image
       {
         for (int j=0; j<depth; j++)
         {
-          p[j]=static_cast<work_t>(img[j][k][i]);
+          p[j]=static_cast<work_t>(pixel[offset(i, k, j)]);
         }
       }
       else
@@ -548,10 +541,12 @@ template<class T, class traits=PixelTraits<T> > class Image
       x-=i;
       y-=k;
 
-      p0=img[j][k][i];
-      p1=img[j][k][i+1];
-      p2=img[j][k+1][i];
-      p3=img[j][k+1][i+1];
+      const T *p=pixel+offset(i, k, j);
+
+      p0=p[0];
+      p1=p[1];
+      p2=p[width];
+      p3=p[width+1];
 
       if (isValidS(p0) && isValidS(p1) && isValidS(p2) && isValidS(p3))
       {
@@ -611,10 +606,12 @@ template<class T, class traits=PixelTraits<T> > class Image
       {
         p[j]=ptraits::invalid();
 
-        p0=img[j][k][i];
-        p1=img[j][k][i+1];
-        p2=img[j][k+1][i];
-        p3=img[j][k+1][i+1];
+        const T *v=pixel+offset(i, k, j);
+
+        p0=v[0];
+        p1=v[1];
+        p2=v[width];
+        p3=v[width+1];
 
         if (isValidS(p0) && isValidS(p1) && isValidS(p2) && isValidS(p3))
         {
@@ -651,7 +648,7 @@ template<class T, class traits=PixelTraits<T> > class Image
 
         for (int kk=0; kk<4; kk++)
         {
-          const T *p=img[j][k-1+kk]+i-1;
+          const T *p=pixel+offset(i-1, k-1+kk, j);
 
           if (!isValidS(p[0]) || !isValidS(p[1]) || !isValidS(p[2]) || !isValidS(p[3]))
           {
@@ -712,7 +709,7 @@ template<class T, class traits=PixelTraits<T> > class Image
 
           for (int kk=0; kk<4; kk++)
           {
-            const T *v=img[j][k-1+kk]+i-1;
+            const T *v=pixel+offset(i-1, k-1+kk, j);
 
             if (!isValidS(v[0]) || !isValidS(v[1]) || !isValidS(v[2]) || !isValidS(v[3]))
             {
@@ -776,12 +773,12 @@ template<class T, class traits=PixelTraits<T> > class Image
 
     void set(long i, long k, int j, store_t v)
     {
-      img[j][k][i]=v;
+      pixel[offset(i, k, j)]=v;
     }
 
     void setLimited(long i, long k, int j, work_t v)
     {
-      img[j][k][i]=ptraits::limit(v);
+      pixel[offset(i, k, j)]=ptraits::limit(v);
     }
 
     template<class S> void setImageLimited(const Image<S> &a)
@@ -790,10 +787,15 @@ template<class T, class traits=PixelTraits<T> > class Image
 
       for (int j=0; j<depth; j++)
         for (long k=0; k<height; k++)
+        {
+          const S *ap=a.getPtr(0, k, j);
+          T *p=pixel+offset(0, k, j);
+
           for (long i=0; i<width; i++)
           {
-            img[j][k][i]=ptraits::limit(static_cast<work_t>(a.get(i, k, j)));
+            p[i]=ptraits::limit(static_cast<work_t>(ap[i]));
           }
+        }
     }
 
     template<class S> void setImage(const Image<S> &a)
@@ -802,21 +804,31 @@ template<class T, class traits=PixelTraits<T> > class Image
 
       for (int j=0; j<depth; j++)
         for (long k=0; k<height; k++)
+        {
+          const S *ap=a.getPtr(0, k, j);
+          T *p=pixel+offset(0, k, j);
+
           for (long i=0; i<width; i++)
           {
-            img[j][k][i]=static_cast<store_t>(a.get(i, k, j));
+            p[i]=static_cast<store_t>(ap[i]);
           }
+        }
     }
 
     void setImage(const Image<T> &a)
+    {
+      *this=a;
+    }
+
+    void setImage(const ImageView<const T, traits> &a)
     {
       setSize(a.getWidth(), a.getHeight(), a.getDepth());
-      memcpy(pixel, a.getPtr(0, 0, 0), std::abs(n)*sizeof(T));
+      ImageView<T, traits>(*this).copyFrom(a);
     }
 
     void setInvalid(long i, long k, long j)
     {
-      img[j][k][i]=ptraits::limit(ptraits::invalid());
+      pixel[offset(i, k, j)]=ptraits::limit(ptraits::invalid());
     }
 
     /**
@@ -834,7 +846,7 @@ template<class T, class traits=PixelTraits<T> > class Image
           for (long i=0; i<width; i++)
             for (int j=0; j<depth; j++)
             {
-              img[j][k][i]=*p++;
+              pixel[offset(i, k, j)]=*p++;
             }
       }
       else
@@ -851,7 +863,7 @@ template<class T, class traits=PixelTraits<T> > class Image
           for (long i=0; i<width; i++)
             for (int j=0; j<depth; j++)
             {
-              *p++=img[j][k][i];
+              *p++=pixel[offset(i, k, j)];
             }
       }
       else
@@ -861,6 +873,413 @@ template<class T, class traits=PixelTraits<T> > class Image
     }
 };
 
+/**
+ * Definition of a view onto the pixels of an image or onto foreign memory.
+ * A view does not own the pixels and must not be used after the underlying
+ * memory has been released or resized. Creating a view of a part of an
+ * image or of one color channel does not copy any pixels.
+ *
+ * A pixel at row k and column i of depth layer j is expected at
+ * p[j*getPlaneStride()+k*getRowStride()+i*getXStride()]. Views that are
+ * created from an Image always have an x stride of 1.
+ *
+ * ImageView<const T> is a read-only view. It is the only view that can be
+ * created from a const Image. A view can be converted into a read-only view,
+ * but not vice versa.
+ */
+
+template<class T, class traits> class ImageView
+{
+  private:
+
+    T    *pixel;
+    long width, height;
+    int  depth;
+    long xstride, ystride, dstride;
+
+    template<class S> void init(S &image)
+    {
+      pixel=image.getPtr(0, 0, 0);
+      width=image.getWidth();
+      height=image.getHeight();
+      depth=image.getDepth();
+      xstride=1;
+      ystride=image.getRowStride();
+      dstride=image.getPlaneStride();
+    }
+
+  public:
+
+    typedef traits                   ptraits;
+    typedef typename std::remove_const<T>::type store_t; /**< store type for pixels */
+    typedef typename ptraits::work_t work_t;  /**< work type for pixels */
+
+    ImageView()
+    {
+      pixel=0;
+      width=0;
+      height=0;
+      depth=0;
+      xstride=1;
+      ystride=0;
+      dstride=0;
+    }
+
+    /**
+      Creates a view onto foreign memory with the given strides, which are
+      counted in store_t elements. E.g. an interleaved RGB image has xs=3,
+      ys=3*w and ds=1.
+    */
+
+    ImageView(T *p, long w, long h, int d, long xs, long ys, long ds)
+    {
+      pixel=p;
+      width=w;
+      height=h;
+      depth=d;
+      xstride=xs;
+      ystride=ys;
+      dstride=ds;
+    }
+
+    /**
+      Creates a view onto the full image.
+    */
+
+    ImageView(Image<store_t, traits> &image)
+    {
+      init(image);
+    }
+
+    ImageView(const Image<store_t, traits> &image)
+    {
+      static_assert(std::is_const<T>::value,
+                    "A view onto a const image must be an ImageView<const T>");
+
+      init(image);
+    }
+
+    /**
+      Creates a view onto a part of the image, which must be completely
+      inside the image.
+    */
+
+    ImageView(Image<store_t, traits> &image, long x, long y, long w, long h)
+    {
+      *this=ImageView(image).crop(x, y, w, h);
+    }
+
+    ImageView(const Image<store_t, traits> &image, long x, long y, long w, long h)
+    {
+      *this=ImageView(image).crop(x, y, w, h);
+    }
+
+    /**
+      Converts a view into a read-only view. For views that are not
+      read-only, this is the copy constructor.
+    */
+
+    ImageView(const ImageView<store_t, traits> &a)
+    {
+      pixel=a.getPtr(0, 0, 0);
+      width=a.getWidth();
+      height=a.getHeight();
+      depth=a.getDepth();
+      xstride=a.getXStride();
+      ystride=a.getRowStride();
+      dstride=a.getPlaneStride();
+    }
+
+    ImageView &operator=(const ImageView &a)=default;
+
+    /**
+      Returns a view onto a part of this view, which must be completely inside.
+    */
+
+    ImageView crop(long x, long y, long w, long h) const
+    {
+      if (x < 0 || y < 0 || w < 0 || h < 0 || x+w > width || y+h > height)
+      {
+        throw std::runtime_error("Cannot create view, because the region is outside of the image");
+      }
+
+      return ImageView(pixel+y*ystride+x*xstride, w, h, depth, xstride, ystride, dstride);
+    }
+
+    /**
+      Returns a single channel view onto the given color channel.
+    */
+
+    ImageView channel(int j) const
+    {
+      if (j < 0 || j >= depth)
+      {
+        throw std::runtime_error("Cannot create view, because the channel does not exist");
+      }
+
+      return ImageView(pixel+j*dstride, width, height, 1, xstride, ystride, dstride);
+    }
+
+    long getWidth() const
+    {
+      return width;
+    }
+
+    long getHeight() const
+    {
+      return height;
+    }
+
+    int getDepth() const
+    {
+      return depth;
+    }
+
+    long getXStride() const
+    {
+      return xstride;
+    }
+
+    long getRowStride() const
+    {
+      return ystride;
+    }
+
+    long getPlaneStride() const
+    {
+      return dstride;
+    }
+
+    const char *getTypeDescription() const
+    {
+      return ptraits::description();
+    }
+
+    bool isValidS(store_t v) const
+    {
+      return ptraits::isValidS(v);
+    }
+
+    bool isValidW(work_t v) const
+    {
+      return ptraits::isValidW(v);
+    }
+
+    bool isValid(long i, long k) const
+    {
+      const T *p=getPtr(i, k, 0);
+
+      for (int j=0; j<depth; j++)
+      {
+        if (!isValidS(p[j*dstride]))
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    /**
+      Returns the pointer to the pixel at the given position. The increments
+      for the next pixel, row and color channel are getXStride(),
+      getRowStride() and getPlaneStride().
+    */
+
+    T *getPtr(long i, long k, int j=0) const
+    {
+      return pixel+j*dstride+k*ystride+i*xstride;
+    }
+
+    store_t get(long i, long k, int j=0) const
+    {
+      return *getPtr(i, k, j);
+    }
+
+    work_t getW(long i, long k, int j=0) const
+    {
+      return static_cast<work_t>(*getPtr(i, k, j));
+    }
+
+    work_t getBoundsInv(long i, long k, int j=0) const
+    {
+      work_t ret=ptraits::invalid();
+
+      if (j >= 0 && j < depth && i >= 0 && i < width && k >= 0 && k < height)
+      {
+        ret=static_cast<work_t>(*getPtr(i, k, j));
+      }
+
+      return ret;
+    }
+
+    /**
+     * Access with out-of-bound check (returns the nearest
+     * valid neighbor, if out-of-bounds, and returns invalid,
+     * if one if the four neighbors are invalid)
+     */
+
+    void getBilinear(std::vector<work_t> &p, float x, float y) const
+    {
+      long    i, k;
+      store_t p0, p1, p2, p3;
+
+      x-=0.5f;
+      y-=0.5f;
+
+      if (x < 0)
+      {
+        x=0;
+      }
+
+      if (y < 0)
+      {
+        y=0;
+      }
+
+      if (x >= width-1)
+      {
+        x=width-1.001f;
+      }
+
+      if (y >= height-1)
+      {
+        y=height-1.001f;
+      }
+
+      i=static_cast<long>(x);
+      k=static_cast<long>(y);
+
+      x-=i;
+      y-=k;
+
+      x*=4;
+      y*=4;
+
+      const float s0=(4-x)*(4-y);
+      const float s1=x*(4-y);
+      const float s2=(4-x)*y;
+      const float s3=x*y;
+
+      for (int j=0; j<depth; j++)
+      {
+        p[j]=ptraits::invalid();
+
+        const T *v=getPtr(i, k, j);
+
+        p0=v[0];
+        p1=v[xstride];
+        p2=v[ystride];
+        p3=v[ystride+xstride];
+
+        if (isValidS(p0) && isValidS(p1) && isValidS(p2) && isValidS(p3))
+        {
+          p[j]=static_cast<work_t>((p0*s0+p1*s1+p2*s2+p3*s3)/16);
+        }
+      }
+    }
+
+    work_t absMinValue() const
+    {
+      return ptraits::minValue();
+    }
+
+    work_t absMaxValue() const
+    {
+      return ptraits::maxValue();
+    }
+
+    work_t minValue() const
+    {
+      work_t ret=ptraits::maxValue();
+
+      for (int j=0; j<depth; j++)
+        for (long k=0; k<height; k++)
+        {
+          const T *p=getPtr(0, k, j);
+
+          for (long i=0; i<width; i++)
+          {
+            if (isValidS(p[i*xstride]))
+            {
+              ret=std::min(ret, static_cast<work_t>(p[i*xstride]));
+            }
+          }
+        }
+
+      return ret;
+    }
+
+    work_t maxValue() const
+    {
+      work_t ret=ptraits::minValue();
+
+      for (int j=0; j<depth; j++)
+        for (long k=0; k<height; k++)
+        {
+          const T *p=getPtr(0, k, j);
+
+          for (long i=0; i<width; i++)
+          {
+            if (isValidS(p[i*xstride]))
+            {
+              ret=std::max(ret, static_cast<work_t>(p[i*xstride]));
+            }
+          }
+        }
+
+      return ret;
+    }
+
+    void set(long i, long k, int j, store_t v) const
+    {
+      *getPtr(i, k, j)=v;
+    }
+
+    void setLimited(long i, long k, int j, work_t v) const
+    {
+      *getPtr(i, k, j)=ptraits::limit(v);
+    }
+
+    void setInvalid(long i, long k, long j) const
+    {
+      *getPtr(i, k, j)=ptraits::limit(ptraits::invalid());
+    }
+
+    /**
+      Copies the content of the given view into this view, which must have
+      the same size and depth.
+    */
+
+    void copyFrom(const ImageView<const store_t, traits> &a) const
+    {
+      if (a.getWidth() != width || a.getHeight() != height || a.getDepth() != depth)
+      {
+        throw std::runtime_error("Cannot copy view, because the size or depth is different");
+      }
+
+      for (int j=0; j<depth; j++)
+        for (long k=0; k<height; k++)
+        {
+          T *p=getPtr(0, k, j);
+          const store_t *ap=a.getPtr(0, k, j);
+          const long axstride=a.getXStride();
+
+          if (xstride == 1 && axstride == 1)
+          {
+            memcpy(p, ap, width*sizeof(T));
+          }
+          else
+          {
+            for (long i=0; i<width; i++)
+            {
+              p[i*xstride]=ap[i*axstride];
+            }
+          }
+        }
+    }
+};
+
 /**
  * Definition of the most common image types.
  */
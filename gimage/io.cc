@@ -37,6 +37,8 @@
 #include "io.h"
 #include "pnm_io.h"
 #include "raw_io.h"
+#include "tilecache.h"
+#include "timing.h"
 
 #ifdef INCLUDE_GDAL
 #include "gdal_io.h"
@@ -50,7 +52,13 @@
 #include "png_io.h"
 #endif
 
+#ifdef INCLUDE_ZLIB
+#include "cvz_io.h"
+#endif
+
 #include <gutil/misc.h>
+#include <gutil/thread.h>
+#include <gutil/semaphore.h>
 
 #include <limits>
 #include <stdexcept>
@@ -59,14 +67,254 @@
 #include <sstream>
 #include <string>
 #include <set>
+#include <map>
+#include <memory>
 #include <vector>
+#include <deque>
+#include <list>
+#include <algorithm>
+#include <functional>
 #include <cctype>
 #include <cstdlib>
-#include <valarray>
+#include <exception>
 
 namespace gimage
 {
 
+ImageReader::ImageReader(long _width, long _height, int _depth)
+{
+  width=_width;
+  height=_height;
+  depth=_depth;
+  row=0;
+}
+
+template<class T> bool ImageReader::readBand(Image<T> &band, long n)
+{
+  if (row >= height)
+  {
+    band.setSize(0, 0, 0);
+    return false;
+  }
+
+  n=std::max(1l, std::min(n, height-row));
+
+  band.setSize(width, n, depth);
+  readRows(band, row);
+
+  row+=n;
+
+  return true;
+}
+
+bool ImageReader::read(ImageU8 &band, long n)
+{
+  return readBand(band, n);
+}
+
+bool ImageReader::read(ImageU16 &band, long n)
+{
+  return readBand(band, n);
+}
+
+bool ImageReader::read(ImageFloat &band, long n)
+{
+  return readBand(band, n);
+}
+
+void ImageReader::readRows(ImageU8 &/* band */, long /* k */)
+{
+  throw gutil::IOException("Reading this image type as 8 bit image is not implemented!");
+}
+
+void ImageReader::readRows(ImageU16 &band, long k)
+{
+  ImageU8 bandu8(band.getWidth(), band.getHeight(), band.getDepth());
+
+  readRows(bandu8, k);
+  band.setImageLimited(bandu8);
+}
+
+void ImageReader::readRows(ImageFloat &band, long k)
+{
+  ImageU16 bandu16(band.getWidth(), band.getHeight(), band.getDepth());
+
+  readRows(bandu16, k);
+  band.setImageLimited(bandu16);
+}
+
+ImageWriter::ImageWriter(long _width, long _height, int _depth)
+{
+  width=_width;
+  height=_height;
+  depth=_depth;
+  row=0;
+  type=0;
+  closed=false;
+}
+
+template<class T> void ImageWriter::writeBand(const Image<T> &band, int t)
+{
+  if (closed || band.getWidth() != width || band.getDepth() != depth ||
+      row+band.getHeight() > height)
+  {
+    throw gutil::IOException("The band does not fit into the image");
+  }
+
+  if (type != 0 && type != t)
+  {
+    throw gutil::IOException("All bands of an image must have the same pixel type");
+  }
+
+  if (band.getHeight() > 0)
+  {
+    writeRows(band, row);
+
+    type=t;
+    row+=band.getHeight();
+  }
+}
+
+void ImageWriter::write(const ImageU8 &band)
+{
+  writeBand(band, 1);
+}
+
+void ImageWriter::write(const ImageU16 &band)
+{
+  writeBand(band, 2);
+}
+
+void ImageWriter::write(const ImageFloat &band)
+{
+  writeBand(band, 3);
+}
+
+void ImageWriter::close()
+{
+  if (!closed)
+  {
+    if (row < height)
+    {
+      throw gutil::IOException("Not all rows of the image have been written");
+    }
+
+    finish();
+    closed=true;
+  }
+}
+
+void ImageWriter::writeRows(const ImageU8 &/* band */, long /* k */)
+{
+  throw gutil::IOException("Writing 8 bit images in bands is not implemented for this image type!");
+}
+
+void ImageWriter::writeRows(const ImageU16 &/* band */, long /* k */)
+{
+  throw gutil::IOException("Writing 16 bit images in bands is not implemented for this image type!");
+}
+
+void ImageWriter::writeRows(const ImageFloat &/* band */, long /* k */)
+{
+  throw gutil::IOException("Writing float images in bands is not implemented for this image type!");
+}
+
+namespace
+{
+
+/*
+ * Reads bands by loading the corresponding part of the image.
+ */
+
+template<class IO> class LoadImageReader : public ImageReader
+{
+  private:
+
+    const IO    &io;
+    std::string name;
+
+    template<class T> void loadRows(Image<T> &band, long k)
+    {
+      io.load(band, name.c_str(), 1, 0, k, getWidth(), band.getHeight());
+    }
+
+  public:
+
+    LoadImageReader(const IO &_io, const char *_name, long width, long height, int depth) :
+      ImageReader(width, height, depth), io(_io), name(_name)
+    { }
+
+  protected:
+
+    void readRows(ImageU8 &band, long k) { loadRows(band, k); }
+    void readRows(ImageU16 &band, long k) { loadRows(band, k); }
+    void readRows(ImageFloat &band, long k) { loadRows(band, k); }
+};
+
+/*
+ * Collects all bands in one image and saves it when the writer is closed.
+ */
+
+class SaveImageWriter : public ImageWriter
+{
+  private:
+
+    const BasicImageIO &io;
+    std::string name;
+
+    ImageU8    imageu8;
+    ImageU16   imageu16;
+    ImageFloat imagef;
+
+    template<class T> void copyRows(Image<T> &image, const Image<T> &band, long k)
+    {
+      if (k == 0)
+      {
+        image.setSize(getWidth(), getHeight(), getDepth());
+      }
+
+      for (int d=0; d<band.getDepth(); d++)
+      {
+        for (long j=0; j<band.getHeight(); j++)
+        {
+          const T *p=band.getPtr(0, j, d);
+          std::copy(p, p+band.getWidth(), image.getPtr(0, k+j, d));
+        }
+      }
+    }
+
+  public:
+
+    SaveImageWriter(const BasicImageIO &_io, const char *_name, long width, long height,
+                    int depth) :
+      ImageWriter(width, height, depth), io(_io), name(_name)
+    { }
+
+  protected:
+
+    void writeRows(const ImageU8 &band, long k) { copyRows(imageu8, band, k); }
+    void writeRows(const ImageU16 &band, long k) { copyRows(imageu16, band, k); }
+    void writeRows(const ImageFloat &band, long k) { copyRows(imagef, band, k); }
+
+    void finish()
+    {
+      if (imageu8.getHeight() > 0)
+      {
+        io.save(imageu8, name.c_str());
+      }
+      else if (imageu16.getHeight() > 0)
+      {
+        io.save(imageu16, name.c_str());
+      }
+      else if (imagef.getHeight() > 0)
+      {
+        io.save(imagef, name.c_str());
+      }
+    }
+};
+
+}
+
 void BasicImageIO::loadHeader(const char *name, long &width, long &height,
                               int &depth) const
 {
@@ -215,195 +463,1540 @@ void BasicImageIO::save(const ImageFloat &image, const char *name) const
   throw gutil::IOException("Saving this image type is not implemented! ("+std::string(name)+")");
 }
 
-ImageIO::ImageIO()
+ImageReader *BasicImageIO::openReader(const char *name) const
 {
-  list.push_back(new PNMImageIO());
-  list.push_back(new RAWImageIO());
-
-#ifdef INCLUDE_GDAL
-  list.push_back(new GDALImageIO());
-#endif
+  long width, height;
+  int  depth;
 
-#ifdef INCLUDE_PNG
-  list.push_back(new PNGImageIO());
-#endif
+  loadHeader(name, width, height, depth);
 
-#ifdef INCLUDE_JPEG
-  list.push_back(new JPEGImageIO());
-#endif
+  return new LoadImageReader<BasicImageIO>(*this, name, width, height, depth);
 }
 
-void ImageIO::addBasicImageIO(const BasicImageIO &io)
+ImageWriter *BasicImageIO::openWriter(const char *name, long width, long height,
+                                      int depth) const
 {
-  list.insert(list.begin(), io.create());
+  if (!handlesFile(name, false))
+  {
+    throw gutil::IOException("Saving this image type is not implemented! ("+std::string(name)+")");
+  }
+
+  return new SaveImageWriter(*this, name, width, height, depth);
 }
 
-bool ImageIO::handlesFile(const char *name, bool reading) const
+/*
+ * State of an asynchronous request, which is shared by the future and the
+ * pool. The status decides if the request is executed or cancelled. The
+ * semaphore done is incremented once the request is finished or cancelled.
+ */
+
+struct AsyncState
 {
-  bool ret;
+  enum Status {queued, running, finished, cancelled};
 
-  try
+  gutil::Semaphore   mutex;
+  gutil::Semaphore   done;
+  int                status;
+  std::exception_ptr error;
+
+  AsyncState() : mutex(1), done(0), status(queued) { }
+
+  int getStatus()
   {
-    getBasicImageIO(name, reading);
-    ret=true;
+    gutil::Lock lock(mutex);
+    return status;
   }
-  catch (const std::exception &)
+
+  /*
+   * Changes the status from expected to s and returns true, or returns
+   * false if the status is not expected.
+   */
+
+  bool setStatus(int expected, int s)
   {
-    ret=false;
+    gutil::Lock lock(mutex);
+
+    if (status == expected)
+    {
+      status=s;
+      return true;
+    }
+
+    return false;
   }
 
-  return ret;
-}
+  /*
+   * Sets the final status and the exception of a failed request and wakes up
+   * all waiting threads.
+   */
+
+  void finish(int s, std::exception_ptr e)
+  {
+    {
+      gutil::Lock lock(mutex);
+      status=s;
+      error=e;
+    }
+
+    done.increment();
+  }
+
+  /*
+   * Waits until the request is finished. The semaphore is incremented again
+   * for further waiting threads.
+   */
+
+  void wait()
+  {
+    done.decrement();
+    done.increment();
+  }
+};
 
 namespace
 {
 
-std::string getTileName(const std::string &prefix, int trow, int tcol, const std::string &suffix)
+/*
+ * Cancels the request if it has not been started yet.
+ */
+
+bool cancelRequest(AsyncState &state)
 {
-  std::ostringstream ret;
+  if (state.setStatus(AsyncState::queued, AsyncState::cancelled))
+  {
+    state.finish(AsyncState::cancelled, std::make_exception_ptr(
+                   gutil::IOException("The request has been cancelled")));
+    return true;
+  }
 
-  ret.fill('0');
-  ret << std::right;
+  return false;
+}
 
-  ret << prefix << '_';
+}
 
-  ret.width(2);
-  ret << trow;
-  ret.width(0);
-  ret << '_';
-  ret.width(2);
-  ret << tcol;
-  ret.width(0);
+/*
+ * Pool of IO threads that execute asynchronous requests in the given order.
+ * A request is skipped as long as the maximum number of running requests of
+ * its image format is reached. Threads are started on demand. Each thread
+ * waits on its own semaphore while it is idle.
+ */
 
-  ret << '_' << suffix;
+class AsyncPool
+{
+  private:
 
-  return ret.str();
-}
+    struct Job
+    {
+      const BasicImageIO *io;
+      std::function<void()> fct;
+      std::shared_ptr<AsyncState> state;
+    };
 
-void loadTiledHeader(const BasicImageIO &io, std::set<std::string> &list,
-                     const std::string &prefix, const std::string &suffix, long &twidth, long &theight,
-                     long &tborder, long &width, long &height, int &depth)
-{
-  // initialise return parameters
+    struct Worker : public gutil::ThreadFunction
+    {
+      AsyncPool        &pool;
+      int              id;
+      gutil::Thread    thread;
+      gutil::Semaphore wake;
+      bool             idle;
 
-  list.clear();
-  twidth=0;
-  theight=0;
-  tborder=0;
-  width=0;
-  height=0;
-  depth=0;
+      Worker(AsyncPool &p, int i) : pool(p), id(i), wake(0), idle(false) { }
+      virtual ~Worker() { }
 
-  // get optional border size
+      void run()
+      {
+        pool.work(id);
+      }
+    };
 
-  gutil::Properties prop;
+    gutil::Semaphore mutex;
+    std::deque<Job>  queue;
 
-  try
-  {
-    prop.load((prefix+".hdr").c_str());
-  }
-  catch (const std::exception &)
-  { }
+    std::map<const BasicImageIO *, int> limit;
+    std::map<const BasicImageIO *, int> active;
 
-  try
-  {
-    prop.load((prefix+"_param.txt").c_str());
-  }
-  catch (const std::exception &)
-  { }
+    std::vector<Worker *> worker;
+    int  nthreads;
+    bool stop;
 
-  prop.getValue("border", tborder, "0");
+    AsyncPool(const AsyncPool &);
+    AsyncPool &operator=(const AsyncPool &);
 
-  // get list of all tiles
+    /*
+     * Removes the first job from the queue that can be executed. Cancelled
+     * jobs are dropped. Must be called with locked mutex.
+     */
 
-  gutil::getFileList(list, prefix, suffix);
+    bool nextJob(Job &job)
+    {
+      std::deque<Job>::iterator it=queue.begin();
 
-  if (list.empty())
-  {
-    throw gutil::IOException("There are no tiles: "+prefix+':'+suffix);
-  }
+      while (it != queue.end())
+      {
+        if (it->state->getStatus() != AsyncState::queued)
+        {
+          it=queue.erase(it);
+          continue;
+        }
 
-  // load header information of first tile
+        std::map<const BasicImageIO *, int>::const_iterator l=limit.find(it->io);
 
-  io.loadHeader((*list.begin()).c_str(), twidth, theight, depth);
+        if (l == limit.end() || l->second <= 0 || active[it->io] < l->second)
+        {
+          job=*it;
+          queue.erase(it);
+          return true;
+        }
 
-  // determine number of rows and columns
+        ++it;
+      }
 
-  int rows=0;
-  int cols=0;
+      return false;
+    }
 
-  for (std::set<std::string>::iterator it=list.begin(); it!=list.end(); ++it)
-  {
-    int i, k;
-    char sep1, sep2, sep3;
-    std::istringstream in(it->substr(prefix.size(), it->size()-prefix.size()-suffix.size()));
+    /*
+     * Wakes up one idle thread that may execute jobs and returns true, or
+     * returns false if there is no such thread. Must be called with locked
+     * mutex.
+     */
 
-    in >> sep1 >> k >> sep2 >> i >> sep3;
+    bool wakeOne()
+    {
+      for (int i=0; i<nthreads && i<static_cast<int>(worker.size()); i++)
+      {
+        if (worker[i]->idle)
+        {
+          worker[i]->idle=false;
+          worker[i]->wake.increment();
+          return true;
+        }
+      }
 
-    if (in.good() && sep1 == '_' && sep2 == '_' && sep3 == '_')
+      return false;
+    }
+
+    /*
+     * Wakes up all idle threads, e.g. for checking the changed number of
+     * threads or limits. Must be called with locked mutex.
+     */
+
+    void wakeAll()
     {
-      cols=std::max(cols, i+1);
-      rows=std::max(rows, k+1);
+      for (size_t i=0; i<worker.size(); i++)
+      {
+        if (worker[i]->idle)
+        {
+          worker[i]->idle=false;
+          worker[i]->wake.increment();
+        }
+      }
     }
-  }
 
-  if (cols == 0 || rows == 0)
+  public:
+
+    AsyncPool() : mutex(1)
+    {
+      nthreads=4;
+
+      const char *s=std::getenv("CVKIT_IO_THREADS");
+
+      if (s != 0)
+      {
+        nthreads=std::max(1, std::atoi(s));
+      }
+
+      stop=false;
+    }
+
+    ~AsyncPool()
+    {
+      // waiting jobs are cancelled, running jobs are finished
+
+      {
+        gutil::Lock lock(mutex);
+
+        for (size_t i=0; i<queue.size(); i++)
+        {
+          cancelRequest(*queue[i].state);
+        }
+
+        queue.clear();
+
+        stop=true;
+        wakeAll();
+      }
+
+      for (size_t i=0; i<worker.size(); i++)
+      {
+        worker[i]->thread.join();
+        delete worker[i];
+      }
+    }
+
+    void setThreads(int n)
+    {
+      gutil::Lock lock(mutex);
+      nthreads=std::max(1, n);
+
+      // superfluous threads are parked until the number is increased again
+
+      wakeAll();
+    }
+
+    int getThreads()
+    {
+      gutil::Lock lock(mutex);
+      return nthreads;
+    }
+
+    void setLimit(const BasicImageIO *io, int n)
+    {
+      gutil::Lock lock(mutex);
+      limit[io]=std::max(0, n);
+      wakeAll();
+    }
+
+    void add(const BasicImageIO *io, const std::function<void()> &fct,
+             const std::shared_ptr<AsyncState> &state)
+    {
+      gutil::Lock lock(mutex);
+
+      Job job;
+      job.io=io;
+      job.fct=fct;
+      job.state=state;
+
+      queue.push_back(job);
+
+      // start another thread if all threads are busy
+
+      if (!wakeOne() && static_cast<int>(worker.size()) < nthreads)
+      {
+        worker.push_back(new Worker(*this, static_cast<int>(worker.size())));
+        worker.back()->thread.create(*worker.back());
+      }
+    }
+
+    /*
+     * Executes jobs in the thread of the worker with the given number.
+     */
+
+    void work(int id)
+    {
+      mutex.decrement();
+
+      // threads are never removed from the pool, instead the threads with
+      // the highest numbers are parked if the number of threads is reduced
+
+      Worker &w=*worker[id];
+
+      while (!stop)
+      {
+        Job job;
+
+        if (id >= nthreads || !nextJob(job))
+        {
+          w.idle=true;
+          mutex.increment();
+          w.wake.decrement();
+          mutex.decrement();
+          continue;
+        }
+
+        if (!job.state->setStatus(AsyncState::queued, AsyncState::running))
+        {
+          continue;
+        }
+
+        active[job.io]++;
+        mutex.increment();
+
+        std::exception_ptr error;
+
+        try
+        {
+          job.fct();
+        }
+        catch (...)
+        {
+          error=std::current_exception();
+        }
+
+        job.state->finish(AsyncState::finished, error);
+
+        mutex.decrement();
+        active[job.io]--;
+
+        // a waiting job of the same format may be executed by another thread
+
+        wakeOne();
+      }
+
+      mutex.increment();
+    }
+};
+
+ImageFuture::ImageFuture(ImageFuture &&a) : state(std::move(a.state))
+{ }
+
+ImageFuture::~ImageFuture()
+{
+  release();
+}
+
+ImageFuture &ImageFuture::operator=(ImageFuture &&a)
+{
+  if (this != &a)
+  {
+    release();
+    state=std::move(a.state);
+  }
+
+  return *this;
+}
+
+void ImageFuture::release()
+{
+  if (state && !cancel())
+  {
+    state->wait();
+  }
+
+  state.reset();
+}
+
+bool ImageFuture::isReady() const
+{
+  if (state)
+  {
+    const int s=state->getStatus();
+    return s == AsyncState::finished || s == AsyncState::cancelled;
+  }
+
+  return false;
+}
+
+void ImageFuture::wait() const
+{
+  if (state)
+  {
+    state->wait();
+  }
+}
+
+void ImageFuture::get()
+{
+  if (!state)
+  {
+    throw gutil::IOException("The request is not valid");
+  }
+
+  state->wait();
+
+  std::exception_ptr error=state->error;
+  state.reset();
+
+  if (error)
+  {
+    std::rethrow_exception(error);
+  }
+}
+
+bool ImageFuture::cancel()
+{
+  if (state)
+  {
+    return cancelRequest(*state);
+  }
+
+  return false;
+}
+
+ImageIO::ImageIO()
+{
+  pool=new AsyncPool();
+
+  list.push_back(new PNMImageIO());
+  list.push_back(new RAWImageIO());
+
+#ifdef INCLUDE_GDAL
+  list.push_back(new GDALImageIO());
+#endif
+
+#ifdef INCLUDE_PNG
+  {
+    int level=-1;
+    PNGImageIO::Filter filter=PNGImageIO::filter_adaptive;
+
+    const char *s=std::getenv("CVKIT_PNG_LEVEL");
+
+    if (s != 0)
+    {
+      level=std::atoi(s);
+    }
+
+    s=std::getenv("CVKIT_PNG_FILTER");
+
+    if (s != 0)
+    {
+      const char *name[]={"none", "sub", "up", "average", "paeth", "adaptive"};
+
+      for (int i=0; i<6; i++)
+      {
+        if (std::string(s) == name[i])
+        {
+          filter=static_cast<PNGImageIO::Filter>(i);
+        }
+      }
+    }
+
+    list.push_back(new PNGImageIO(level, filter));
+  }
+#endif
+
+#ifdef INCLUDE_JPEG
+  list.push_back(new JPEGImageIO());
+#endif
+
+#ifdef INCLUDE_ZLIB
+  list.push_back(new CVZImageIO());
+#endif
+}
+
+ImageIO::~ImageIO()
+{
+  delete pool;
+
+  for (size_t i=0; i<list.size(); i++)
+  {
+    delete list[i];
+  }
+}
+
+void ImageIO::addBasicImageIO(const BasicImageIO &io)
+{
+  list.insert(list.begin(), io.create());
+}
+
+bool ImageIO::handlesFile(const char *name, bool reading) const
+{
+  bool ret;
+
+  try
+  {
+    getBasicImageIO(name, reading);
+    ret=true;
+  }
+  catch (const std::exception &)
+  {
+    ret=false;
+  }
+
+  return ret;
+}
+
+namespace
+{
+
+std::string getTileName(const std::string &prefix, int trow, int tcol, const std::string &suffix)
+{
+  std::ostringstream ret;
+
+  ret.fill('0');
+  ret << std::right;
+
+  ret << prefix << '_';
+
+  ret.width(2);
+  ret << trow;
+  ret.width(0);
+  ret << '_';
+  ret.width(2);
+  ret << tcol;
+  ret.width(0);
+
+  ret << '_' << suffix;
+
+  return ret.str();
+}
+
+/**
+ * Information about a tiled image, i.e. a grid of tiles with names
+ * <prefix>_<row>_<col>_<suffix>. Tiles can be missing.
+ */
+
+struct TileIndex
+{
+  std::string first;       // first file of the list, which defines the tile size
+  int  rows, cols;
+  std::vector<char> tile;  // 1 if the tile exists, row by row
+  long twidth, theight, tborder;
+  long width, height;
+  int  depth;
+
+  long long mtime[4];      // of directory, header, parameter file and first file
+
+  bool hasTile(int ty, int tx) const
+  {
+    return ty >= 0 && ty < rows && tx >= 0 && tx < cols && tile[ty*cols+tx] != 0;
+  }
+};
+
+/**
+ * Process wide cache of tile indices, keyed by prefix and suffix.
+ */
+
+struct TileIndexCache
+{
+  TileIndexCache() : mutex(1)
+  {
+    const char *s=std::getenv("CVKIT_TILE_INDEX");
+    persistent=(s != 0 && std::atoi(s) != 0);
+  }
+
+  gutil::Semaphore mutex;
+  bool persistent;
+  std::map<std::string, std::shared_ptr<const TileIndex> > index;
+};
+
+TileIndexCache &getTileIndexCache()
+{
+  static TileIndexCache *cache=new TileIndexCache();
+  return *cache;
+}
+
+/**
+ * Gets the modification times of the directory of the tiles and the
+ * optional header and parameter files. The modification time of the first
+ * file is set to -1.
+ */
+
+void getTileModificationTimes(long long mtime[4], const std::string &prefix)
+{
+  std::string dir=".";
+  size_t pos=prefix.find_last_of("/\\");
+
+  if (pos < prefix.size())
+  {
+    dir=prefix.substr(0, std::max(static_cast<size_t>(1), pos));
+  }
+
+  mtime[0]=gutil::getFileModificationTime(dir.c_str());
+  mtime[1]=gutil::getFileModificationTime((prefix+".hdr").c_str());
+  mtime[2]=gutil::getFileModificationTime((prefix+"_param.txt").c_str());
+  mtime[3]=-1;
+}
+
+bool isTileIndexValid(const TileIndex &index, const long long mtime[4])
+{
+  return index.mtime[0] == mtime[0] && index.mtime[1] == mtime[1] &&
+         index.mtime[2] == mtime[2] &&
+         index.mtime[3] == gutil::getFileModificationTime(index.first.c_str());
+}
+
+std::string getTileIndexFile(const std::string &prefix, const std::string &suffix)
+{
+  return prefix+"_"+suffix+".idx";
+}
+
+std::shared_ptr<const TileIndex> loadTileIndexFile(const std::string &prefix,
+    const std::string &suffix, const long long mtime[4])
+{
+  std::shared_ptr<TileIndex> ret;
+
+  try
+  {
+    gutil::Properties prop(getTileIndexFile(prefix, suffix).c_str());
+
+    std::shared_ptr<TileIndex> index(new TileIndex());
+    std::string tile;
+
+    prop.getString("tiles.first", index->first);
+    prop.getValue("tiles.rows", index->rows);
+    prop.getValue("tiles.cols", index->cols);
+    prop.getString("tiles.exist", tile);
+    prop.getValue("tile.width", index->twidth);
+    prop.getValue("tile.height", index->theight);
+    prop.getValue("tile.border", index->tborder);
+    prop.getValue("tile.depth", index->depth);
+    prop.getValue("mtime.dir", index->mtime[0]);
+    prop.getValue("mtime.hdr", index->mtime[1]);
+    prop.getValue("mtime.param", index->mtime[2]);
+    prop.getValue("mtime.first", index->mtime[3]);
+
+    if (static_cast<long>(tile.size()) == static_cast<long>(index->rows)*index->cols &&
+        isTileIndexValid(*index, mtime))
+    {
+      index->tile.resize(tile.size());
+
+      for (size_t i=0; i<tile.size(); i++)
+      {
+        index->tile[i]=(tile[i] == '1');
+      }
+
+      index->width=(index->twidth-2*index->tborder)*index->cols;
+      index->height=(index->theight-2*index->tborder)*index->rows;
+
+      ret=index;
+    }
+  }
+  catch (const std::exception &)
+  { }
+
+  return ret;
+}
+
+void saveTileIndexFile(TileIndex &index, const std::string &prefix, const std::string &suffix)
+{
+  std::string name=getTileIndexFile(prefix, suffix);
+  std::string tile(index.tile.size(), '0');
+
+  for (size_t i=0; i<tile.size(); i++)
+  {
+    if (index.tile[i])
+    {
+      tile[i]='1';
+    }
+  }
+
+  try
+  {
+    // creating the file changes the modification time of the directory,
+    // which is then stored by overwriting the file
+
+    for (int i=0; i<2; i++)
+    {
+      gutil::Properties prop;
+
+      prop.putString("tiles.first", index.first);
+      prop.putValue("tiles.rows", index.rows);
+      prop.putValue("tiles.cols", index.cols);
+      prop.putString("tiles.exist", tile);
+      prop.putValue("tile.width", index.twidth);
+      prop.putValue("tile.height", index.theight);
+      prop.putValue("tile.border", index.tborder);
+      prop.putValue("tile.depth", index.depth);
+      prop.putValue("mtime.dir", index.mtime[0]);
+      prop.putValue("mtime.hdr", index.mtime[1]);
+      prop.putValue("mtime.param", index.mtime[2]);
+      prop.putValue("mtime.first", index.mtime[3]);
+
+      prop.save(name.c_str(), "Index of tiled image");
+
+      long long mtime[4];
+      getTileModificationTimes(mtime, prefix);
+
+      if (mtime[0] == index.mtime[0])
+      {
+        break;
+      }
+
+      index.mtime[0]=mtime[0];
+    }
+  }
+  catch (const std::exception &)
+  {
+    // the index file is optional, e.g. if the directory is not writable
+  }
+}
+
+/**
+ * Creates the index by scanning the directory of the tiles and loading the
+ * header of the first tile.
+ */
+
+std::shared_ptr<TileIndex> createTileIndex(const BasicImageIO &io, const std::string &prefix,
+    const std::string &suffix, const long long mtime[4])
+{
+  std::shared_ptr<TileIndex> index(new TileIndex());
+
+  for (int i=0; i<4; i++)
+  {
+    index->mtime[i]=mtime[i];
+  }
+
+  // get optional border size
+
+  gutil::Properties prop;
+
+  try
+  {
+    prop.load((prefix+".hdr").c_str());
+  }
+  catch (const std::exception &)
+  { }
+
+  try
+  {
+    prop.load((prefix+"_param.txt").c_str());
+  }
+  catch (const std::exception &)
+  { }
+
+  prop.getValue("border", index->tborder, "0");
+
+  // get list of all tiles
+
+  std::set<std::string> list;
+
+  gutil::getFileList(list, prefix, suffix);
+
+  if (list.empty())
+  {
+    throw gutil::IOException("There are no tiles: "+prefix+':'+suffix);
+  }
+
+  // load header information of first tile
+
+  index->first=*list.begin();
+  index->mtime[3]=gutil::getFileModificationTime(index->first.c_str());
+
+  io.loadHeader(index->first.c_str(), index->twidth, index->theight, index->depth);
+
+  // determine number of rows and columns
+
+  int rows=0;
+  int cols=0;
+
+  for (std::set<std::string>::iterator it=list.begin(); it!=list.end(); ++it)
+  {
+    int i, k;
+    char sep1, sep2, sep3;
+    std::istringstream in(it->substr(prefix.size(), it->size()-prefix.size()-suffix.size()));
+
+    in >> sep1 >> k >> sep2 >> i >> sep3;
+
+    if (in.good() && sep1 == '_' && sep2 == '_' && sep3 == '_')
+    {
+      cols=std::max(cols, i+1);
+      rows=std::max(rows, k+1);
+    }
+  }
+
+  if (cols == 0 || rows == 0)
+  {
+    throw gutil::IOException("This is not a tiled image: "+prefix+':'+suffix);
+  }
+
+  // remember which tiles exist
+
+  index->rows=rows;
+  index->cols=cols;
+  index->tile.assign(static_cast<size_t>(rows)*cols, 0);
+
+  for (int k=0; k<rows; k++)
+  {
+    for (int i=0; i<cols; i++)
+    {
+      if (list.find(getTileName(prefix, k, i, suffix)) != list.end())
+      {
+        index->tile[k*cols+i]=1;
+      }
+    }
+  }
+
+  // compute total size
+
+  index->width=(index->twidth-2*index->tborder)*cols;
+  index->height=(index->theight-2*index->tborder)*rows;
+
+  return index;
+}
+
+/**
+ * Returns the index of the tiled image with the given prefix and suffix.
+ * Cached indices are reused if they are still valid.
+ */
+
+std::shared_ptr<const TileIndex> getTileIndex(const BasicImageIO &io,
+    const std::string &prefix, const std::string &suffix)
+{
+  TileIndexCache &cache=getTileIndexCache();
+  std::string key=prefix+':'+suffix;
+  long long mtime[4];
+  bool persistent;
+
+  getTileModificationTimes(mtime, prefix);
+
+  {
+    gutil::Lock lock(cache.mutex);
+
+    std::map<std::string, std::shared_ptr<const TileIndex> >::iterator it=cache.index.find(key);
+
+    if (it != cache.index.end() && isTileIndexValid(*it->second, mtime))
+    {
+      return it->second;
+    }
+
+    persistent=cache.persistent;
+  }
+
+  std::shared_ptr<const TileIndex> ret;
+
+  if (persistent)
+  {
+    ret=loadTileIndexFile(prefix, suffix, mtime);
+  }
+
+  if (!ret)
+  {
+    std::shared_ptr<TileIndex> index=createTileIndex(io, prefix, suffix, mtime);
+
+    if (persistent)
+    {
+      saveTileIndexFile(*index, prefix, suffix);
+    }
+
+    ret=index;
+  }
+
+  gutil::Lock lock(cache.mutex);
+  cache.index[key]=ret;
+
+  return ret;
+}
+}
+
+void setPersistentTileIndex(bool enable)
+{
+  TileIndexCache &cache=getTileIndexCache();
+  gutil::Lock lock(cache.mutex);
+  cache.persistent=enable;
+}
+
+void clearTileIndexCache()
+{
+  TileIndexCache &cache=getTileIndexCache();
+  gutil::Lock lock(cache.mutex);
+  cache.index.clear();
+}
+
+namespace
+{
+
+/**
+ * Cached header and properties of an image.
+ */
+
+struct ImageInfo
+{
+  long long stamp[7];
+  bool header, properties;
+  long width, height;
+  int  depth;
+  gutil::Properties prop;
+  std::list<std::string>::iterator lru;
+};
+
+struct ImageInfoCache
+{
+  ImageInfoCache() : mutex(1)
   {
-    throw gutil::IOException("This is not a tiled image: "+prefix+':'+suffix);
+    capacity=4096;
+
+    const char *s=std::getenv("CVKIT_INFO_CACHE");
+
+    if (s != 0)
+    {
+      capacity=static_cast<size_t>(std::max(0l, std::atol(s)));
+    }
+  }
+
+  gutil::Semaphore mutex;
+  size_t capacity;
+  std::map<std::string, ImageInfo> info;
+  std::list<std::string> lru; // most recently used first
+
+  void remove(std::map<std::string, ImageInfo>::iterator it)
+  {
+    lru.erase(it->second.lru);
+    info.erase(it);
+  }
+
+  void shrink(size_t n)
+  {
+    while (info.size() > n && lru.size() > 0)
+    {
+      remove(info.find(lru.back()));
+    }
+  }
+};
+
+ImageInfoCache &getImageInfoCache()
+{
+  static ImageInfoCache *cache=new ImageInfoCache();
+  return *cache;
+}
+
+/**
+ * Gets size and modification time of the image and the modification times
+ * of all files that may contribute to its header or properties. The entries
+ * of files that do not exist are -1.
+ */
+
+void getImageInfoStamp(long long stamp[7], const std::string &name)
+{
+  stamp[0]=gutil::getFileSize(name.c_str());
+  stamp[1]=gutil::getFileModificationTime(name.c_str());
+
+  // optional header and parameter files of normal images
+
+  std::string s=name;
+  size_t pos=s.rfind('.');
+
+  if (pos != s.npos)
+  {
+    s=s.substr(0, pos);
+  }
+
+  stamp[2]=gutil::getFileModificationTime((s+".hdr").c_str());
+  stamp[3]=gutil::getFileModificationTime((s+"_param.txt").c_str());
+
+  // directory and optional header and parameter files of tiled images
+
+  pos=name.rfind(':');
+
+  if (pos != name.npos && name.compare(pos, 2, ":\\") == 0)
+  {
+    pos=name.npos;
+  }
+
+  stamp[4]=stamp[5]=stamp[6]=-1;
+
+  if (pos != name.npos)
+  {
+    long long mtime[4];
+
+    getTileModificationTimes(mtime, name.substr(0, pos));
+
+    stamp[4]=mtime[0];
+    stamp[5]=mtime[1];
+    stamp[6]=mtime[2];
+  }
+}
+
+/**
+ * Returns true if any of the files of the stamp exists. Otherwise, changes of
+ * the image cannot be detected, e.g. for names that are not files, and the
+ * image must not be cached.
+ */
+
+bool isCacheableStamp(const long long stamp[7])
+{
+  for (int i=0; i<7; i++)
+  {
+    if (stamp[i] != -1)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Returns the valid cache entry of the image with the given stamp or 0.
+ * The mutex of the cache must be locked.
+ */
+
+ImageInfo *getImageInfo(ImageInfoCache &cache, const std::string &name,
+                        const long long stamp[7])
+{
+  std::map<std::string, ImageInfo>::iterator it=cache.info.find(name);
+
+  if (it != cache.info.end())
+  {
+    if (std::equal(stamp, stamp+7, it->second.stamp))
+    {
+      cache.lru.splice(cache.lru.begin(), cache.lru, it->second.lru);
+      return &it->second;
+    }
+
+    cache.remove(it);
+  }
+
+  return 0;
+}
+
+/**
+ * Returns the cache entry of the image with the given stamp, which is
+ * created if needed or 0 if the capacity of the cache is 0. The least
+ * recently used entry is removed if the capacity is exceeded. The mutex of
+ * the cache must be locked.
+ */
+
+ImageInfo *createImageInfo(ImageInfoCache &cache, const std::string &name,
+                           const long long stamp[7])
+{
+  ImageInfo *info=getImageInfo(cache, name, stamp);
+
+  if (info == 0)
+  {
+    if (cache.capacity == 0)
+    {
+      return 0;
+    }
+
+    cache.shrink(cache.capacity-1);
+
+    cache.lru.push_front(name);
+
+    info=&cache.info[name];
+
+    info->lru=cache.lru.begin();
+
+    std::copy(stamp, stamp+7, info->stamp);
+    info->header=false;
+    info->properties=false;
+    info->width=0;
+    info->height=0;
+    info->depth=0;
+  }
+
+  return info;
+}
+
+class ProbeFct : public gutil::ParallelFunction
+{
+  private:
+
+    const ImageIO &io;
+    const std::vector<std::string> &list;
+
+  public:
+
+    ProbeFct(const ImageIO &_io, const std::vector<std::string> &_list) : io(_io),
+      list(_list)
+    { }
+
+    void run(long start, long end, long step)
+    {
+      for (long i=start; i<=end; i+=step)
+      {
+        try
+        {
+          long w, h;
+          int d;
+          gutil::Properties prop;
+
+          io.loadHeader(list[i].c_str(), w, h, d);
+          io.loadProperties(prop, list[i].c_str());
+        }
+        catch (const std::exception &)
+        {
+          // skip images that cannot be loaded
+        }
+      }
+    }
+};
+
+}
+
+void clearImageInfoCache()
+{
+  ImageInfoCache &cache=getImageInfoCache();
+  gutil::Lock lock(cache.mutex);
+  cache.shrink(0);
+}
+
+void setImageInfoCacheCapacity(size_t n)
+{
+  ImageInfoCache &cache=getImageInfoCache();
+  gutil::Lock lock(cache.mutex);
+
+  cache.capacity=n;
+  cache.shrink(n);
+}
+
+void ImageIO::probe(const std::vector<std::string> &list) const
+{
+  ProbeFct fct(*this, list);
+  gutil::runParallel(fct, 0, static_cast<long>(list.size())-1, 1);
+}
+
+void ImageIO::loadHeader(const char *name, long &width, long &height,
+                         int &depth) const
+{
+  ImageInfoCache &cache=getImageInfoCache();
+  long long stamp[7];
+
+  getImageInfoStamp(stamp, name);
+
+  {
+    gutil::Lock lock(cache.mutex);
+    ImageInfo *info=getImageInfo(cache, name, stamp);
+
+    if (info != 0 && info->header)
+    {
+      width=info->width;
+      height=info->height;
+      depth=info->depth;
+      return;
+    }
+  }
+
+  std::string s=name;
+  size_t pos=s.rfind(':');
+
+  if (pos != s.npos && s.compare(pos, 2, ":\\") == 0)
+  {
+    pos=s.npos;
+  }
+
+  if (pos != s.npos)
+  {
+    try
+    {
+      // extract prefix and suffix from file name
+
+      std::string prefix=s.substr(0, pos);
+      std::string suffix=s.substr(pos+1);
+
+      // get header information
+
+      std::shared_ptr<const TileIndex> index=getTileIndex(getBasicImageIO(name, true), prefix,
+                                             suffix);
+
+      width=index->width;
+      height=index->height;
+      depth=index->depth;
+    }
+    catch (const std::exception &)
+    {
+      // if loading as tiled image failes, try loading as normal image with colon in file name
+      getBasicImageIO(name, true).loadHeader(name, width, height, depth);
+    }
+  }
+  else
+  {
+    getBasicImageIO(name, true).loadHeader(name, width, height, depth);
+  }
+
+  if (!isCacheableStamp(stamp))
+  {
+    return;
+  }
+
+  gutil::Lock lock(cache.mutex);
+  ImageInfo *info=createImageInfo(cache, name, stamp);
+
+  if (info != 0)
+  {
+    info->header=true;
+    info->width=width;
+    info->height=height;
+    info->depth=depth;
+  }
+}
+
+namespace
+{
+
+/**
+ * Part of a tile that is needed for loading a part of a tiled image.
+ */
+
+struct TilePart
+{
+  std::string name;
+  long tx, ty;
+  long px, py, pw, ph;
+};
+
+/**
+ * Loads a part of a tile. If the tile cache is enabled, the whole tile is
+ * taken from the cache or loaded and stored in the cache, and the part is
+ * copied from it. As for loading parts directly, pixels outside the tile
+ * are invalid.
+ */
+
+template<class T> void loadTilePart(const BasicImageIO &io, Image<T> &image, const TilePart &p)
+{
+  TileCache &cache=getTileCache();
+
+  if (cache.getCapacity() == 0 || p.pw <= 0 || p.ph <= 0)
+  {
+    io.load(image, p.name.c_str(), 1, p.px, p.py, p.pw, p.ph);
+    return;
+  }
+
+  long long mtime=gutil::getFileModificationTime(p.name.c_str());
+  std::shared_ptr<const Image<T> > tile=cache.get<T>(p.name, mtime);
+
+  if (!tile)
+  {
+    std::shared_ptr<Image<T> > t(new Image<T>());
+
+    io.load(*t, p.name.c_str());
+    cache.put<T>(p.name, mtime, t);
+
+    tile=t;
+  }
+
+  image.setSize(p.pw, p.ph, tile->getDepth());
+  image.clear();
+
+  long w=std::min(p.pw, tile->getWidth()-p.px);
+  long h=std::min(p.ph, tile->getHeight()-p.py);
+
+  if (w > 0 && h > 0)
+  {
+    ImageView<T>(image, 0, 0, w, h).copyFrom(ImageView<const T>(*tile, p.px, p.py, w, h));
+
+    // like loading a part directly, map all invalid values to the same
+    // representation
+
+    if (p.px != 0 || p.py != 0 || p.pw != tile->getWidth() || p.ph != tile->getHeight())
+    {
+      const T inv=Image<T>::ptraits::limit(Image<T>::ptraits::invalid());
+
+      for (int d=0; d<image.getDepth(); d++)
+      {
+        for (long k=0; k<h; k++)
+        {
+          T *row=image.getPtr(0, k, d);
+
+          for (long i=0; i<w; i++)
+          {
+            if (!image.isValidS(row[i]))
+            {
+              row[i]=inv;
+            }
+          }
+        }
+      }
+    }
   }
+}
+
+/**
+ * Loads the given tile parts concurrently. If a target image is given, each
+ * tile part is copied into its window of the target, which starts at
+ * tx*cwidth+px-x and ty*cheight+py-y. Otherwise, the tile parts are stored
+ * in the tile list. Exceptions of the threads are re-thrown by rethrow().
+ */
+
+template<class T> class TileLoadFct : public gutil::ParallelFunction
+{
+  private:
+
+    const BasicImageIO &io;
+    const std::vector<TilePart> &part;
+    std::vector<Image<T> > *tile;
+    Image<T> *target;
+    long cwidth, cheight, x, y;
+
+    gutil::Semaphore mutex;
+    std::exception_ptr error;
+
+    TileLoadFct(const TileLoadFct<T> &);
+    TileLoadFct<T> &operator=(const TileLoadFct<T> &);
+
+  public:
+
+    TileLoadFct(const BasicImageIO &_io, const std::vector<TilePart> &_part,
+                std::vector<Image<T> > &_tile) : io(_io), part(_part), tile(&_tile),
+      target(0), cwidth(0), cheight(0), x(0), y(0), mutex(1)
+    { }
+
+    TileLoadFct(const BasicImageIO &_io, const std::vector<TilePart> &_part,
+                Image<T> &_target, long _cwidth, long _cheight, long _x, long _y) :
+      io(_io), part(_part), tile(0), target(&_target), cwidth(_cwidth), cheight(_cheight),
+      x(_x), y(_y), mutex(1)
+    { }
+
+    void run(long start, long end, long step)
+    {
+      Image<T> timage;
+
+      for (long j=start; j<=end; j+=step)
+      {
+        try
+        {
+          const TilePart &p=part[j];
+
+          if (target != 0)
+          {
+            loadTilePart(io, timage, p);
+
+            // copy part of tile into the corresponding window of the image,
+            // the windows of different tiles do not overlap
+
+            ImageView<T>(*target, p.tx*cwidth+p.px-x, p.ty*cheight+p.py-y, timage.getWidth(),
+                         timage.getHeight()).copyFrom(timage);
+          }
+          else
+          {
+            loadTilePart(io, (*tile)[j], p);
+          }
+        }
+        catch (...)
+        {
+          gutil::Lock lock(mutex);
+
+          if (!error)
+          {
+            error=std::current_exception();
+          }
+        }
+      }
+    }
+
+    void rethrow()
+    {
+      if (error)
+      {
+        std::rethrow_exception(error);
+      }
+    }
+};
+
+/**
+ * Accumulates the given tile parts with downscaling into the rows of a
+ * window of the target image. The window holds depth layers of w values per
+ * row, starting at row base. Each row of the window is only accessed by one
+ * thread. The tiles are added in the order of the list, which leads to the
+ * same result as sequential accumulation.
+ */
+
+template<class T> class TileBlendFct : public gutil::ParallelFunction
+{
+  private:
+
+    const std::vector<TilePart> &part;
+    const std::vector<Image<T> > &tile;
+    std::vector<float> &value;
+    std::vector<float> &count;
+    long base, w;
+    int depth, ds;
+    long cwidth, cheight, twidth, theight, tborder, x, y;
+
+    TileBlendFct(const TileBlendFct<T> &);
+    TileBlendFct<T> &operator=(const TileBlendFct<T> &);
+
+  public:
+
+    TileBlendFct(const std::vector<TilePart> &_part, const std::vector<Image<T> > &_tile,
+                 std::vector<float> &_value, std::vector<float> &_count, long _base, long _w,
+                 int _depth, int _ds, long _cwidth, long _cheight, long _twidth,
+                 long _theight, long _tborder, long _x, long _y) :
+      part(_part), tile(_tile), value(_value), count(_count), base(_base), w(_w),
+      depth(_depth), ds(_ds), cwidth(_cwidth), cheight(_cheight), twidth(_twidth),
+      theight(_theight), tborder(_tborder), x(_x), y(_y)
+    { }
+
+    void run(long start, long end, long step)
+    {
+      for (long yy=start; yy<=end; yy+=step)
+      {
+        float *vrow=&value[(yy-base)*depth*w];
+        float *crow=&count[(yy-base)*w];
+
+        for (size_t j=0; j<part.size(); j++)
+        {
+          const TilePart &p=part[j];
+          const Image<T> &timage=tile[j];
+
+          // offset of the tile part in the downscaled target, in full
+          // resolution
+
+          long ox=p.tx*cwidth-tborder+p.px-x*ds;
+          long oy=p.ty*cheight-tborder+p.py-y*ds;
+
+          long k1=std::max(0l, yy*ds-oy);
+          long k2=std::min(timage.getHeight(), (yy+1)*ds-oy);
+
+          for (long k=k1; k<k2; k++)
+          {
+            for (long i=0; i<timage.getWidth(); i++)
+            {
+              if (timage.isValid(i, k))
+              {
+                long xx=(ox+i)/ds;
+
+                if (tborder > 0)
+                {
+                  float cx=std::min((p.px+i)/(2.0f*tborder), (twidth-p.px-i)/(2.0f*tborder));
+                  float cy=std::min((p.py+k)/(2.0f*tborder), (theight-p.py-k)/(2.0f*tborder));
+
+                  cx=std::max(1e-6f, std::min(1.0f, cx));
+                  cy=std::max(1e-6f, std::min(1.0f, cy));
 
-  // compute total size
+                  float c=cx*cy;
 
-  width=(twidth-2*tborder)*cols;
-  height=(theight-2*tborder)*rows;
-}
+                  for (int d=0; d<depth; d++)
+                  {
+                    vrow[d*w+xx]+=c*static_cast<float>(timage.get(i, k, d));
+                  }
 
-}
+                  crow[xx]+=c;
+                }
+                else
+                {
+                  for (int d=0; d<depth; d++)
+                  {
+                    vrow[d*w+xx]+=static_cast<float>(timage.get(i, k, d));
+                  }
 
-void ImageIO::loadHeader(const char *name, long &width, long &height,
-                         int &depth) const
+                  crow[xx]++;
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+};
+
+/**
+ * Stores all rows of the window before row k into the target image and
+ * removes them from the window.
+ */
+
+template<class T> void storeTileWindow(Image<T> &image, std::vector<float> &value,
+                                       std::vector<float> &count, long &base, long k)
 {
-  std::string s=name;
-  size_t pos=s.rfind(':');
+  const long w=image.getWidth();
+  const int depth=image.getDepth();
 
-  if (pos != s.npos && s.compare(pos, 2, ":\\") == 0)
+  k=std::min(k, base+static_cast<long>(count.size())/std::max(1l, w));
+
+  if (k <= base)
   {
-    pos=s.npos;
+    return;
   }
 
-  if (pos != s.npos)
+  for (long r=base; r<k; r++)
   {
-    try
-    {
-      // extract prefix and suffix from file name
-
-      std::string prefix=s.substr(0, pos);
-      std::string suffix=s.substr(pos+1);
-
-      // get header information
-
-      std::set<std::string> list;
-      long twidth;
-      long theight;
-      long tborder;
+    const float *vrow=&value[(r-base)*depth*w];
+    const float *crow=&count[(r-base)*w];
 
-      loadTiledHeader(getBasicImageIO(name, true), list, prefix, suffix, twidth,
-                      theight, tborder, width, height, depth);
-    }
-    catch (const std::exception &)
+    for (long i=0; i<w; i++)
     {
-      // if loading as tiled image failes, try loading as normal image with colon in file name
-      getBasicImageIO(name, true).loadHeader(name, width, height, depth);
+      float c=crow[i];
+
+      if (c > 0)
+      {
+        for (int d=0; d<depth; d++)
+        {
+          image.set(i, r, d, static_cast<typename Image<T>::store_t>(vrow[d*w+i]/c));
+        }
+      }
     }
   }
-  else
-  {
-    getBasicImageIO(name, true).loadHeader(name, width, height, depth);
-  }
+
+  value.erase(value.begin(), value.begin()+(k-base)*depth*w);
+  count.erase(count.begin(), count.begin()+(k-base)*w);
+  base=k;
 }
 
-namespace
-{
+/**
+ * Loads a part of a tiled image. Tiles are loaded concurrently by up to
+ * gutil::Thread::getMaxThreads() threads. If downscaling or overlapping
+ * tiles are involved, the tiles are accumulated row of tiles by row of
+ * tiles into a window of the target image that only covers the rows that
+ * can still be changed.
+ */
 
 template<class T> void loadTiled(const BasicImageIO &io, Image<T> &image,
                                  const char *name, int ds, long x, long y, long w, long h)
@@ -423,16 +2016,14 @@ template<class T> void loadTiled(const BasicImageIO &io, Image<T> &image,
 
   // get information about the tiled image
 
-  std::set<std::string> list;
-  long twidth, cwidth;
-  long theight, cheight;
-  long tborder;
-  long width;
-  long height;
-  int  depth;
+  std::shared_ptr<const TileIndex> index=getTileIndex(io, prefix, suffix);
 
-  loadTiledHeader(io, list, prefix, suffix, twidth, theight, tborder, width,
-                  height, depth);
+  long twidth=index->twidth, cwidth;
+  long theight=index->theight, cheight;
+  long tborder=index->tborder;
+  long width=index->width;
+  long height=index->height;
+  int  depth=index->depth;
 
   if (w <= 0)
   {
@@ -447,6 +2038,9 @@ template<class T> void loadTiled(const BasicImageIO &io, Image<T> &image,
   cwidth=twidth-2*tborder;
   cheight=theight-2*tborder;
 
+  image.setSize(w, h, depth);
+  image.clear();
+
   if (ds == 1 && tborder == 0) // loading without downscaling and overlapping tiles
   {
     // determine block of tiles that is involved
@@ -456,48 +2050,36 @@ template<class T> void loadTiled(const BasicImageIO &io, Image<T> &image,
     int tx2=(x+w-1)/cwidth;
     int ty2=(y+h-1)/cheight;
 
-    // go through all tiles
+    // collect parts of all existing tiles
 
-    image.setSize(w, h, depth);
-    image.clear();
+    std::vector<TilePart> part;
 
     for (int ty=ty1; ty<=ty2; ty++)
     {
       for (int tx=tx1; tx<=tx2; tx++)
       {
-        // load part of tile
+        TilePart p;
 
-        long px=std::max(0l, x-tx*cwidth);
-        long py=std::max(0l, y-ty*cheight);
-        long pw=std::min(twidth-px, x+w-px-tx*cwidth);
-        long ph=std::min(theight-py, y+h-py-ty*cheight);
+        p.name=getTileName(prefix, ty, tx, suffix);
+        p.tx=tx;
+        p.ty=ty;
+        p.px=std::max(0l, x-tx*cwidth);
+        p.py=std::max(0l, y-ty*cheight);
+        p.pw=std::min(twidth-p.px, x+w-p.px-tx*cwidth);
+        p.ph=std::min(theight-p.py, y+h-p.py-ty*cheight);
 
-        std::string   tname=getTileName(prefix, ty, tx, suffix);
-        Image<T> timage(pw, ph, depth);
-
-        if (list.find(tname) != list.end())
+        if (index->hasTile(ty, tx))
         {
-          io.load(timage, tname.c_str(), 1, px, py, pw, ph);
-
-          // copy part of tile with downscaling
-
-          for (long k=0; k<timage.getHeight(); k++)
-          {
-            const long yy=ty*cheight+py+k-y;
-
-            for (long i=0; i<timage.getWidth(); i++)
-            {
-              const long xx=tx*cwidth+px+i-x;
-
-              for (int d=0; d<depth; d++)
-              {
-                image.set(xx, yy, d, timage.get(i, k, d));
-              }
-            }
-          }
+          part.push_back(p);
         }
       }
     }
+
+    // load all tiles directly into the target image
+
+    TileLoadFct<T> fct(io, part, image, cwidth, cheight, x, y);
+    gutil::runParallel(fct, 0, static_cast<long>(part.size())-1, 1);
+    fct.rethrow();
   }
   else
   {
@@ -508,93 +2090,94 @@ template<class T> void loadTiled(const BasicImageIO &io, Image<T> &image,
     int tx2=((x+w-1)*ds+tborder)/cwidth;
     int ty2=((y+h-1)*ds+tborder)/cheight;
 
-    // go through all tiles
+    // window of rows of the target image that can still be changed
 
-    std::valarray<float> value(w*h*depth);
-    std::valarray<float> count(w*h);
+    std::vector<float> value;
+    std::vector<float> count;
+    long base=0;
+
+    const long n=std::max(1, gutil::Thread::getMaxThreads());
 
     for (int ty=ty1; ty<=ty2; ty++)
     {
-      for (int tx=tx1; tx<=tx2; tx++)
-      {
-        // load part of tile
+      long py=std::max(0l, y*ds-(ty*cheight-tborder));
+      long ph=std::min(theight-py, (y+h)*ds-py-(ty*cheight-tborder));
+
+      // rows before the first row of this row of tiles are final
 
-        long px=std::max(0l, x*ds-(tx*cwidth-tborder));
-        long py=std::max(0l, y*ds-(ty*cheight-tborder));
-        long pw=std::min(twidth-px, (x+w)*ds-px-(tx*cwidth-tborder));
-        long ph=std::min(theight-py, (y+h)*ds-py-(ty*cheight-tborder));
+      storeTileWindow(image, value, count, base, (ty*cheight-tborder+py-y*ds)/ds);
+      base=std::max(base, (ty*cheight-tborder+py-y*ds)/ds);
 
-        std::string   tname=getTileName(prefix, ty, tx, suffix);
-        Image<T> timage(pw, ph, depth);
+      // process tiles of this row in chunks with one tile per thread, so
+      // that the memory for loaded tiles is limited
+
+      for (int tx=tx1; tx<=tx2; tx+=n)
+      {
+        std::vector<TilePart> part;
 
-        if (list.find(tname) != list.end())
+        for (int t=tx; t<=tx2 && t<tx+n; t++)
         {
-          io.load(timage, tname.c_str(), 1, px, py, pw, ph);
+          TilePart p;
 
-          // copy part of tile with downscaling
+          p.name=getTileName(prefix, ty, t, suffix);
+          p.tx=t;
+          p.ty=ty;
+          p.px=std::max(0l, x*ds-(t*cwidth-tborder));
+          p.py=py;
+          p.pw=std::min(twidth-p.px, (x+w)*ds-p.px-(t*cwidth-tborder));
+          p.ph=ph;
 
-          for (long k=0; k<timage.getHeight(); k++)
+          if (index->hasTile(ty, t))
           {
-            for (long i=0; i<timage.getWidth(); i++)
-            {
-              if (timage.isValid(i, k))
-              {
-                long xx=(tx*cwidth-tborder+px+i-x*ds)/ds;
-                long yy=(ty*cheight-tborder+py+k-y*ds)/ds;
+            part.push_back(p);
+          }
+        }
 
-                if (tborder > 0)
-                {
-                  float cx=std::min((px+i)/(2.0f*tborder), (twidth-px-i)/(2.0f*tborder));
-                  float cy=std::min((py+k)/(2.0f*tborder), (theight-py-k)/(2.0f*tborder));
+        if (part.size() == 0)
+        {
+          continue;
+        }
 
-                  cx=std::max(1e-6f, std::min(1.0f, cx));
-                  cy=std::max(1e-6f, std::min(1.0f, cy));
+        std::vector<Image<T> > tile(part.size());
 
-                  float c=cx*cy;
+        TileLoadFct<T> lfct(io, part, tile);
+        gutil::runParallel(lfct, 0, static_cast<long>(part.size())-1, 1);
+        lfct.rethrow();
 
-                  for (int d=0; d<depth; d++)
-                  {
-                    value[(d*h+yy)*w+xx]+=c*static_cast<float>(timage.get(i, k, d));
-                  }
+        // extend window to all rows that are affected by the loaded tiles
 
-                  count[yy*w+xx]+=c;
-                }
-                else
-                {
-                  for (int d=0; d<depth; d++)
-                  {
-                    value[(d*h+yy)*w+xx]+=static_cast<float>(timage.get(i, k, d));
-                  }
+        long k1=(ty*cheight-tborder+py-y*ds)/ds;
+        long k2=k1-1;
 
-                  count[yy*w+xx]++;
-                }
-              }
-            }
+        for (size_t j=0; j<tile.size(); j++)
+        {
+          if (tile[j].getHeight() > 0)
+          {
+            k2=std::max(k2, (ty*cheight-tborder+py+tile[j].getHeight()-1-y*ds)/ds);
           }
         }
-      }
-    }
-
-    // copy result to target image
 
-    image.setSize(w, h, depth);
-    image.clear();
-
-    for (long k=0; k<h; k++)
-    {
-      for (long i=0; i<w; i++)
-      {
-        float c=count[k*w+i];
+        k2=std::min(k2, h-1);
 
-        if (c > 0)
+        if (k2 < k1)
         {
-          for (int d=0; d<depth; d++)
-          {
-            image.set(i, k, d, static_cast<typename Image<T>::store_t>(value[(d*h+k)*w+i]/c));
-          }
+          continue;
         }
+
+        long rows=std::max(static_cast<long>(count.size())/std::max(1l, w), k2+1-base);
+
+        value.resize(rows*depth*w);
+        count.resize(rows*w);
+
+        // accumulate tiles in parallel stripes of rows
+
+        TileBlendFct<T> bfct(part, tile, value, count, base, w, depth, ds, cwidth, cheight,
+                             twidth, theight, tborder, x, y);
+        gutil::runParallel(bfct, k1, k2, 1);
       }
     }
+
+    storeTileWindow(image, value, count, base, h);
   }
 }
 
@@ -602,12 +2185,54 @@ template<class T> void loadTiled(const BasicImageIO &io, Image<T> &image,
 
 void ImageIO::loadProperties(gutil::Properties &prop, const char *name) const
 {
+  // the cache is only used if there are no given properties that may be
+  // merged
+
+  if (!prop.isEmpty())
+  {
+    getBasicImageIO(name, true).loadProperties(prop, name);
+    return;
+  }
+
+  ImageInfoCache &cache=getImageInfoCache();
+  long long stamp[7];
+
+  getImageInfoStamp(stamp, name);
+
+  {
+    gutil::Lock lock(cache.mutex);
+    ImageInfo *info=getImageInfo(cache, name, stamp);
+
+    if (info != 0 && info->properties)
+    {
+      prop=info->prop;
+      return;
+    }
+  }
+
   getBasicImageIO(name, true).loadProperties(prop, name);
+
+  if (!isCacheableStamp(stamp))
+  {
+    return;
+  }
+
+  gutil::Lock lock(cache.mutex);
+  ImageInfo *info=createImageInfo(cache, name, stamp);
+
+  if (info != 0)
+  {
+    info->properties=true;
+    info->prop=prop;
+  }
 }
 
 void ImageIO::load(ImageU8 &image, const char *name, int ds, long x, long y,
                    long w, long h) const
 {
+  Timing timing;
+  timing.start("load", name);
+
   std::string s=name;
   size_t pos=s.rfind(':');
 
@@ -632,11 +2257,16 @@ void ImageIO::load(ImageU8 &image, const char *name, int ds, long x, long y,
       getBasicImageIO(name, true).load(image, name, ds, x, y, w, h);
     }
   }
+
+  timing.stop(static_cast<double>(image.getWidth())*image.getHeight());
 }
 
 void ImageIO::load(ImageU16 &image, const char *name, int ds, long x, long y,
                    long w, long h) const
 {
+  Timing timing;
+  timing.start("load", name);
+
   std::string s=name;
   size_t pos=s.rfind(':');
 
@@ -661,11 +2291,16 @@ void ImageIO::load(ImageU16 &image, const char *name, int ds, long x, long y,
       getBasicImageIO(name, true).load(image, name, ds, x, y, w, h);
     }
   }
+
+  timing.stop(static_cast<double>(image.getWidth())*image.getHeight());
 }
 
 void ImageIO::load(ImageFloat &image, const char *name, int ds, long x, long y,
                    long w, long h) const
 {
+  Timing timing;
+  timing.start("load", name);
+
   std::string s=name;
   size_t pos=s.rfind(':');
 
@@ -690,6 +2325,8 @@ void ImageIO::load(ImageFloat &image, const char *name, int ds, long x, long y,
       getBasicImageIO(name, true).load(image, name, ds, x, y, w, h);
     }
   }
+
+  timing.stop(static_cast<double>(image.getWidth())*image.getHeight());
 }
 
 void ImageIO::saveProperties(const gutil::Properties &prop, const char *name) const
@@ -699,17 +2336,210 @@ void ImageIO::saveProperties(const gutil::Properties &prop, const char *name) co
 
 void ImageIO::save(const ImageU8 &image, const char *name) const
 {
+  Timing timing;
+  timing.start("save", name);
+
   getBasicImageIO(name, false).save(image, name);
+
+  timing.stop(static_cast<double>(image.getWidth())*image.getHeight());
 }
 
 void ImageIO::save(const ImageU16 &image, const char *name) const
 {
+  Timing timing;
+  timing.start("save", name);
+
   getBasicImageIO(name, false).save(image, name);
+
+  timing.stop(static_cast<double>(image.getWidth())*image.getHeight());
 }
 
 void ImageIO::save(const ImageFloat &image, const char *name) const
 {
+  Timing timing;
+  timing.start("save", name);
+
   getBasicImageIO(name, false).save(image, name);
+
+  timing.stop(static_cast<double>(image.getWidth())*image.getHeight());
+}
+
+ImageReader *ImageIO::openReader(const char *name) const
+{
+  std::string s=name;
+  size_t pos=s.rfind(':');
+
+  if (pos != s.npos && s.compare(pos, 2, ":\\") == 0)
+  {
+    pos=s.npos;
+  }
+
+  if (pos == s.npos)
+  {
+    return getBasicImageIO(name, true).openReader(name);
+  }
+
+  // tiled images are read by loading the parts of all affected tiles
+
+  long width, height;
+  int  depth;
+
+  loadHeader(name, width, height, depth);
+
+  return new LoadImageReader<ImageIO>(*this, name, width, height, depth);
+}
+
+ImageWriter *ImageIO::openWriter(const char *name, long width, long height, int depth) const
+{
+  return getBasicImageIO(name, false).openWriter(name, width, height, depth);
+}
+
+template<class T> ImageFuture ImageIO::loadAsyncInternal(Image<T> &image, const char *name,
+    int ds, long x, long y, long w, long h) const
+{
+  ImageFuture ret;
+
+  ret.state=std::make_shared<AsyncState>();
+
+  try
+  {
+    const BasicImageIO *io=&getBasicImageIO(name, true);
+    std::string s=name;
+    Image<T> *p=&image;
+
+    pool->add(io, [this, p, s, ds, x, y, w, h]()
+    {
+      load(*p, s.c_str(), ds, x, y, w, h);
+    }, ret.state);
+  }
+  catch (...)
+  {
+    ret.state->finish(AsyncState::finished, std::current_exception());
+  }
+
+  return ret;
+}
+
+template<class T> ImageFuture ImageIO::saveAsyncInternal(const Image<T> &image,
+    const char *name) const
+{
+  ImageFuture ret;
+
+  ret.state=std::make_shared<AsyncState>();
+
+  try
+  {
+    const BasicImageIO *io=&getBasicImageIO(name, false);
+    std::string s=name;
+    const Image<T> *p=&image;
+
+    pool->add(io, [this, p, s]()
+    {
+      save(*p, s.c_str());
+    }, ret.state);
+  }
+  catch (...)
+  {
+    ret.state->finish(AsyncState::finished, std::current_exception());
+  }
+
+  return ret;
+}
+
+ImageFuture ImageIO::loadAsync(ImageU8 &image, const char *name, int ds, long x, long y,
+                               long w, long h) const
+{
+  return loadAsyncInternal(image, name, ds, x, y, w, h);
+}
+
+ImageFuture ImageIO::loadAsync(ImageU16 &image, const char *name, int ds, long x, long y,
+                               long w, long h) const
+{
+  return loadAsyncInternal(image, name, ds, x, y, w, h);
+}
+
+ImageFuture ImageIO::loadAsync(ImageFloat &image, const char *name, int ds, long x, long y,
+                               long w, long h) const
+{
+  return loadAsyncInternal(image, name, ds, x, y, w, h);
+}
+
+ImageFuture ImageIO::loadAsync(ImageU8 &imageu8, ImageU16 &imageu16, ImageFloat &imagef,
+                               const char *name, int ds, long x, long y, long w, long h) const
+{
+  ImageFuture ret;
+
+  ret.state=std::make_shared<AsyncState>();
+
+  try
+  {
+    const BasicImageIO *io=&getBasicImageIO(name, true);
+    std::string s=name;
+    ImageU8 *pu8=&imageu8;
+    ImageU16 *pu16=&imageu16;
+    ImageFloat *pf=&imagef;
+
+    pool->add(io, [this, pu8, pu16, pf, s, ds, x, y, w, h]()
+    {
+      pu16->setSize(0, 0, 0);
+      pf->setSize(0, 0, 0);
+
+      try
+      {
+        load(*pu8, s.c_str(), ds, x, y, w, h);
+      }
+      catch (const gutil::Exception &)
+      {
+        pu8->setSize(0, 0, 0);
+
+        try
+        {
+          load(*pu16, s.c_str(), ds, x, y, w, h);
+        }
+        catch (const gutil::Exception &)
+        {
+          pu16->setSize(0, 0, 0);
+          load(*pf, s.c_str(), ds, x, y, w, h);
+        }
+      }
+    }, ret.state);
+  }
+  catch (...)
+  {
+    ret.state->finish(AsyncState::finished, std::current_exception());
+  }
+
+  return ret;
+}
+
+ImageFuture ImageIO::saveAsync(const ImageU8 &image, const char *name) const
+{
+  return saveAsyncInternal(image, name);
+}
+
+ImageFuture ImageIO::saveAsync(const ImageU16 &image, const char *name) const
+{
+  return saveAsyncInternal(image, name);
+}
+
+ImageFuture ImageIO::saveAsync(const ImageFloat &image, const char *name) const
+{
+  return saveAsyncInternal(image, name);
+}
+
+void ImageIO::setAsyncThreads(int n)
+{
+  pool->setThreads(n);
+}
+
+int ImageIO::getAsyncThreads() const
+{
+  return pool->getThreads();
+}
+
+void ImageIO::setAsyncLimit(const char *name, int n)
+{
+  pool->setLimit(&getBasicImageIO(name, false), n);
 }
 
 const BasicImageIO &ImageIO::getBasicImageIO(const char *name, bool reading) const
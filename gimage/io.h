@@ -42,11 +42,136 @@
 #include <gutil/properties.h>
 #include <gutil/exception.h>
 
+#include <string>
 #include <vector>
+#include <memory>
 
 namespace gimage
 {
 
+/**
+ * Reads an image sequentially in bands of rows, so that the required memory
+ * is bounded by the size of a band instead of the size of the image. Like
+ * for loading, the stored pixel values are casted into the type of the band
+ * if it is equal or larger. Otherwise, gutil::IOException is thrown.
+ */
+
+class ImageReader
+{
+  public:
+
+    virtual ~ImageReader() {}
+
+    long getWidth() const { return width; }
+    long getHeight() const { return height; }
+    int getDepth() const { return depth; }
+
+    /**
+     * Returns the index of the next row that will be read.
+     */
+
+    long getRow() const { return row; }
+
+    /**
+     * Reads the next n rows into the band, which is resized accordingly. The
+     * last band of the image may have less rows. False is returned if all
+     * rows have already been read. The position is not changed if an
+     * exception is thrown.
+     */
+
+    bool read(ImageU8 &band, long n);
+    bool read(ImageU16 &band, long n);
+    bool read(ImageFloat &band, long n);
+
+  protected:
+
+    ImageReader(long width, long height, int depth);
+
+    /**
+     * Reads the rows starting with row k into the band, which already has
+     * the required size. By default, 16 bit and float bands are read as the
+     * next smaller type and converted.
+     */
+
+    virtual void readRows(ImageU8 &band, long k);
+    virtual void readRows(ImageU16 &band, long k);
+    virtual void readRows(ImageFloat &band, long k);
+
+  private:
+
+    ImageReader(const ImageReader &);
+    ImageReader &operator=(const ImageReader &);
+
+    template<class T> bool readBand(Image<T> &band, long n);
+
+    long width, height, row;
+    int  depth;
+};
+
+/**
+ * Writes an image sequentially in bands of rows. All bands must have the
+ * width and depth of the image and the same pixel type. The image is only
+ * complete after close() has been called.
+ */
+
+class ImageWriter
+{
+  public:
+
+    virtual ~ImageWriter() {}
+
+    long getWidth() const { return width; }
+    long getHeight() const { return height; }
+    int getDepth() const { return depth; }
+
+    /**
+     * Returns the index of the next row that will be written.
+     */
+
+    long getRow() const { return row; }
+
+    void write(const ImageU8 &band);
+    void write(const ImageU16 &band);
+    void write(const ImageFloat &band);
+
+    /**
+     * Finishes the file. An exception is thrown if not all rows have been
+     * written.
+     */
+
+    void close();
+
+  protected:
+
+    ImageWriter(long width, long height, int depth);
+
+    /**
+     * Writes the band as rows starting with row k. By default, an exception
+     * is thrown.
+     */
+
+    virtual void writeRows(const ImageU8 &band, long k);
+    virtual void writeRows(const ImageU16 &band, long k);
+    virtual void writeRows(const ImageFloat &band, long k);
+
+    /**
+     * Called by close() after all rows have been written.
+     */
+
+    virtual void finish() {}
+
+  private:
+
+    ImageWriter(const ImageWriter &);
+    ImageWriter &operator=(const ImageWriter &);
+
+    template<class T> void writeBand(const Image<T> &band, int type);
+
+    long width, height, row;
+    int  depth, type;
+    bool closed;
+};
+
 /**
  * Virtual base class for loading and saving images. The sub-classes implement
  * loading and saving for different file formats.
@@ -87,6 +212,86 @@ class BasicImageIO
     virtual void save(const ImageU8 &image, const char *name) const;
     virtual void save(const ImageU16 &image, const char *name) const;
     virtual void save(const ImageFloat &image, const char *name) const;
+
+    /**
+     * Opens the image for reading it in bands of rows. By default, each band
+     * is loaded as part of the image by load(). The returned object must be
+     * deleted by the caller.
+     */
+
+    virtual ImageReader *openReader(const char *name) const;
+
+    /**
+     * Creates an image with the given size for writing it in bands of rows.
+     * By default, all bands are collected and the image is saved by save()
+     * when the writer is closed. The returned object must be deleted by the
+     * caller.
+     */
+
+    virtual ImageWriter *openWriter(const char *name, long width, long height,
+                                    int depth) const;
+};
+
+struct AsyncState;
+class AsyncPool;
+
+/**
+ * Result of an asynchronous request for loading or saving an image. A
+ * request that has not been started yet can be cancelled, e.g. if it has
+ * been superseded by another request. Destroying a valid future cancels the
+ * request or waits until it is finished, so that the image is not accessed
+ * anymore afterwards.
+ */
+
+class ImageFuture
+{
+  public:
+
+    ImageFuture() {}
+    ImageFuture(ImageFuture &&a);
+    ~ImageFuture();
+
+    ImageFuture &operator=(ImageFuture &&a);
+
+    bool valid() const { return static_cast<bool>(state); }
+
+    /**
+     * Returns true if the request has been finished, has failed or has been
+     * cancelled.
+     */
+
+    bool isReady() const;
+
+    /**
+     * Waits until the request is finished.
+     */
+
+    void wait() const;
+
+    /**
+     * Waits until the request is finished and throws the exception of a
+     * failed or cancelled request. The future is not valid afterwards.
+     */
+
+    void get();
+
+    /**
+     * Cancels the request if it has not been started yet. True is returned
+     * if the request has been cancelled.
+     */
+
+    bool cancel();
+
+  private:
+
+    friend class ImageIO;
+
+    ImageFuture(const ImageFuture &);
+    ImageFuture &operator=(const ImageFuture &);
+
+    void release();
+
+    std::shared_ptr<AsyncState> state;
 };
 
 /**
@@ -99,6 +304,19 @@ class BasicImageIO
  * <prefix>:<suffix>. The tiles must have the same size and image format and
  * named as <prefix>_<row number>_<column number>_<suffix>.
  *
+ * The results of loadHeader() and loadProperties() are cached process wide.
+ * A cached entry is used as long as the size and modification time of the
+ * image and the modification times of its optional header and parameter
+ * files do not change. Names for which none of these files exist are not
+ * cached, since changes cannot be detected.
+ *
+ * For saving images:
+ *
+ * PNG images are compressed with the zlib level and the filter type that are
+ * given in the environment variables CVKIT_PNG_LEVEL (0 to 9) and
+ * CVKIT_PNG_FILTER (none, sub, up, average, paeth or adaptive). By default,
+ * the zlib default level and the adaptive filter are used.
+ *
  * Thread safety:
  *
  * Add BasicImageIO objects before starting additional threads.
@@ -109,6 +327,7 @@ class ImageIO
   public:
 
     ImageIO();
+    ~ImageIO();
 
     void addBasicImageIO(const BasicImageIO &io);
 
@@ -124,16 +343,89 @@ class ImageIO
     void load(ImageFloat &image, const char *name, int ds=1, long x=0, long y=0, long w=-1,
               long h=-1) const;
 
+    /**
+     * Loads header and properties of all given images in parallel into the
+     * cache, so that later calls of loadHeader() and loadProperties() are
+     * fast. Images that cannot be loaded are skipped.
+     */
+
+    void probe(const std::vector<std::string> &list) const;
+
     void saveProperties(const gutil::Properties &prop, const char *name) const;
     void save(const ImageU8 &image, const char *name) const;
     void save(const ImageU16 &image, const char *name) const;
     void save(const ImageFloat &image, const char *name) const;
 
+    /**
+     * Opens an image for reading and creates an image for writing in bands
+     * of rows. Tiled images are read by loading the parts that are covered
+     * by the requested rows. The returned objects must be deleted by the
+     * caller.
+     */
+
+    ImageReader *openReader(const char *name) const;
+    ImageWriter *openWriter(const char *name, long width, long height, int depth) const;
+
+    /**
+     * Loads or saves the image asynchronously in a pool of IO threads, so
+     * that the caller can continue with other work. The image must not be
+     * used or destroyed until the request is finished. Requests are executed
+     * in the order in which they are given, except for requests that must
+     * wait due to the limit of their image format.
+     */
+
+    ImageFuture loadAsync(ImageU8 &image, const char *name, int ds=1, long x=0, long y=0,
+                          long w=-1, long h=-1) const;
+    ImageFuture loadAsync(ImageU16 &image, const char *name, int ds=1, long x=0, long y=0,
+                          long w=-1, long h=-1) const;
+    ImageFuture loadAsync(ImageFloat &image, const char *name, int ds=1, long x=0, long y=0,
+                          long w=-1, long h=-1) const;
+
+    /**
+     * Loads the image asynchronously into the first of the given images that
+     * can represent its pixel type, trying 8 bit, 16 bit and float in this
+     * order, like a synchronous caller would do. Only one of the images is
+     * set if the request is finished successfully.
+     */
+
+    ImageFuture loadAsync(ImageU8 &imageu8, ImageU16 &imageu16, ImageFloat &imagef,
+                          const char *name, int ds=1, long x=0, long y=0, long w=-1,
+                          long h=-1) const;
+
+    ImageFuture saveAsync(const ImageU8 &image, const char *name) const;
+    ImageFuture saveAsync(const ImageU16 &image, const char *name) const;
+    ImageFuture saveAsync(const ImageFloat &image, const char *name) const;
+
+    /**
+     * Sets the number of IO threads. The default is 4 or the value of the
+     * environment variable CVKIT_IO_THREADS.
+     */
+
+    void setAsyncThreads(int n);
+    int getAsyncThreads() const;
+
+    /**
+     * Limits the number of requests that are executed at the same time for
+     * the image format that is used for saving images with the given name,
+     * e.g. "x.tif". 0 means no limit, which is the default.
+     */
+
+    void setAsyncLimit(const char *name, int n);
+
   private:
 
+    ImageIO(const ImageIO &);
+    ImageIO &operator=(const ImageIO &);
+
     const BasicImageIO &getBasicImageIO(const char *name, bool reading) const;
 
+    template<class T> ImageFuture loadAsyncInternal(Image<T> &image, const char *name, int ds,
+                                                    long x, long y, long w, long h) const;
+    template<class T> ImageFuture saveAsyncInternal(const Image<T> &image,
+                                                    const char *name) const;
+
     std::vector<BasicImageIO *> list;
+    AsyncPool *pool;
 };
 
 /**
@@ -142,6 +434,36 @@ class ImageIO
 
 ImageIO &getImageIO();
 
+/**
+ * The index of a tiled image, i.e. the existing tiles, their size and
+ * border, is cached process wide. A cached index is used as long as the
+ * modification times of the directory of the tiles, the first tile and the
+ * optional header files do not change.
+ *
+ * Optionally, the index is also stored in <prefix>_<suffix>.idx next to the
+ * tiles and reused by other processes. This is enabled if the environment
+ * variable CVKIT_TILE_INDEX is set to 1 or by calling
+ * setPersistentTileIndex(true).
+ */
+
+void setPersistentTileIndex(bool enable);
+void clearTileIndexCache();
+
+/**
+ * Removes all cached headers and properties of images.
+ */
+
+void clearImageInfoCache();
+
+/**
+ * Sets the maximum number of images whose headers and properties are cached.
+ * The least recently used entries are removed if the capacity is exceeded.
+ * The default is 4096 or the value of the environment variable
+ * CVKIT_INFO_CACHE. 0 disables caching.
+ */
+
+void setImageInfoCacheCapacity(size_t n);
+
 /**
  * Returns an unused filename for storing an image. The name is derived by
  * splitting the existing name (which may include a directory) into a prefix
@@ -44,6 +44,12 @@
 
 #include <jpeglib.h>
 
+// libjpeg-turbo supports decoding only a part of the image since version 1.5
+
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER) && LIBJPEG_TURBO_VERSION_NUMBER >= 1005000
+#define GIMAGE_JPEG_CROP
+#endif
+
 namespace gimage
 {
 
@@ -201,9 +207,44 @@ void JPEGImageIO::load(ImageU8 &image, const char *name, int ds, long x, long y,
     std::valarray<ImageU8::work_t> vline(0, w*depth);
     std::valarray<int> nline(0, w*depth);
 
+    // first column of the image that is contained in the decoded rows
+
+    long c0=0;
+
+#ifdef GIMAGE_JPEG_CROP
+    // only decode the columns that are needed, the library extends them to
+    // the next iMCU boundary. Upsampling of subsampled chroma components
+    // depends on neighboring columns, which is why some more columns are
+    // decoded, so that the result is the same as without cropping.
+
+    const long margin=32;
+
+    long cx1=std::max(0l, std::max(0l, x)*ds-margin);
+    long cx2=std::min(width, (x+w)*ds+margin);
+
+    if (cx2 > cx1 && (cx1 > 0 || cx2 < width))
+    {
+      JDIMENSION xoffset=static_cast<JDIMENSION>(cx1);
+      JDIMENSION cwidth=static_cast<JDIMENSION>(cx2-cx1);
+
+      jpeg_crop_scanline(&cinfo, &xoffset, &cwidth);
+
+      c0=static_cast<long>(xoffset);
+    }
+#endif
+
     // skip the first y*ds image rows
 
-    for (long k=0; k<y*ds && k<height; k++)
+    long skip=std::min(std::max(0l, y*ds), height);
+
+#ifdef GIMAGE_JPEG_CROP
+    if (skip > 0)
+    {
+      skip-=static_cast<long>(jpeg_skip_scanlines(&cinfo, static_cast<JDIMENSION>(skip)));
+    }
+#endif
+
+    for (long k=0; k<skip; k++)
     {
       jpeg_read_scanlines(&cinfo, &row, 1);
     }
@@ -219,7 +260,7 @@ void JPEGImageIO::load(ImageU8 &image, const char *name, int ds, long x, long y,
       {
         jpeg_read_scanlines(&cinfo, &row, 1);
 
-        int  jj=std::max(0l, x)*ds*depth;
+        long jj=(std::max(0l, x)*ds-c0)*depth;
         long j=std::max(0l, -x)*depth;
 
         for (long i=std::max(0l, -x); i<w && (x+i)*ds<width; i++)
@@ -0,0 +1,276 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mapped.h"
+#include "raw_io.h"
+#include "pnm_io.h"
+
+#ifdef WIN32
+#include <Windows.h>
+#undef min
+#undef max
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace gimage
+{
+
+struct MappedFileData
+{
+  MapMode mode;
+  size_t  size;
+  bool    open;
+  char    *data;
+  void    *base;
+  size_t  length;
+#ifdef WIN32
+  HANDLE  mapping;
+#endif
+};
+
+MappedFile::MappedFile()
+{
+  p=new MappedFileData();
+
+  p->mode=map_read_only;
+  p->size=0;
+  p->open=false;
+  p->data=0;
+  p->base=0;
+  p->length=0;
+#ifdef WIN32
+  p->mapping=0;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+  delete p;
+}
+
+void MappedFile::open(const char *name, long long offset, size_t size, MapMode mode)
+{
+  close();
+
+#ifdef WIN32
+  HANDLE fd=CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL, 0);
+
+  if (fd == INVALID_HANDLE_VALUE)
+  {
+    throw gutil::IOException("Cannot open file for mapping ("+std::string(name)+")");
+  }
+
+  LARGE_INTEGER fsize;
+
+  if (!GetFileSizeEx(fd, &fsize) || fsize.QuadPart < offset+static_cast<long long>(size))
+  {
+    CloseHandle(fd);
+    throw gutil::IOException("File is too small for mapping ("+std::string(name)+")");
+  }
+
+  if (size > 0)
+  {
+    // the offset of the view must be a multiple of the allocation granularity
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    long long start=offset-offset%info.dwAllocationGranularity;
+
+    p->length=static_cast<size_t>(offset-start)+size;
+    p->mapping=CreateFileMappingA(fd, 0, mode == map_read_only ? PAGE_READONLY : PAGE_WRITECOPY,
+                                  0, 0, 0);
+
+    if (p->mapping != 0)
+    {
+      p->base=MapViewOfFile(p->mapping, mode == map_read_only ? FILE_MAP_READ : FILE_MAP_COPY,
+                            static_cast<DWORD>(start>>32),
+                            static_cast<DWORD>(start&0xffffffff), p->length);
+
+      if (p->base == 0)
+      {
+        CloseHandle(p->mapping);
+        p->mapping=0;
+      }
+    }
+
+    if (p->base == 0)
+    {
+      CloseHandle(fd);
+      throw gutil::IOException("Cannot map file ("+std::string(name)+")");
+    }
+
+    p->data=static_cast<char *>(p->base)+(offset-start);
+  }
+
+  CloseHandle(fd);
+#else
+  int fd=::open(name, O_RDONLY);
+
+  if (fd == -1)
+  {
+    throw gutil::IOException("Cannot open file for mapping ("+std::string(name)+")");
+  }
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || static_cast<long long>(st.st_size) < offset+static_cast<long long>(size))
+  {
+    ::close(fd);
+    throw gutil::IOException("File is too small for mapping ("+std::string(name)+")");
+  }
+
+  if (size > 0)
+  {
+    // the offset of the mapping must be a multiple of the page size
+
+    long long start=offset-offset%sysconf(_SC_PAGESIZE);
+
+    p->length=static_cast<size_t>(offset-start)+size;
+
+    if (mode == map_read_only)
+    {
+      p->base=mmap(0, p->length, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(start));
+    }
+    else
+    {
+      p->base=mmap(0, p->length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                   static_cast<off_t>(start));
+    }
+
+    if (p->base == MAP_FAILED)
+    {
+      p->base=0;
+      ::close(fd);
+      throw gutil::IOException("Cannot map file ("+std::string(name)+")");
+    }
+
+    p->data=static_cast<char *>(p->base)+(offset-start);
+  }
+
+  // the mapping stays valid after closing the file descriptor
+
+  ::close(fd);
+#endif
+
+  p->mode=mode;
+  p->size=size;
+  p->open=true;
+}
+
+void MappedFile::close()
+{
+  if (p->base != 0)
+  {
+#ifdef WIN32
+    UnmapViewOfFile(p->base);
+    CloseHandle(p->mapping);
+    p->mapping=0;
+#else
+    munmap(p->base, p->length);
+#endif
+  }
+
+  p->size=0;
+  p->open=false;
+  p->data=0;
+  p->base=0;
+  p->length=0;
+}
+
+bool MappedFile::isOpen() const
+{
+  return p->open;
+}
+
+MapMode MappedFile::getMode() const
+{
+  return p->mode;
+}
+
+size_t MappedFile::getSize() const
+{
+  return p->size;
+}
+
+void *MappedFile::getData() const
+{
+  return p->data;
+}
+
+namespace
+{
+
+template<class T> void mapImageTemplate(MappedImage<T> &image, const char *name, MapMode mode)
+{
+  RAWImageIO raw;
+
+  if (raw.handlesFile(name, true))
+  {
+    raw.map(image, name, mode);
+    return;
+  }
+
+  PNMImageIO pnm;
+
+  if (pnm.handlesFile(name, true))
+  {
+    pnm.map(image, name, mode);
+    return;
+  }
+
+  throw gutil::IOException("Can only map RAW and PGM images ("+std::string(name)+")");
+}
+
+}
+
+void mapImage(MappedImageU8 &image, const char *name, MapMode mode)
+{
+  mapImageTemplate(image, name, mode);
+}
+
+void mapImage(MappedImageU16 &image, const char *name, MapMode mode)
+{
+  mapImageTemplate(image, name, mode);
+}
+
+}
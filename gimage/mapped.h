@@ -0,0 +1,198 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GIMAGE_MAPPED_H
+#define GIMAGE_MAPPED_H
+
+#include "image.h"
+
+#include <gutil/exception.h>
+
+#include <cstddef>
+#include <stdexcept>
+
+namespace gimage
+{
+
+/**
+ * Access mode of memory mapped files.
+ *
+ * map_read_only:     The pixels must not be changed. Writing into them
+ *                    leads to a segmentation fault.
+ * map_copy_on_write: The pixels can be changed. Changed pages are copied
+ *                    privately and never written back to the file.
+ */
+
+enum MapMode {map_read_only, map_copy_on_write};
+
+struct MappedFileData;
+
+/**
+ * Maps a region of a file into memory. Pages are only read from the file
+ * when they are accessed for the first time.
+ */
+
+class MappedFile
+{
+  public:
+
+    MappedFile();
+    ~MappedFile();
+
+    /**
+     * Maps size bytes, starting at the given offset in the file. A previous
+     * mapping is closed before. Throws gutil::IOException if the file cannot
+     * be opened or mapped, or if it is too small.
+     */
+
+    void open(const char *name, long long offset, size_t size, MapMode mode);
+
+    /**
+     * Removes the mapping. All pointers into the mapping become invalid.
+     */
+
+    void close();
+
+    bool isOpen() const;
+    MapMode getMode() const;
+    size_t getSize() const;
+
+    /**
+     * Returns the pointer to the first byte of the mapped region.
+     */
+
+    void *getData() const;
+
+  private:
+
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    MappedFileData *p;
+};
+
+/**
+ * Image that references the pixels of a memory mapped file directly,
+ * instead of loading them. Only rows that are actually accessed cost page
+ * faults, which makes it cheap to work on parts of very large files.
+ *
+ * The image is a wrapper around the mapping and is only valid until the
+ * mapping is closed or the object is destroyed. Its size cannot be changed.
+ */
+
+template<class T> class MappedImage
+{
+  public:
+
+    MappedImage() { }
+
+    /**
+     * Maps an image with one channel of w times h pixels that are stored
+     * without gaps in native byte order at the given offset of the file. The
+     * offset must be a multiple of the pixel size.
+     */
+
+    void map(const char *name, long long offset, long w, long h, MapMode mode)
+    {
+      if (offset%sizeof(T) != 0)
+      {
+        throw gutil::IOException("Pixel data is not aligned for mapping ("+std::string(name)+")");
+      }
+
+      close();
+
+      file.open(name, offset, static_cast<size_t>(w)*h*sizeof(T), mode);
+      image=Image<T>(w, h, 1, static_cast<T *>(file.getData()));
+    }
+
+    void close()
+    {
+      image=Image<T>();
+      file.close();
+    }
+
+    bool isOpen() const { return file.isOpen(); }
+    MapMode getMode() const { return file.getMode(); }
+
+    /**
+     * Returns a read-only view onto the pixels. This is the only access for
+     * read only mappings, since writing into them would crash.
+     */
+
+    ImageView<const T> getImage() const { return ImageView<const T>(image); }
+
+    /**
+     * Returns the image for reading and writing. This is only possible for
+     * copy on write mappings. Changes are never written back to the file.
+     */
+
+    Image<T> &getWritableImage()
+    {
+      if (file.isOpen() && file.getMode() != map_copy_on_write)
+      {
+        throw std::runtime_error("Read only mapped image cannot be changed");
+      }
+
+      return image;
+    }
+
+  private:
+
+    MappedImage(const MappedImage<T> &);
+    MappedImage<T> &operator=(const MappedImage<T> &);
+
+    MappedFile file;
+    Image<T>   image;
+};
+
+typedef MappedImage<gutil::uint8>  MappedImageU8;
+typedef MappedImage<gutil::uint16> MappedImageU16;
+
+/**
+ * Maps a RAW image (see RAWImageIO) in native byte order or a binary PGM
+ * image (see PNMImageIO) directly into memory. Since PGM stores 16 bit
+ * values with the most significant byte first, 16 bit PGM images can only be
+ * mapped on big endian machines. Throws gutil::IOException if the file
+ * cannot be mapped without conversion. In this case, it must be loaded
+ * through ImageIO.
+ */
+
+void mapImage(MappedImageU8 &image, const char *name, MapMode mode=map_read_only);
+void mapImage(MappedImageU16 &image, const char *name, MapMode mode=map_read_only);
+
+}
+
+#endif
@@ -36,23 +36,1036 @@
 #include "png_io.h"
 
 #include <gutil/version.h>
+#include <gutil/thread.h>
+#include <gutil/semaphore.h>
 
 #include <stdexcept>
 #include <sstream>
 #include <cctype>
 #include <cstdlib>
 #include <cstdio>
-#include <valarray>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstring>
 
 #include <png.h>
+#include <zlib.h>
 #include <time.h>
 
 namespace gimage
 {
 
+namespace
+{
+
+/**
+ * Provides the rows of a PNG image in increasing order. Interlaced images
+ * are read completely, otherwise only the current row is kept in memory.
+ * Errors of libpng are reported by longjmp, which skips destructors.
+ * Therefore, memory is only released by calling close() and pointers to it
+ * are volatile so that they are valid after longjmp.
+ */
+
+class PNGRowReader
+{
+  private:
+
+    png_structp   png;
+    unsigned char *volatile img;
+    unsigned char **volatile row;
+    long          next;
+
+  public:
+
+    PNGRowReader()
+    {
+      png=0;
+      img=0;
+      row=0;
+      next=0;
+    }
+
+    /**
+     * Must be called after png_read_update_info().
+     */
+
+    void init(png_structp _png, png_infop info, long height)
+    {
+      png=_png;
+
+      size_t rn=png_get_rowbytes(png, info);
+
+      if (png_get_interlace_type(png, info) != PNG_INTERLACE_NONE)
+      {
+        img=new unsigned char [height*rn];
+        row=new unsigned char * [height];
+
+        for (long k=0; k<height; k++)
+        {
+          row[k]=img+k*rn;
+        }
+
+        png_read_image(png, static_cast<png_bytepp>(row));
+      }
+      else
+      {
+        img=new unsigned char [rn];
+      }
+    }
+
+    /**
+     * Returns the row k. The rows must be requested in increasing order.
+     * Skipped rows are decoded and discarded.
+     */
+
+    const unsigned char *getRow(long k)
+    {
+      if (row != 0)
+      {
+        return row[k];
+      }
+
+      while (next <= k)
+      {
+        png_read_row(png, img, 0);
+        next++;
+      }
+
+      return img;
+    }
+
+    void close()
+    {
+      delete [] row;
+      delete [] img;
+
+      row=0;
+      img=0;
+    }
+};
+
+
+/*
+ * Conversion of a row of an image into the byte representation of PNG, with
+ * interleaved color channels and 16 bit values with the most significant
+ * byte first.
+ */
+
+inline void getPNGRow(unsigned char *row, const ImageU8 &image, long k)
+{
+  for (long i=0; i<image.getWidth(); i++)
+  {
+    for (int j=0; j<image.getDepth(); j++)
+    {
+      *row++=image.get(i, k, j);
+    }
+  }
+}
+
+inline void getPNGRow(unsigned char *row, const ImageU16 &image, long k)
+{
+  for (long i=0; i<image.getWidth(); i++)
+  {
+    for (int j=0; j<image.getDepth(); j++)
+    {
+      ImageU16::store_t v=image.get(i, k, j);
+
+      *row++=static_cast<unsigned char>(v>>8);
+      *row++=static_cast<unsigned char>(v&0xff);
+    }
+  }
+}
+
+inline int paethPredictor(int a, int b, int c)
+{
+  int p=a+b-c;
+  int pa=std::abs(p-a);
+  int pb=std::abs(p-b);
+  int pc=std::abs(p-c);
+
+  if (pa <= pb && pa <= pc)
+  {
+    return a;
+  }
+
+  if (pb <= pc)
+  {
+    return b;
+  }
+
+  return c;
+}
+
+/*
+ * Filters the row of n bytes with the given filter type. The filter type
+ * is stored in out[0], followed by n filtered bytes. prev is the previous
+ * unfiltered row, which is all 0 for the first row. bpp is the number of
+ * bytes per pixel.
+ */
+
+void filterPNGRow(unsigned char *out, const unsigned char *row, const unsigned char *prev,
+                  long n, int bpp, int type)
+{
+  *out++=static_cast<unsigned char>(type);
+
+  switch (type)
+  {
+    case 0:
+      memcpy(out, row, n);
+      break;
+
+    case 1:
+      for (long i=0; i<n; i++)
+      {
+        out[i]=static_cast<unsigned char>(row[i]-(i >= bpp ? row[i-bpp] : 0));
+      }
+      break;
+
+    case 2:
+      for (long i=0; i<n; i++)
+      {
+        out[i]=static_cast<unsigned char>(row[i]-prev[i]);
+      }
+      break;
+
+    case 3:
+      for (long i=0; i<n; i++)
+      {
+        out[i]=static_cast<unsigned char>(row[i]-(((i >= bpp ? row[i-bpp] : 0)+prev[i])>>1));
+      }
+      break;
+
+    case 4:
+      for (long i=0; i<n; i++)
+      {
+        if (i >= bpp)
+        {
+          out[i]=static_cast<unsigned char>(row[i]-paethPredictor(row[i-bpp], prev[i],
+                                            prev[i-bpp]));
+        }
+        else
+        {
+          out[i]=static_cast<unsigned char>(row[i]-prev[i]);
+        }
+      }
+      break;
+  }
+}
+
+/*
+ * Filters the row like filterPNGRow(). For filter type 5, all filters are
+ * tried and the one with the minimum sum of absolute values of the filtered
+ * bytes as signed numbers is chosen, like libpng does. tmp must have space
+ * for n+1 bytes.
+ */
+
+void filterPNGRowAdaptive(unsigned char *out, unsigned char *tmp, const unsigned char *row,
+                          const unsigned char *prev, long n, int bpp, int type)
+{
+  if (type < 5)
+  {
+    filterPNGRow(out, row, prev, n, bpp, type);
+    return;
+  }
+
+  long best=-1;
+
+  for (int t=0; t<5; t++)
+  {
+    filterPNGRow(tmp, row, prev, n, bpp, t);
+
+    long sum=0;
+
+    for (long i=1; i<=n && (best < 0 || sum < best); i++)
+    {
+      sum+=std::abs(static_cast<int>(static_cast<signed char>(tmp[i])));
+    }
+
+    if (best < 0 || sum < best)
+    {
+      best=sum;
+      memcpy(out, tmp, n+1);
+    }
+  }
+}
+
+/*
+ * Filters and compresses bands of rows independently, starting with row
+ * first. Each band is compressed into a raw deflate stream, which ends with
+ * a full flush, except for the last band of the image, which finishes the
+ * stream if last is true. The streams of all bands can be concatenated. The
+ * last 32 KB of filtered data of the previous band is used as dictionary,
+ * for keeping the compression ratio close to compressing everything at
+ * once. Rows before first are only used for the dictionary.
+ */
+
+template<class T> class PNGBandFct : public gutil::ParallelFunction
+{
+  private:
+
+    const Image<T> &image;
+    long first, rows, n;
+    bool last;
+    int  bpp, level, filter;
+
+    std::vector<std::vector<unsigned char> > &band;
+    std::vector<unsigned long> &adler;
+    std::vector<long> &length;
+
+    gutil::Semaphore mutex;
+    std::string error;
+
+    PNGBandFct(const PNGBandFct<T> &);
+    PNGBandFct<T> &operator=(const PNGBandFct<T> &);
+
+    /*
+     * Filters rows from k1 to k2 (excluding) into out. raw and prev must
+     * have space for n bytes and tmp for n+1 bytes.
+     */
+
+    void filterRows(unsigned char *out, long k1, long k2, unsigned char *raw,
+                    unsigned char *prev, unsigned char *tmp)
+    {
+      if (k1 > 0)
+      {
+        getPNGRow(prev, image, k1-1);
+      }
+      else
+      {
+        memset(prev, 0, n);
+      }
+
+      for (long k=k1; k<k2; k++)
+      {
+        getPNGRow(raw, image, k);
+        filterPNGRowAdaptive(out, tmp, raw, prev, n, bpp, filter);
+        out+=n+1;
+
+        std::swap(raw, prev);
+      }
+    }
+
+  public:
+
+    PNGBandFct(const Image<T> &_image, long _first, long _rows, bool _last, int _level,
+               int _filter, std::vector<std::vector<unsigned char> > &_band,
+               std::vector<unsigned long> &_adler, std::vector<long> &_length) :
+      image(_image), first(_first), rows(_rows), last(_last), level(_level),
+      filter(_filter), band(_band), adler(_adler), length(_length), mutex(1)
+    {
+      bpp=image.getDepth()*static_cast<int>(sizeof(T));
+      n=image.getWidth()*bpp;
+    }
+
+    void run(long start, long end, long step)
+    {
+      std::vector<unsigned char> raw(n), prev(n), tmp(n+1);
+      std::vector<unsigned char> data, dict;
+
+      for (long b=start; b<=end; b+=step)
+      {
+        long k1=first+b*rows;
+        long k2=std::min(image.getHeight(), k1+rows);
+
+        // filter rows of the band
+
+        data.resize((k2-k1)*(n+1));
+        filterRows(data.data(), k1, k2, raw.data(), prev.data(), tmp.data());
+
+        adler[b]=adler32(adler32(0, 0, 0), data.data(), static_cast<uInt>(data.size()));
+        length[b]=static_cast<long>(data.size());
+
+        // filter last rows of previous band again for the dictionary
+
+        long dn=std::min(k1, (32768+n)/(n+1));
+
+        dict.resize(dn*(n+1));
+
+        if (dn > 0)
+        {
+          filterRows(dict.data(), k1-dn, k1, raw.data(), prev.data(), tmp.data());
+        }
+
+        // compress
+
+        z_stream strm;
+        memset(&strm, 0, sizeof(strm));
+
+        if (deflateInit2(&strm, level, Z_DEFLATED, -15, 8,
+                         filter != 0 ? Z_FILTERED : Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+          gutil::Lock lock(mutex);
+          error="Cannot initialize compression";
+          continue;
+        }
+
+        if (dict.size() > 0)
+        {
+          size_t ds=std::min(dict.size(), static_cast<size_t>(32768));
+
+          deflateSetDictionary(&strm, dict.data()+dict.size()-ds, static_cast<uInt>(ds));
+        }
+
+        std::vector<unsigned char> &out=band[b];
+
+        out.resize(deflateBound(&strm, static_cast<uLong>(data.size()))+16);
+
+        strm.next_in=data.data();
+        strm.avail_in=static_cast<uInt>(data.size());
+        strm.next_out=out.data();
+        strm.avail_out=static_cast<uInt>(out.size());
+
+        int flush=(last && k2 >= image.getHeight() ? Z_FINISH : Z_FULL_FLUSH);
+        int ret=deflate(&strm, flush);
+
+        while ((flush == Z_FINISH && ret == Z_OK) || (flush != Z_FINISH && strm.avail_out == 0))
+        {
+          size_t used=out.size()-strm.avail_out;
+
+          out.resize(2*out.size());
+          strm.next_out=out.data()+used;
+          strm.avail_out=static_cast<uInt>(out.size()-used);
+
+          ret=deflate(&strm, flush);
+        }
+
+        if ((flush == Z_FINISH && ret != Z_STREAM_END) || (flush != Z_FINISH && ret != Z_OK))
+        {
+          gutil::Lock lock(mutex);
+          error="Cannot compress image data";
+        }
+
+        out.resize(out.size()-strm.avail_out);
+
+        deflateEnd(&strm);
+      }
+    }
+
+    const std::string &getError() const
+    {
+      return error;
+    }
+};
+
+/*
+ * Filters and compresses the rows of the image from row first on in
+ * parallel bands and appends the raw deflate data to ret. The checksum of
+ * the filtered data is combined into adler. The stream is finished if last
+ * is true.
+ */
+
+template<class T> void deflatePNG(std::vector<unsigned char> &ret, unsigned long &adler,
+                                  const Image<T> &image, long first, bool last, int level,
+                                  int filter)
+{
+  // bands of about 256 KB of raw data, but at least one band per thread
+
+  long n=image.getWidth()*image.getDepth()*static_cast<long>(sizeof(T))+1;
+  long rows=std::max(1l, (262144+n-1)/n);
+
+  rows=std::min(rows, std::max(1l, (image.getHeight()-first+gutil::Thread::getMaxThreads()-1)/
+                     gutil::Thread::getMaxThreads()));
+
+  long nb=std::max(1l, (image.getHeight()-first+rows-1)/rows);
+
+  std::vector<std::vector<unsigned char> > band(nb);
+  std::vector<unsigned long> badler(nb);
+  std::vector<long> length(nb);
+
+  PNGBandFct<T> fct(image, first, rows, last, level, filter, band, badler, length);
+  gutil::runParallel(fct, 0, nb-1, 1);
+
+  if (fct.getError().size() > 0)
+  {
+    throw gutil::IOException(fct.getError());
+  }
+
+  // concatenate bands and combine their checksums
+
+  size_t size=ret.size();
+
+  for (long b=0; b<nb; b++)
+  {
+    size+=band[b].size();
+  }
+
+  ret.reserve(size+4);
+
+  for (long b=0; b<nb; b++)
+  {
+    ret.insert(ret.end(), band[b].begin(), band[b].end());
+    adler=adler32_combine(adler, badler[b], length[b]);
+  }
+}
+
+/*
+ * Appends the zlib header, which states the compression level.
+ */
+
+void appendZlibHeader(std::vector<unsigned char> &ret, int level)
+{
+  int flevel=2;
+
+  if (level >= 0 && level <= 1)
+  {
+    flevel=0;
+  }
+  else if (level >= 2 && level <= 5)
+  {
+    flevel=1;
+  }
+  else if (level >= 7)
+  {
+    flevel=3;
+  }
+
+  int cmf=0x78;
+  int flg=flevel<<6;
+
+  flg+=31-(cmf*256+flg)%31;
+
+  ret.push_back(static_cast<unsigned char>(cmf));
+  ret.push_back(static_cast<unsigned char>(flg));
+}
+
+/*
+ * Appends the zlib trailer, i.e. the checksum of the uncompressed data.
+ */
+
+void appendZlibTrailer(std::vector<unsigned char> &ret, unsigned long adler)
+{
+  ret.push_back(static_cast<unsigned char>((adler>>24)&0xff));
+  ret.push_back(static_cast<unsigned char>((adler>>16)&0xff));
+  ret.push_back(static_cast<unsigned char>((adler>>8)&0xff));
+  ret.push_back(static_cast<unsigned char>(adler&0xff));
+}
+
+/*
+ * Compresses the image into a zlib stream for IDAT chunks, in parallel
+ * bands of rows.
+ */
+
+template<class T> void compressPNG(std::vector<unsigned char> &ret, const Image<T> &image,
+                                   int level, int filter)
+{
+  unsigned long adler=adler32(0, 0, 0);
+
+  ret.clear();
+
+  appendZlibHeader(ret, level);
+  deflatePNG(ret, adler, image, 0, true, level, filter);
+  appendZlibTrailer(ret, adler);
+}
+
+/*
+ * Writes a PNG file with IDAT chunks that are compressed before. Errors of
+ * libpng are reported by longjmp. Therefore, all methods that call libpng
+ * set their own jump target.
+ */
+
+class PNGFileWriter
+{
+  private:
+
+    std::string name;
+    FILE        *out;
+    png_structp png;
+    png_infop   info;
+
+    PNGFileWriter(const PNGFileWriter &);
+    PNGFileWriter &operator=(const PNGFileWriter &);
+
+    void release()
+    {
+      if (png != 0)
+      {
+        png_destroy_write_struct(&png, &info);
+      }
+
+      if (out != 0)
+      {
+        fclose(out);
+      }
+
+      png=0;
+      info=0;
+      out=0;
+    }
+
+  public:
+
+    PNGFileWriter(const char *_name) : name(_name)
+    {
+      out=0;
+      png=0;
+      info=0;
+    }
+
+    ~PNGFileWriter()
+    {
+      release();
+    }
+
+    /**
+     * Creates the file and writes the header.
+     */
+
+    void open(long width, long height, int depth, int bits)
+    {
+      // initialize writing a png file
+
+      out=fopen(name.c_str(), "wb");
+
+      if (out == 0)
+      {
+        throw gutil::IOException("Cannot open file ("+name+")");
+      }
+
+      png=png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+
+      if (png == 0)
+      {
+        release();
+        throw gutil::IOException("Cannot allocate hangle for writing PNG files");
+      }
+
+      info=png_create_info_struct(png);
+
+      if (info == 0)
+      {
+        release();
+        throw gutil::IOException("Cannot allocate PNG info structure");
+      }
+
+      if (setjmp(png_jmpbuf(png)))
+      {
+        release();
+        throw gutil::IOException("Cannot write PNG file ("+name+")");
+      }
+
+      // write header
+
+      png_init_io(png, out);
+
+      int color=PNG_COLOR_TYPE_GRAY;
+
+      if (depth == 3)
+      {
+        color=PNG_COLOR_TYPE_RGB;
+      }
+
+      png_set_IHDR(png, info, width, height, bits, color,
+                   PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                   PNG_FILTER_TYPE_DEFAULT);
+
+      std::string vs=std::string("cvkit version ")+std::string(VERSION);
+
+      time_t tt=time(0);
+      std::string tm=ctime(&tt);
+
+      png_text text[2];
+      memset(text, 0, 2*sizeof(png_text));
+
+      text[0].compression=PNG_TEXT_COMPRESSION_NONE;
+      text[0].key=const_cast<char *>("Software");
+      text[0].text=const_cast<char *>(vs.c_str());
+      text[0].text_length=strlen(text[0].text);
+
+      text[1].compression=PNG_TEXT_COMPRESSION_NONE;
+      text[1].key=const_cast<char *>("Creation Time");
+      text[1].text=const_cast<char *>(tm.c_str());
+      text[1].text_length=strlen(text[1].text);
+
+      png_set_text(png, info, text, 2);
+
+      png_write_info(png, info);
+    }
+
+    /**
+     * Writes compressed image data in chunks of at most 1 MB.
+     */
+
+    void writeIDAT(const std::vector<unsigned char> &idat)
+    {
+      if (png == 0)
+      {
+        throw gutil::IOException("Cannot write PNG file ("+name+")");
+      }
+
+      const unsigned char *data=idat.data();
+      const size_t size=idat.size();
+
+      if (setjmp(png_jmpbuf(png)))
+      {
+        release();
+        throw gutil::IOException("Cannot write PNG file ("+name+")");
+      }
+
+      for (size_t i=0; i<size; i+=1048576)
+      {
+        png_write_chunk(png, reinterpret_cast<png_const_bytep>("IDAT"), data+i,
+                        std::min(size-i, static_cast<size_t>(1048576)));
+      }
+    }
+
+    /**
+     * Finishes and closes the file.
+     */
+
+    void close()
+    {
+      if (png == 0)
+      {
+        throw gutil::IOException("Cannot write PNG file ("+name+")");
+      }
+
+      if (setjmp(png_jmpbuf(png)))
+      {
+        release();
+        throw gutil::IOException("Cannot write PNG file ("+name+")");
+      }
+
+      png_write_chunk(png, reinterpret_cast<png_const_bytep>("IEND"), 0, 0);
+
+      png_destroy_write_struct(&png, &info);
+      png=0;
+      info=0;
+
+      int ret=fclose(out);
+      out=0;
+
+      if (ret != 0)
+      {
+        throw gutil::IOException("Cannot write PNG file ("+name+")");
+      }
+    }
+};
+
+/*
+ * Writes the image as PNG with the given number of bits per sample. The
+ * image data is compressed in parallel before and then written as IDAT
+ * chunks.
+ */
+
+template<class T> void writePNG(const Image<T> &image, const char *name, int bits, int level,
+                                int filter)
+{
+  // compress image data, which does not involve libpng
+
+  std::vector<unsigned char> idat;
+
+  compressPNG(idat, image, level, filter);
+
+  // write file
+
+  PNGFileWriter out(name);
+
+  out.open(image.getWidth(), image.getHeight(), image.getDepth(), bits);
+  out.writeIDAT(idat);
+  out.close();
+}
+
+/*
+ * Copies n rows, starting with row ks of src, into dst, starting with row
+ * kd.
+ */
+
+template<class T> void copyPNGRows(Image<T> &dst, long kd, const Image<T> &src, long ks, long n)
+{
+  for (int d=0; d<src.getDepth(); d++)
+  {
+    for (long j=0; j<n; j++)
+    {
+      const T *p=src.getPtr(0, ks+j, d);
+      std::copy(p, p+src.getWidth(), dst.getPtr(0, kd+j, d));
+    }
+  }
+}
+
+/*
+ * Reads bands of rows from a PNG image. The file is kept open and only the
+ * current row is decoded, except for interlaced images, which are read
+ * completely.
+ */
+
+class PNGImageReader : public ImageReader
+{
+  private:
+
+    std::string  name;
+    FILE         *in;
+    png_structp  png;
+    png_infop    info;
+    png_infop    end;
+    PNGRowReader reader;
+    int          bits;
+
+    void release()
+    {
+      reader.close();
+
+      if (png != 0)
+      {
+        png_destroy_read_struct(&png, &info, &end);
+      }
+
+      if (in != 0)
+      {
+        fclose(in);
+      }
+
+      png=0;
+      info=0;
+      end=0;
+      in=0;
+    }
+
+    template<class T> void readPNGRows(Image<T> &band, long k)
+    {
+      if (png == 0)
+      {
+        throw gutil::IOException("Cannot read PNG file ("+name+")");
+      }
+
+      if (setjmp(png_jmpbuf(png)))
+      {
+        release();
+        throw gutil::IOException("Cannot read PNG file ("+name+")");
+      }
+
+      const int depth=getDepth();
+
+      for (long j=0; j<band.getHeight(); j++)
+      {
+        const unsigned char *row=reader.getRow(k+j);
+
+        for (int d=0; d<depth; d++)
+        {
+          T *p=band.getPtr(0, j, d);
+
+          if (bits <= 8)
+          {
+            for (long i=0; i<getWidth(); i++)
+            {
+              p[i]=static_cast<T>(row[i*depth+d]);
+            }
+          }
+          else
+          {
+            for (long i=0; i<getWidth(); i++)
+            {
+              const unsigned char *q=row+2*(i*depth+d);
+              p[i]=static_cast<T>((q[0]<<8)|q[1]);
+            }
+          }
+        }
+      }
+    }
+
+  public:
+
+    PNGImageReader(const char *_name, long width, long height, int depth) :
+      ImageReader(width, height, depth), name(_name)
+    {
+      png=0;
+      info=0;
+      end=0;
+      bits=8;
+
+      // initialize reading a png file
+
+      in=fopen(name.c_str(), "rb");
+
+      if (in == 0)
+      {
+        throw gutil::IOException("Cannot open file ("+name+")");
+      }
+
+      png=png_create_read_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+
+      if (png == 0)
+      {
+        release();
+        throw gutil::IOException("Cannot allocate hangle for reading PNG files");
+      }
+
+      info=png_create_info_struct(png);
+      end=png_create_info_struct(png);
+
+      if (info == 0 || end == 0)
+      {
+        release();
+        throw gutil::IOException("Cannot allocate PNG info structure");
+      }
+
+      if (setjmp(png_jmpbuf(png)))
+      {
+        release();
+        throw gutil::IOException("Cannot read PNG file ("+name+")");
+      }
+
+      // read header data and set the same transformations as for loading
+
+      png_init_io(png, in);
+      png_read_info(png, info);
+
+      int color=png_get_color_type(png, info);
+
+      if (color == PNG_COLOR_TYPE_PALETTE)
+      {
+        png_set_palette_to_rgb(png);
+      }
+
+      bits=png_get_bit_depth(png, info);
+
+      if (color == PNG_COLOR_TYPE_GRAY && bits < 8)
+      {
+        png_set_expand_gray_1_2_4_to_8(png);
+      }
+
+      if ((color & PNG_COLOR_MASK_ALPHA) != 0)
+      {
+        png_set_strip_alpha(png);
+      }
+
+      png_set_interlace_handling(png);
+      png_read_update_info(png, info);
+
+      reader.init(png, info, height);
+    }
+
+    ~PNGImageReader()
+    {
+      release();
+    }
+
+  protected:
+
+    void readRows(ImageU8 &band, long k)
+    {
+      if (bits > 8)
+      {
+        throw gutil::IOException("PNG with <= 8 bits expected ("+name+")");
+      }
+
+      readPNGRows(band, k);
+    }
+
+    void readRows(ImageU16 &band, long k)
+    {
+      readPNGRows(band, k);
+    }
+};
+
+/*
+ * Writes bands of rows into a PNG image. Each band is filtered and
+ * compressed in parallel like a whole image. The last rows of the previous
+ * band are kept for filtering and as dictionary, so that the result is
+ * one continuous zlib stream.
+ */
+
+class PNGImageWriter : public ImageWriter
+{
+  private:
+
+    PNGFileWriter file;
+    int           level, filter;
+    unsigned long adler;
+
+    ImageU8  contextu8;
+    ImageU16 contextu16;
+
+    template<class T> void writePNGRows(const Image<T> &band, Image<T> &context, long k,
+                                        int bits)
+    {
+      std::vector<unsigned char> data;
+
+      if (k == 0)
+      {
+        file.open(getWidth(), getHeight(), getDepth(), bits);
+
+        appendZlibHeader(data, level);
+        adler=adler32(0, 0, 0);
+        context.setSize(getWidth(), 0, getDepth());
+      }
+
+      // compress the band after the rows of the previous band
+
+      Image<T> image(getWidth(), context.getHeight()+band.getHeight(), getDepth());
+
+      copyPNGRows(image, 0, context, 0, context.getHeight());
+      copyPNGRows(image, context.getHeight(), band, 0, band.getHeight());
+
+      bool last=(k+band.getHeight() >= getHeight());
+
+      deflatePNG(data, adler, image, context.getHeight(), last, level, filter);
+
+      if (last)
+      {
+        appendZlibTrailer(data, adler);
+      }
+
+      file.writeIDAT(data);
+
+      // keep as many rows as needed for the dictionary and filtering of the
+      // next band
+
+      long n=getWidth()*getDepth()*static_cast<long>(sizeof(T));
+      long c=std::min(image.getHeight(), (32768+n)/(n+1)+1);
+
+      context.setSize(getWidth(), c, getDepth());
+      copyPNGRows(context, 0, image, image.getHeight()-c, c);
+    }
+
+  public:
+
+    PNGImageWriter(const char *name, long width, long height, int depth, int _level,
+                   int _filter) :
+      ImageWriter(width, height, depth), file(name), level(_level), filter(_filter)
+    {
+      adler=0;
+    }
+
+  protected:
+
+    void writeRows(const ImageU8 &band, long k)
+    {
+      writePNGRows(band, contextu8, k, 8);
+    }
+
+    void writeRows(const ImageU16 &band, long k)
+    {
+      writePNGRows(band, contextu16, k, 16);
+    }
+
+    void finish()
+    {
+      file.close();
+    }
+};
+
+}
+
+PNGImageIO::PNGImageIO(int _level, Filter _filter)
+{
+  setCompressionLevel(_level);
+  setFilter(_filter);
+}
+
 BasicImageIO *PNGImageIO::create() const
 {
-  return new PNGImageIO();
+  return new PNGImageIO(level, filter);
+}
+
+void PNGImageIO::setCompressionLevel(int _level)
+{
+  level=std::max(-1, std::min(9, _level));
+}
+
+void PNGImageIO::setFilter(Filter _filter)
+{
+  filter=_filter;
 }
 
 bool PNGImageIO::handlesFile(const char *name, bool reading) const
@@ -188,13 +1201,15 @@ void PNGImageIO::load(ImageU8 &image, const char *name, int ds, long x, long y,
     throw gutil::IOException("Cannot allocate PNG info structure");
   }
 
-  unsigned char *img=0;
-  unsigned char **row=0;
+  PNGRowReader reader;
+  ImageU8::work_t *volatile vline=0;
+  int *volatile nline=0;
 
   if (setjmp(png_jmpbuf(png)))
   {
-    delete [] img;
-    delete [] row;
+    reader.close();
+    delete [] vline;
+    delete [] nline;
 
     png_destroy_read_struct(&png, &info, &end);
     fclose(in);
@@ -263,41 +1278,32 @@ void PNGImageIO::load(ImageU8 &image, const char *name, int ds, long x, long y,
     png_set_strip_alpha(png);
   }
 
-  png_read_update_info(png, info);
-
-  // read image completely
+  // interlaced images are read completely and combined by libpng
 
-  int rn=png_get_rowbytes(png, info);
-  img=new unsigned char [height*rn];
-  row=new unsigned char * [height];
+  png_set_interlace_handling(png);
+  png_read_update_info(png, info);
 
-  for (int k=0; k<height; k++)
-  {
-    row[k]=img+k*rn;
-  }
+  // decode rows only as far as they are needed
 
-  png_read_image(png, static_cast<png_bytepp>(row));
+  reader.init(png, info, height);
 
   // load downscaled part?
 
   if (ds > 1 || x != 0 || y != 0 || w != width || h != height)
   {
-    std::valarray<ImageU8::work_t> vline(0, w*depth);
-    std::valarray<int> nline(0, w*depth);
-
-    // skip the first y*ds image rows
-
-    int rk=std::max(0l, y*ds);
+    vline=new ImageU8::work_t [w*depth];
+    nline=new int [w*depth];
 
     for (long k=std::max(0l, -y); k<h && (y+k)*ds<height; k++)
     {
       // load downscaled line
 
-      vline=0;
-      nline=0;
+      std::fill(vline, vline+w*depth, 0);
+      std::fill(nline, nline+w*depth, 0);
 
       for (long kk=0; kk<ds && kk+(y+k)*ds<height; kk++)
       {
+        const unsigned char *row=reader.getRow((y+k)*ds+kk);
         int  jj=std::max(0l, x)*ds*depth;
         long j=std::max(0l, -x)*depth;
 
@@ -307,7 +1313,7 @@ void PNGImageIO::load(ImageU8 &image, const char *name, int ds, long x, long y,
           {
             for (int d=0; d<depth; d++)
             {
-              ImageU8::store_t v=static_cast<ImageU8::store_t>(row[rk][jj++]);
+              ImageU8::store_t v=static_cast<ImageU8::store_t>(row[jj++]);
 
               if (image.isValidS(v))
               {
@@ -319,8 +1325,6 @@ void PNGImageIO::load(ImageU8 &image, const char *name, int ds, long x, long y,
 
           j+=depth;
         }
-
-        rk++;
       }
 
       // store line into image
@@ -345,13 +1349,14 @@ void PNGImageIO::load(ImageU8 &image, const char *name, int ds, long x, long y,
   {
     for (long k=0; k<height; k++)
     {
+      const unsigned char *row=reader.getRow(k);
       int j=0;
 
       for (long i=0; i<width; i++)
       {
         for (int d=0; d<depth; d++)
         {
-          image.set(i, k, d, static_cast<ImageU8::store_t>(row[k][j++]));
+          image.set(i, k, d, static_cast<ImageU8::store_t>(row[j++]));
         }
       }
     }
@@ -359,8 +1364,9 @@ void PNGImageIO::load(ImageU8 &image, const char *name, int ds, long x, long y,
 
   // close data set
 
-  delete [] row;
-  delete [] img;
+  reader.close();
+  delete [] vline;
+  delete [] nline;
 
   png_destroy_read_struct(&png, &info, &end);
   fclose(in);
@@ -409,13 +1415,15 @@ void PNGImageIO::load(ImageU16 &image, const char *name, int ds, long x, long y,
     throw gutil::IOException("Cannot allocate PNG info structure");
   }
 
-  unsigned char *img=0;
-  unsigned char **row=0;
+  PNGRowReader reader;
+  ImageU16::work_t *volatile vline=0;
+  int *volatile nline=0;
 
   if (setjmp(png_jmpbuf(png)))
   {
-    delete [] img;
-    delete [] row;
+    reader.close();
+    delete [] vline;
+    delete [] nline;
 
     png_destroy_read_struct(&png, &info, &end);
     fclose(in);
@@ -475,39 +1483,32 @@ void PNGImageIO::load(ImageU16 &image, const char *name, int ds, long x, long y,
     png_set_strip_alpha(png);
   }
 
-  // read image completely
+  // interlaced images are read completely and combined by libpng
 
-  int rn=png_get_rowbytes(png, info);
-  img=new unsigned char [height*rn];
-  row=new unsigned char * [height];
+  png_set_interlace_handling(png);
+  png_read_update_info(png, info);
 
-  for (int k=0; k<height; k++)
-  {
-    row[k]=img+k*rn;
-  }
+  // decode rows only as far as they are needed
 
-  png_read_image(png, static_cast<png_bytepp>(row));
+  reader.init(png, info, height);
 
   // load downscaled part?
 
   if (ds > 1 || x != 0 || y != 0 || w != width || h != height)
   {
-    std::valarray<ImageU16::work_t> vline(0, w*depth);
-    std::valarray<int> nline(0, w*depth);
-
-    // skip the first y*ds image rows
-
-    int rk=std::max(0l, y*ds);
+    vline=new ImageU16::work_t [w*depth];
+    nline=new int [w*depth];
 
     for (long k=std::max(0l, -y); k<h && (y+k)*ds<height; k++)
     {
       // load downscaled line
 
-      vline=0;
-      nline=0;
+      std::fill(vline, vline+w*depth, 0);
+      std::fill(nline, nline+w*depth, 0);
 
       for (long kk=0; kk<ds && kk+(y+k)*ds<height; kk++)
       {
+        const unsigned char *row=reader.getRow((y+k)*ds+kk);
         int  jj=std::max(0l, x)*ds*depth;
         long j=std::max(0l, -x)*depth;
 
@@ -521,12 +1522,12 @@ void PNGImageIO::load(ImageU16 &image, const char *name, int ds, long x, long y,
 
               if (bits < 16)
               {
-                v=static_cast<ImageU16::store_t>(row[rk][jj]);
+                v=static_cast<ImageU16::store_t>(row[jj]);
                 jj++;
               }
               else
               {
-                v=static_cast<ImageU16::store_t>(row[rk][jj]<<8) | row[rk][jj+1];
+                v=static_cast<ImageU16::store_t>(row[jj]<<8) | row[jj+1];
                 jj+=2;
               }
 
@@ -540,8 +1541,6 @@ void PNGImageIO::load(ImageU16 &image, const char *name, int ds, long x, long y,
 
           j+=depth;
         }
-
-        rk++;
       }
 
       // store line into image
@@ -566,6 +1565,7 @@ void PNGImageIO::load(ImageU16 &image, const char *name, int ds, long x, long y,
   {
     for (long k=0; k<height; k++)
     {
+      const unsigned char *row=reader.getRow(k);
       int j=0;
 
       for (long i=0; i<width; i++)
@@ -576,12 +1576,12 @@ void PNGImageIO::load(ImageU16 &image, const char *name, int ds, long x, long y,
 
           if (bits < 16)
           {
-            v=static_cast<ImageU16::store_t>(row[k][j]);
+            v=static_cast<ImageU16::store_t>(row[j]);
             j++;
           }
           else
           {
-            v=static_cast<ImageU16::store_t>(row[k][j]<<8) | row[k][j+1];
+            v=static_cast<ImageU16::store_t>(row[j]<<8) | row[j+1];
             j+=2;
           }
 
@@ -593,8 +1593,9 @@ void PNGImageIO::load(ImageU16 &image, const char *name, int ds, long x, long y,
 
   // close data set
 
-  delete [] row;
-  delete [] img;
+  reader.close();
+  delete [] vline;
+  delete [] nline;
 
   png_destroy_read_struct(&png, &info, &end);
   fclose(in);
@@ -607,110 +1608,7 @@ void PNGImageIO::save(const ImageU8 &image, const char *name) const
     throw gutil::IOException("Can only save PNG images with depth 1 or 3 ("+std::string(name)+")");
   }
 
-  // initialize writing a png file
-
-  FILE *out=fopen(name, "wb");
-
-  if (out == 0)
-  {
-    throw gutil::IOException("Cannot open file ("+std::string(name)+")");
-  }
-
-  png_structp png=png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
-
-  if (png == 0)
-  {
-    fclose(out);
-    throw gutil::IOException("Cannot allocate hangle for writing PNG files");
-  }
-
-  png_infop info=png_create_info_struct(png);
-
-  if (info == 0)
-  {
-    png_destroy_write_struct(&png, static_cast<png_infopp>(0));
-    fclose(out);
-    throw gutil::IOException("Cannot allocate PNG info structure");
-  }
-
-  unsigned char *row=0;
-
-  if (setjmp(png_jmpbuf(png)))
-  {
-    delete [] row;
-
-    png_destroy_write_struct(&png, &info);
-    fclose(out);
-    throw gutil::IOException("Cannot read PNG file ("+std::string(name)+")");
-  }
-
-  // write header
-
-  png_init_io(png, out);
-
-  int color=PNG_COLOR_TYPE_GRAY;
-
-  if (image.getDepth() == 3)
-  {
-    color=PNG_COLOR_TYPE_RGB;
-  }
-
-  png_set_IHDR(png, info, image.getWidth(), image.getHeight(), 8, color,
-               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
-               PNG_FILTER_TYPE_DEFAULT);
-
-  std::string vs=std::string("cvkit version ")+std::string(VERSION);
-
-  time_t tt=time(0);
-  std::string tm=ctime(&tt);
-
-  png_text text[2];
-  memset(text, 0, 2*sizeof(png_text));
-
-  text[0].compression=PNG_TEXT_COMPRESSION_NONE;
-  text[0].key=const_cast<char *>("Software");
-  text[0].text=const_cast<char *>(vs.c_str());
-  text[0].text_length=strlen(text[0].text);
-
-  text[1].compression=PNG_TEXT_COMPRESSION_NONE;
-  text[1].key=const_cast<char *>("Creation Time");
-  text[1].text=const_cast<char *>(tm.c_str());
-  text[1].text_length=strlen(text[1].text);
-
-  png_set_text(png, info, text, 2);
-
-  png_write_info(png, info);
-
-  // write image
-
-  row=new unsigned char [image.getDepth()*image.getWidth()];
-
-  // write image content line by line
-
-  for (long k=0; k<image.getHeight(); k++)
-  {
-    unsigned char *rp=row;
-
-    for (long i=0; i<image.getWidth(); i++)
-    {
-      for (int j=0; j<image.getDepth(); j++)
-      {
-        *rp++=image.get(i, k, j);
-      }
-    }
-
-    png_write_row(png, row);
-  }
-
-  // finish writing and close file
-
-  png_write_end(png, info);
-
-  delete [] row;
-
-  fclose(out);
-
-  png_destroy_write_struct(&png, &info);
+  writePNG(image, name, 8, level, filter);
 }
 
 void PNGImageIO::save(const ImageU16 &image, const char *name) const
@@ -720,111 +1618,28 @@ void PNGImageIO::save(const ImageU16 &image, const char *name) const
     throw gutil::IOException("Can only save PNG images with depth 1 or 3 ("+std::string(name)+")");
   }
 
-  // initialize writing a png file
-
-  FILE *out=fopen(name, "wb");
-
-  if (out == 0)
-  {
-    throw gutil::IOException("Cannot open file ("+std::string(name)+")");
-  }
-
-  png_structp png=png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
-
-  if (png == 0)
-  {
-    fclose(out);
-    throw gutil::IOException("Cannot allocate hangle for writing PNG files");
-  }
-
-  png_infop info=png_create_info_struct(png);
-
-  if (info == 0)
-  {
-    png_destroy_write_struct(&png, static_cast<png_infopp>(0));
-    fclose(out);
-    throw gutil::IOException("Cannot allocate PNG info structure");
-  }
-
-  unsigned char *row=0;
-
-  if (setjmp(png_jmpbuf(png)))
-  {
-    delete [] row;
-
-    png_destroy_write_struct(&png, &info);
-    fclose(out);
-    throw gutil::IOException("Cannot read PNG file ("+std::string(name)+")");
-  }
-
-  // write header
-
-  png_init_io(png, out);
-
-  int color=PNG_COLOR_TYPE_GRAY;
-
-  if (image.getDepth() == 3)
-  {
-    color=PNG_COLOR_TYPE_RGB;
-  }
-
-  png_set_IHDR(png, info, image.getWidth(), image.getHeight(), 16, color,
-               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
-               PNG_FILTER_TYPE_DEFAULT);
-
-  std::string vs=std::string("cvkit version ")+std::string(VERSION);
-
-  time_t tt=time(0);
-  std::string tm=ctime(&tt);
-
-  png_text text[2];
-  memset(text, 0, 2*sizeof(png_text));
-
-  text[0].compression=PNG_TEXT_COMPRESSION_NONE;
-  text[0].key=const_cast<char *>("Software");
-  text[0].text=const_cast<char *>(vs.c_str());
-  text[0].text_length=strlen(text[0].text);
-
-  text[1].compression=PNG_TEXT_COMPRESSION_NONE;
-  text[1].key=const_cast<char *>("Creation Time");
-  text[1].text=const_cast<char *>(tm.c_str());
-  text[1].text_length=strlen(text[1].text);
-
-  png_set_text(png, info, text, 2);
-
-  png_write_info(png, info);
+  writePNG(image, name, 16, level, filter);
+}
 
-  // write image
+ImageReader *PNGImageIO::openReader(const char *name) const
+{
+  long width, height;
+  int  depth;
 
-  row=new unsigned char [2*image.getDepth()*image.getWidth()];
+  loadHeader(name, width, height, depth);
 
-  // write image content line by line
+  return new PNGImageReader(name, width, height, depth);
+}
 
-  for (long k=0; k<image.getHeight(); k++)
+ImageWriter *PNGImageIO::openWriter(const char *name, long width, long height,
+                                    int depth) const
+{
+  if (!handlesFile(name, false) || (depth != 1 && depth != 3))
   {
-    unsigned char *rp=row;
-
-    for (long i=0; i<image.getWidth(); i++)
-    {
-      for (int j=0; j<image.getDepth(); j++)
-      {
-        *rp++=static_cast<unsigned char>(image.get(i, k, j)>>8);
-        *rp++=static_cast<unsigned char>(image.get(i, k, j)&0xff);
-      }
-    }
-
-    png_write_row(png, row);
+    throw gutil::IOException("Can only save PNG images with depth 1 or 3 ("+std::string(name)+")");
   }
 
-  // finish writing and close file
-
-  png_write_end(png, info);
-
-  delete [] row;
-
-  fclose(out);
-
-  png_destroy_write_struct(&png, &info);
+  return new PNGImageWriter(name, width, height, depth, level, filter);
 }
 
 }
@@ -42,15 +42,38 @@ namespace gimage
 {
 
 /**
- * <prefix>.jpg for ImageU8
+ * <prefix>.png for ImageU8 and ImageU16. The image data is filtered and
+ * compressed in parallel bands of rows while saving. This is also done for
+ * each band that is given to the writer.
  */
 
 class PNGImageIO : public BasicImageIO
 {
   public:
 
+    /**
+     * PNG filter types that are used for all rows while saving. The adaptive
+     * filter chooses the best filter for each row.
+     */
+
+    enum Filter {filter_none=0, filter_sub, filter_up, filter_average, filter_paeth,
+                 filter_adaptive};
+
+    /**
+     * Creates PNG IO with the given zlib compression level from 0 to 9 or -1
+     * for the default and the filter type for saving.
+     */
+
+    PNGImageIO(int level=-1, Filter filter=filter_adaptive);
+
     BasicImageIO *create() const;
 
+    void setCompressionLevel(int level);
+    int getCompressionLevel() const { return level; }
+
+    void setFilter(Filter filter);
+    Filter getFilter() const { return filter; }
+
     bool handlesFile(const char *name, bool reading) const;
 
     void loadHeader(const char *name, long &width, long &height, int &depth) const;
@@ -62,6 +85,14 @@ class PNGImageIO : public BasicImageIO
 
     void save(const ImageU8 &image, const char *name) const;
     void save(const ImageU16 &image, const char *name) const;
+
+    ImageReader *openReader(const char *name) const;
+    ImageWriter *openWriter(const char *name, long width, long height, int depth) const;
+
+  private:
+
+    int    level;
+    Filter filter;
 };
 
 }
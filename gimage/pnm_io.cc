@@ -46,7 +46,9 @@
 #include <sstream>
 #include <cctype>
 #include <cstdlib>
-#include <valarray>
+#include <vector>
+#include <cstring>
+#include <iomanip>
 
 namespace gimage
 {
@@ -192,6 +194,476 @@ void writePNMHeader(const char *name, const char *type, long width,
   }
 }
 
+/*
+ * Conversion of samples between the byte order of the file and the native
+ * byte order.
+ */
+
+inline void swapBytes(gutil::uint8 *, long)
+{ }
+
+inline void swapBytes(gutil::uint16 *p, long n)
+{
+  for (long i=0; i<n; i++)
+  {
+    p[i]=static_cast<gutil::uint16>((p[i]>>8)|(p[i]<<8));
+  }
+}
+
+inline void swapBytes(float *p, long n)
+{
+  // we assume that the plattform uses IEEE 32 bit floating point format,
+  // otherwise this will not work
+
+  for (long i=0; i<n; i++)
+  {
+    gutil::uint32 v;
+
+    memcpy(&v, p+i, sizeof(v));
+    v=(v>>24)|((v>>8)&0xff00)|((v<<8)&0xff0000)|(v<<24);
+    memcpy(p+i, &v, sizeof(v));
+  }
+}
+
+/*
+ * Splits n interleaved pixels with depth channels into separate rows per
+ * channel.
+ */
+
+template<class T> void deinterleave(T *const *out, int depth, const T *in, long n)
+{
+  if (depth == 1)
+  {
+    memcpy(out[0], in, n*sizeof(T));
+  }
+  else if (depth == 3)
+  {
+    T *r=out[0];
+    T *g=out[1];
+    T *b=out[2];
+
+    for (long i=0; i<n; i++)
+    {
+      r[i]=in[3*i];
+      g[i]=in[3*i+1];
+      b[i]=in[3*i+2];
+    }
+  }
+  else
+  {
+    for (int d=0; d<depth; d++)
+    {
+      T *p=out[d];
+
+      for (long i=0; i<n; i++)
+      {
+        p[i]=in[i*depth+d];
+      }
+    }
+  }
+}
+
+/*
+ * Reads n pixels of one row in one block into the buffer and stores them as
+ * separate rows per channel in native byte order.
+ */
+
+template<class T> void readPNMRow(std::istream &in, std::vector<T> &buffer, T *const *out,
+                                  int depth, long n, bool swap)
+{
+  buffer.resize(std::max(1l, n*depth));
+
+  in.read(reinterpret_cast<char *>(&buffer[0]), static_cast<std::streamsize>(n*depth*sizeof(T)));
+
+  if (swap)
+  {
+    swapBytes(&buffer[0], n*depth);
+  }
+
+  deinterleave(out, depth, &buffer[0], n);
+}
+
+/*
+ * Loads the data of a PNM image with the given properties from the stream.
+ * The pixel data starts at pos. The sample size of the file must be the same
+ * as sizeof(T). swap must be true if the byte order of the file is different
+ * from the native byte order. flip must be true if the rows are stored from
+ * bottom to top. The image must already have the final size and must be
+ * cleared.
+ */
+
+template<class T> void loadPNMData(Image<T> &image, std::istream &in,
+                                   std::istream::pos_type pos, long width, long height,
+                                   int depth, bool swap, bool flip, int ds, long x, long y,
+                                   long w, long h)
+{
+  std::vector<T> buffer;
+  std::vector<T *> out(depth);
+
+  if (ds > 1 || x != 0 || y != 0 || w != width || h != height)
+  {
+    // load downscaled part, the part of each row that is needed is read as
+    // one block
+
+    const long c0=std::max(0l, x)*ds;
+    const long c1=std::min(width, (x+w)*ds);
+    const long nc=c1-c0;
+
+    if (nc <= 0)
+    {
+      return;
+    }
+
+    std::vector<T> row(nc*depth);
+    std::vector<typename Image<T>::work_t> vline(w*depth);
+    std::vector<int> nline(w*depth);
+
+    for (int d=0; d<depth; d++)
+    {
+      out[d]=&row[d*nc];
+    }
+
+    for (long k=std::max(0l, -y); k<h && (y+k)*ds<height; k++)
+    {
+      // load downscaled line
+
+      std::fill(vline.begin(), vline.end(), 0);
+      std::fill(nline.begin(), nline.end(), 0);
+
+      for (long kk=0; kk<ds && kk+(y+k)*ds<height; kk++)
+      {
+        long r=(y+k)*ds+kk;
+
+        if (flip)
+        {
+          r=height-1-r;
+        }
+
+        in.seekg(pos+static_cast<std::streamoff>(r*width+c0)*depth*
+                 static_cast<std::streamoff>(sizeof(T)));
+
+        readPNMRow(in, buffer, &out[0], depth, nc, swap);
+
+        for (int d=0; d<depth; d++)
+        {
+          const T *p=out[d];
+
+          for (long i=std::max(0l, -x); i<w && (x+i)*ds<width; i++)
+          {
+            const long c=(x+i)*ds-c0;
+            const long j=i*depth+d;
+
+            for (int ii=0; ii<ds && c+ii<nc; ii++)
+            {
+              if (image.isValidS(p[c+ii]))
+              {
+                vline[j]+=p[c+ii];
+                nline[j]++;
+              }
+            }
+          }
+        }
+      }
+
+      // store line into image
+
+      long j=std::max(0l, -x)*depth;
+
+      for (long i=std::max(0l, -x); i<w && (x+i)*ds<width; i++)
+      {
+        for (int d=0; d<depth; d++)
+        {
+          if (nline[j] > 0)
+          {
+            image.set(i, k, d, static_cast<typename Image<T>::store_t>(vline[j]/nline[j]));
+          }
+
+          j++;
+        }
+      }
+    }
+  }
+  else // load whole image
+  {
+    in.seekg(pos);
+
+    for (long r=0; r<height; r++)
+    {
+      const long k=flip ? height-1-r : r;
+
+      for (int d=0; d<depth; d++)
+      {
+        out[d]=image.getPtr(0, k, d);
+      }
+
+      readPNMRow(in, buffer, &out[0], depth, width, swap);
+    }
+  }
+}
+
+/*
+ * Reads bands of rows from a binary PNM image. The file is kept open.
+ */
+
+class PNMImageReader : public ImageReader
+{
+  private:
+
+    std::string            name;
+    std::ifstream          in;
+    std::istream::pos_type pos;
+    long                   maxval;
+    float                  scale;
+
+    template<class T> void readPNMRows(Image<T> &band, long k, bool swap, bool flip)
+    {
+      try
+      {
+        std::vector<T> buffer;
+        std::vector<T *> out(getDepth());
+
+        const std::streamoff n=static_cast<std::streamoff>(getWidth())*getDepth()*
+                               static_cast<std::streamoff>(sizeof(T));
+
+        if (!flip)
+        {
+          in.seekg(pos+k*n);
+        }
+
+        for (long j=0; j<band.getHeight(); j++)
+        {
+          if (flip)
+          {
+            in.seekg(pos+(getHeight()-1-k-j)*n);
+          }
+
+          for (int d=0; d<getDepth(); d++)
+          {
+            out[d]=band.getPtr(0, j, d);
+          }
+
+          readPNMRow(in, buffer, &out[0], getDepth(), getWidth(), swap);
+        }
+      }
+      catch (const std::ios_base::failure &ex)
+      {
+        throw gutil::IOException(ex.what());
+      }
+    }
+
+  public:
+
+    PNMImageReader(const char *_name, std::istream::pos_type _pos, long width, long height,
+                   int depth, long _maxval, float _scale) :
+      ImageReader(width, height, depth), name(_name), pos(_pos), maxval(_maxval), scale(_scale)
+    {
+      in.exceptions(std::ios_base::failbit | std::ios_base::badbit | std::ios_base::eofbit);
+
+      try
+      {
+        in.open(name.c_str(), std::ios::binary);
+      }
+      catch (const std::ios_base::failure &ex)
+      {
+        throw gutil::IOException(ex.what());
+      }
+    }
+
+  protected:
+
+    void readRows(ImageU8 &band, long k)
+    {
+      if (scale != 0 || maxval > 255)
+      {
+        throw gutil::IOException("Image cannot be read as 8 bit image ("+name+")");
+      }
+
+      readPNMRows(band, k, false, false);
+    }
+
+    void readRows(ImageU16 &band, long k)
+    {
+      if (scale != 0)
+      {
+        throw gutil::IOException("A float image cannot be read as 16 bit image ("+name+")");
+      }
+
+      if (maxval > 255)
+      {
+        // 16 bit samples are stored with the most significant byte first
+
+        readPNMRows(band, k, !gutil::isMSBFirst(), false);
+      }
+      else
+      {
+        ImageReader::readRows(band, k);
+      }
+    }
+
+    void readRows(ImageFloat &band, long k)
+    {
+      if (scale != 0)
+      {
+        // a positive scale means that the most significant byte is stored
+        // first, rows are stored from bottom to top
+
+        readPNMRows(band, k, (scale > 0) != gutil::isMSBFirst(), true);
+      }
+      else
+      {
+        ImageReader::readRows(band, k);
+      }
+    }
+};
+
+/*
+ * Writes bands of rows into a binary PNM image. The header is written with
+ * the first band, since it depends on the pixel type. Float images are
+ * stored from bottom to top, with the scale in the header padded to a fixed
+ * width, so that it can be updated with the maximum value at the end.
+ */
+
+class PNMImageWriter : public ImageWriter
+{
+  private:
+
+    std::string    name;
+    std::fstream   out;
+    std::streamoff pos;
+    float          vmax;
+
+    std::string getHeader(long maxval, float scale) const
+    {
+      std::ostringstream s;
+
+      if (maxval > 0)
+      {
+        s << (getDepth() == 3 ? "P6" : "P5") << "\n";
+        s << getWidth() << " " << getHeight() << "\n";
+        s << maxval << "\n";
+      }
+      else
+      {
+        s << (getDepth() == 3 ? "PF" : "Pf") << "\n";
+        s << getWidth() << " " << getHeight() << "\n";
+        s << std::setw(15) << scale << "\n";
+      }
+
+      return s.str();
+    }
+
+    template<class T> void writePNMRows(const Image<T> &band, long k, long maxval, bool swap,
+                                        bool flip)
+    {
+      try
+      {
+        if (k == 0)
+        {
+          out.open(name.c_str(), std::ios::in | std::ios::out | std::ios::trunc |
+                   std::ios::binary);
+
+          std::string header=getHeader(maxval, 1);
+          out.write(header.c_str(), static_cast<std::streamsize>(header.size()));
+          pos=static_cast<std::streamoff>(header.size());
+        }
+
+        const long n=getWidth()*getDepth();
+        std::vector<T> buffer(n);
+
+        for (long j=0; j<band.getHeight(); j++)
+        {
+          for (int d=0; d<getDepth(); d++)
+          {
+            const T *p=band.getPtr(0, j, d);
+
+            for (long i=0; i<getWidth(); i++)
+            {
+              buffer[i*getDepth()+d]=p[i];
+            }
+          }
+
+          if (swap)
+          {
+            swapBytes(&buffer[0], n);
+          }
+
+          if (flip)
+          {
+            out.seekp(pos+(getHeight()-1-k-j)*static_cast<std::streamoff>(n*sizeof(T)));
+          }
+
+          out.write(reinterpret_cast<const char *>(&buffer[0]),
+                    static_cast<std::streamsize>(n*sizeof(T)));
+        }
+      }
+      catch (const std::ios_base::failure &ex)
+      {
+        throw gutil::IOException(ex.what());
+      }
+    }
+
+  public:
+
+    PNMImageWriter(const char *_name, long width, long height, int depth) :
+      ImageWriter(width, height, depth), name(_name)
+    {
+      pos=0;
+      vmax=-std::numeric_limits<float>::max();
+
+      out.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+    }
+
+  protected:
+
+    void writeRows(const ImageU8 &band, long k)
+    {
+      writePNMRows(band, k, 255, false, false);
+    }
+
+    void writeRows(const ImageU16 &band, long k)
+    {
+      // 16 bit samples are stored with the most significant byte first
+
+      writePNMRows(band, k, 65535, !gutil::isMSBFirst(), false);
+    }
+
+    void writeRows(const ImageFloat &band, long k)
+    {
+      // samples are stored with the most significant byte first, as
+      // indicated by the positive scale
+
+      writePNMRows(band, k, 0, !gutil::isMSBFirst(), true);
+      vmax=std::max(vmax, band.maxValue());
+    }
+
+    void finish()
+    {
+      try
+      {
+        if (vmax > -std::numeric_limits<float>::max())
+        {
+          float s=1;
+
+          if (vmax > 0)
+          {
+            s=1/vmax;
+          }
+
+          std::string header=getHeader(0, s);
+
+          out.seekp(0);
+          out.write(header.c_str(), static_cast<std::streamsize>(header.size()));
+        }
+
+        out.close();
+      }
+      catch (const std::ios_base::failure &ex)
+      {
+        throw gutil::IOException(ex.what());
+      }
+    }
+};
+
 }
 
 BasicImageIO *PNMImageIO::create() const
@@ -199,7 +671,7 @@ BasicImageIO *PNMImageIO::create() const
   return new PNMImageIO();
 }
 
-bool PNMImageIO::handlesFile(const char *name, bool reading) const
+bool PNMImageIO::handlesFile(const char *name, bool /* reading */) const
 {
   std::string s=name;
 
@@ -278,83 +750,7 @@ void PNMImageIO::load(ImageU8 &image, const char *name, int ds, long x, long y,
     in.exceptions(std::ios_base::failbit | std::ios_base::badbit | std::ios_base::eofbit);
     in.open(name, std::ios::binary);
 
-    // load downscaled part?
-
-    if (ds > 1 || x != 0 || y != 0 || w != width || h != height)
-    {
-      std::valarray<ImageU8::work_t> vline(0, w*depth);
-      std::valarray<int> nline(0, w*depth);
-
-      for (long k=std::max(0l, -y); k<h && (y+k)*ds<height; k++)
-      {
-        // load downscaled line
-
-        vline=0;
-        nline=0;
-
-        for (long kk=0; kk<ds && kk+(y+k)*ds<height; kk++)
-        {
-          in.seekg(pos+static_cast<std::streamoff>((y+k)*ds+kk)*width*depth+
-                   static_cast<std::streamoff>(std::max(0l, x))*ds*depth);
-
-          std::streambuf *sb=in.rdbuf();
-
-          long j=std::max(0l, -x)*depth;
-
-          for (long i=std::max(0l, -x); i<w && (x+i)*ds<width; i++)
-          {
-            for (int ii=0; ii<ds && (x+i)*ds+ii<width; ii++)
-            {
-              for (int d=0; d<depth; d++)
-              {
-                ImageU8::store_t v=static_cast<ImageU8::store_t>(sb->sbumpc());
-
-                if (image.isValidS(v))
-                {
-                  vline[j+d]+=v;
-                  nline[j+d]++;
-                }
-              }
-            }
-
-            j+=depth;
-          }
-        }
-
-        // store line into image
-
-        long j=std::max(0l, -x)*depth;
-
-        for (long i=std::max(0l, -x); i<w && (x+i)*ds<width; i++)
-        {
-          for (int d=0; d<depth; d++)
-          {
-            if (nline[j] > 0)
-            {
-              image.set(i, k, d, static_cast<ImageU8::store_t>(vline[j]/nline[j]));
-            }
-
-            j++;
-          }
-        }
-      }
-    }
-    else // load whole image
-    {
-      in.seekg(pos);
-      std::streambuf *sb=in.rdbuf();
-
-      for (long k=0; k<height; k++)
-      {
-        for (long i=0; i<width; i++)
-        {
-          for (int d=0; d<depth; d++)
-          {
-            image.set(i, k, d, static_cast<ImageU8::store_t>(sb->sbumpc()));
-          }
-        }
-      }
-    }
+    loadPNMData(image, in, pos, width, height, depth, false, false, ds, x, y, w, h);
 
     in.close();
   }
@@ -407,91 +803,10 @@ void PNMImageIO::load(ImageU16 &image, const char *name, int ds, long x,
       in.exceptions(std::ios_base::failbit | std::ios_base::badbit | std::ios_base::eofbit);
       in.open(name, std::ios::binary);
 
-      // load downscaled part?
-
-      if (ds > 1 || x != 0 || y != 0 || w != width || h != height)
-      {
-        std::valarray<ImageU16::work_t> vline(0, w*depth);
-        std::valarray<int> nline(0, w*depth);
-
-        for (long k=std::max(0l, -y); k<h && (y+k)*ds<height; k++)
-        {
-          // load downscaled line
-
-          vline=0;
-          nline=0;
-
-          for (long kk=0; kk<ds && kk+(y+k)*ds<height; kk++)
-          {
-            in.seekg(pos+static_cast<std::streamoff>((y+k)*ds+kk)*width*depth*2+
-                     static_cast<std::streamoff>(std::max(0l, x))*ds*depth*2);
-
-            std::streambuf *sb=in.rdbuf();
-
-            long j=std::max(0l, -x)*depth;
-
-            for (long i=std::max(0l, -x); i<w && (x+i)*ds<width; i++)
-            {
-              for (int ii=0; ii<ds && (x+i)*ds+ii<width; ii++)
-              {
-                for (int d=0; d<depth; d++)
-                {
-                  ImageU16::store_t v;
-
-                  v=(static_cast<ImageU16::store_t>(sb->sbumpc())&0xff);
-                  v=(v<<8)|(static_cast<ImageU16::store_t>(sb->sbumpc())&0xff);
-
-                  if (image.isValidS(v))
-                  {
-                    vline[j+d]+=v;
-                    nline[j+d]++;
-                  }
-                }
-              }
-
-              j+=depth;
-            }
-          }
-
-          // store line into image
+      // 16 bit samples are stored with the most significant byte first
 
-          long j=std::max(0l, -x)*depth;
-
-          for (long i=std::max(0l, -x); i<w && (x+i)*ds<width; i++)
-          {
-            for (int d=0; d<depth; d++)
-            {
-              if (nline[j] > 0)
-              {
-                image.set(i, k, d, static_cast<ImageU16::store_t>(vline[j]/nline[j]));
-              }
-
-              j++;
-            }
-          }
-        }
-      }
-      else // load whole image
-      {
-        in.seekg(pos);
-        std::streambuf *sb=in.rdbuf();
-
-        for (long k=0; k<height; k++)
-        {
-          for (long i=0; i<width; i++)
-          {
-            for (int d=0; d<depth; d++)
-            {
-              ImageU16::store_t v;
-
-              v=(static_cast<ImageU16::store_t>(sb->sbumpc())&0xff);
-              v=(v<<8)|(static_cast<ImageU16::store_t>(sb->sbumpc())&0xff);
-
-              image.set(i, k, d, v);
-            }
-          }
-        }
-      }
+      loadPNMData(image, in, pos, width, height, depth, !gutil::isMSBFirst(), false, ds, x,
+                  y, w, h);
 
       in.close();
     }
@@ -515,9 +830,6 @@ void PNMImageIO::load(ImageFloat &image, const char *name, int ds, long x,
   float scale;
   int   depth;
   std::istream::pos_type pos;
-  float p;
-  char *c=reinterpret_cast<char *>(&p);
-  bool msbfirst=gutil::isMSBFirst();
 
   if (!handlesFile(name, true))
   {
@@ -549,117 +861,13 @@ void PNMImageIO::load(ImageFloat &image, const char *name, int ds, long x,
       in.exceptions(std::ios_base::failbit | std::ios_base::badbit | std::ios_base::eofbit);
       in.open(name, std::ios::binary);
 
-      // load downscaled part?
-
-      if (ds > 1 || x != 0 || y != 0 || w != width || h != height)
-      {
-        std::valarray<float> vline(0.0f, w*depth);
-        std::valarray<int> nline(0, w*depth);
-
-        for (long k=std::max(0l, -y); k<h && (y+k)*ds<height; k++)
-        {
-          // load downscaled line
-
-          vline=0;
-          nline=0;
-
-          for (long kk=0; kk<ds && kk+(y+k)*ds<height; kk++)
-          {
-            in.seekg(pos+static_cast<std::streamoff>(height-1-(y+k)*ds-kk)*width*depth*4+
-                     static_cast<std::streamoff>(std::max(0l, x))*ds*depth*4);
-
-            std::streambuf *sb=in.rdbuf();
-
-            long j=std::max(0l, -x)*depth;
-
-            for (long i=std::max(0l, -x); i<w && (x+i)*ds<width; i++)
-            {
-              for (int ii=0; ii<ds && (x+i)*ds+ii<width; ii++)
-              {
-                for (int d=0; d<depth; d++)
-                {
-                  // we assume that the plattform uses IEEE 32 bit floating
-                  // point format, otherwise this will not work
-
-                  if ((scale > 0 && msbfirst) || (scale < 0 && !msbfirst))
-                  {
-                    c[0]=sb->sbumpc();
-                    c[1]=sb->sbumpc();
-                    c[2]=sb->sbumpc();
-                    c[3]=sb->sbumpc();
-                  }
-                  else
-                  {
-                    c[3]=sb->sbumpc();
-                    c[2]=sb->sbumpc();
-                    c[1]=sb->sbumpc();
-                    c[0]=sb->sbumpc();
-                  }
-
-                  if (image.isValidS(p))
-                  {
-                    vline[j+d]+=p;
-                    nline[j+d]++;
-                  }
-                }
-              }
-
-              j+=depth;
-            }
-          }
-
-          // store line into image
+      // a positive scale means that the most significant byte is stored
+      // first, rows are stored from bottom to top
 
-          long j=std::max(0l, -x)*depth;
+      bool msbfirst=gutil::isMSBFirst();
 
-          for (long i=std::max(0l, -x); i<w && (x+i)*ds<width; i++)
-          {
-            for (int d=0; d<depth; d++)
-            {
-              if (nline[j] > 0)
-              {
-                image.set(i, k, d, vline[j]/nline[j]);
-              }
-
-              j++;
-            }
-          }
-        }
-      }
-      else // load whole image
-      {
-        in.seekg(pos);
-        std::streambuf *sb=in.rdbuf();
-
-        for (long k=height-1; k>=0; k--)
-        {
-          for (long i=0; i<width; i++)
-          {
-            for (int d=0; d<depth; d++)
-            {
-              // we assume that the plattform uses IEEE 32 bit floating
-              // point format, otherwise this will not work
-
-              if ((scale > 0 && msbfirst) || (scale < 0 && !msbfirst))
-              {
-                c[0]=sb->sbumpc();
-                c[1]=sb->sbumpc();
-                c[2]=sb->sbumpc();
-                c[3]=sb->sbumpc();
-              }
-              else
-              {
-                c[3]=sb->sbumpc();
-                c[2]=sb->sbumpc();
-                c[1]=sb->sbumpc();
-                c[0]=sb->sbumpc();
-              }
-
-              image.set(i, k, d, p);
-            }
-          }
-        }
-      }
+      loadPNMData(image, in, pos, width, height, depth, (scale > 0) != msbfirst, true, ds, x,
+                  y, w, h);
 
       in.close();
     }
@@ -767,6 +975,57 @@ void PNMImageIO::load(ImageFloat &image, const char *name, int ds, long x,
   }
 }
 
+void PNMImageIO::map(MappedImageU8 &image, const char *name, MapMode mode) const
+{
+  long  width, height, maxval;
+  float scale;
+  int   depth;
+  std::istream::pos_type pos;
+
+  if (!handlesFile(name, true))
+  {
+    throw gutil::IOException("Can only map PNM image ("+std::string(name)+")");
+  }
+
+  pos=readPNMHeader(name, depth, maxval, scale, width, height);
+
+  if (scale != 0 || depth != 1 || maxval > 255)
+  {
+    throw gutil::IOException("Only 8 bit PGM images can be mapped as 8 bit image ("+std::string(name)+")");
+  }
+
+  image.map(name, static_cast<long long>(pos), width, height, mode);
+}
+
+void PNMImageIO::map(MappedImageU16 &image, const char *name, MapMode mode) const
+{
+  long  width, height, maxval;
+  float scale;
+  int   depth;
+  std::istream::pos_type pos;
+
+  if (!handlesFile(name, true))
+  {
+    throw gutil::IOException("Can only map PNM image ("+std::string(name)+")");
+  }
+
+  pos=readPNMHeader(name, depth, maxval, scale, width, height);
+
+  if (scale != 0 || depth != 1 || maxval <= 255)
+  {
+    throw gutil::IOException("Only 16 bit PGM images can be mapped as 16 bit image ("+std::string(name)+")");
+  }
+
+  // 16 bit values are stored with the most significant byte first
+
+  if (!gutil::isMSBFirst())
+  {
+    throw gutil::IOException("16 bit PGM images can only be mapped on big endian machines ("+std::string(name)+")");
+  }
+
+  image.map(name, static_cast<long long>(pos), width, height, mode);
+}
+
 void PNMImageIO::save(const ImageU8 &image, const char *name) const
 {
   if (!handlesFile(name, false) || (image.getDepth() != 1 && image.getDepth() != 3))
@@ -935,4 +1194,42 @@ void PNMImageIO::save(const ImageFloat &image, const char *name) const
   }
 }
 
+ImageReader *PNMImageIO::openReader(const char *name) const
+{
+  long  width, height, maxval;
+  float scale;
+  int   depth;
+  std::istream::pos_type pos;
+
+  if (!handlesFile(name, true))
+  {
+    throw gutil::IOException("Can only load PNM image ("+std::string(name)+")");
+  }
+
+  pos=readPNMHeader(name, depth, maxval, scale, width, height);
+
+  // legacy disparity images are converted while loading
+
+  std::string s=name;
+
+  if (maxval > 255 && ((s.size() > 9 && s.compare(s.size()-9, 9, "_disp.pgm") == 0) ||
+                       (s.size() > 11 && s.compare(s.size()-11, 11, "_height.pgm") == 0)))
+  {
+    return BasicImageIO::openReader(name);
+  }
+
+  return new PNMImageReader(name, pos, width, height, depth, maxval, scale);
+}
+
+ImageWriter *PNMImageIO::openWriter(const char *name, long width, long height,
+                                    int depth) const
+{
+  if (!handlesFile(name, false) || (depth != 1 && depth != 3))
+  {
+    throw gutil::IOException("Can only save PNM images with depth 1 or 3 ("+std::string(name)+")");
+  }
+
+  return new PNMImageWriter(name, width, height, depth);
+}
+
 }
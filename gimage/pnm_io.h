@@ -37,6 +37,7 @@
 #define GIMAGE_PNM_IO_H
 
 #include "io.h"
+#include "mapped.h"
 
 namespace gimage
 {
@@ -64,9 +65,23 @@ class PNMImageIO : public BasicImageIO
     void load(ImageFloat &image, const char *name, int ds=1, long x=0, long y=0, long w=-1,
               long h=-1) const;
 
+    /**
+     * Maps a binary PGM image directly into memory instead of loading it.
+     * Throws gutil::IOException if this is not possible without conversion.
+     * PGM stores 16 bit values big endian, i.e. with the most significant
+     * byte first. Therefore, 16 bit images are refused on little endian
+     * machines and must be loaded instead.
+     */
+
+    void map(MappedImageU8 &image, const char *name, MapMode mode=map_read_only) const;
+    void map(MappedImageU16 &image, const char *name, MapMode mode=map_read_only) const;
+
     void save(const ImageU8 &image, const char *name) const;
     void save(const ImageU16 &image, const char *name) const;
     void save(const ImageFloat &image, const char *name) const;
+
+    ImageReader *openReader(const char *name) const;
+    ImageWriter *openWriter(const char *name, long width, long height, int depth) const;
 };
 
 }
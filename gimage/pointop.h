@@ -0,0 +1,495 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GIMAGE_POINTOP_H
+#define GIMAGE_POINTOP_H
+
+#include "image.h"
+
+#include <vector>
+#include <cstring>
+
+namespace gimage
+{
+
+/*
+ * Returns r if v is valid and v otherwise. The float version selects by bit
+ * operations so that the compiler can vectorize the loops below.
+ */
+
+template<class T> inline T selectValid(T v, T r)
+{
+  return PixelTraits<T>::isValidS(v) ? r : v;
+}
+
+template<> inline float selectValid(float v, float r)
+{
+  gutil::uint32 vb, rb;
+
+  memcpy(&vb, &v, sizeof(vb));
+  memcpy(&rb, &r, sizeof(rb));
+
+  const gutil::uint32 m=0u-static_cast<gutil::uint32>((vb & 0x7f800000) != 0x7f800000);
+
+  vb=(rb & m) | (vb & ~m);
+  memcpy(&v, &vb, sizeof(v));
+
+  return v;
+}
+
+/**
+ * Operation that changes pixels independently of other pixels. The
+ * operation may consider all channels of a pixel.
+ */
+
+template<class T> class PointOperation
+{
+  public:
+
+    typedef PixelTraits<T> ptraits;
+    typedef typename ptraits::work_t work_t;
+
+    virtual ~PointOperation() { }
+
+    /**
+     * Applies the operation to n pixels. p[j] points to the values of channel
+     * j.
+     */
+
+    virtual void run(T *const *p, int depth, long n) const=0;
+};
+
+/**
+ * Adding an offset to all valid pixels, like operator+=().
+ */
+
+template<class T> class AddOperation : public PointOperation<T>
+{
+  public:
+
+    typedef PixelTraits<T> ptraits;
+
+    AddOperation(typename ptraits::work_t _s) : s(_s) { }
+
+    void run(T *const *p, int depth, long n) const
+    {
+      for (int d=0; d<depth; d++)
+      {
+        T *pp=p[d];
+
+        for (long i=0; i<n; i++)
+        {
+          const T v=pp[i];
+          const T r=ptraits::limit(v+s);
+          pp[i]=selectValid(v, r);
+        }
+      }
+    }
+
+  private:
+
+    typename ptraits::work_t s;
+};
+
+/**
+ * Subtracting an offset from all valid pixels, like operator-=().
+ */
+
+template<class T> class SubOperation : public PointOperation<T>
+{
+  public:
+
+    typedef PixelTraits<T> ptraits;
+
+    SubOperation(typename ptraits::work_t _s) : s(_s) { }
+
+    void run(T *const *p, int depth, long n) const
+    {
+      for (int d=0; d<depth; d++)
+      {
+        T *pp=p[d];
+
+        for (long i=0; i<n; i++)
+        {
+          const T v=pp[i];
+          const T r=ptraits::limit(v-s);
+          pp[i]=selectValid(v, r);
+        }
+      }
+    }
+
+  private:
+
+    typename ptraits::work_t s;
+};
+
+/**
+ * Multiplying all valid pixels by a factor, like operator*=().
+ */
+
+template<class T> class MulOperation : public PointOperation<T>
+{
+  public:
+
+    typedef PixelTraits<T> ptraits;
+
+    MulOperation(double _s) : s(_s) { }
+
+    void run(T *const *p, int depth, long n) const
+    {
+      for (int d=0; d<depth; d++)
+      {
+        T *pp=p[d];
+
+        for (long i=0; i<n; i++)
+        {
+          const T v=pp[i];
+          const T r=ptraits::limit(static_cast<typename ptraits::work_t>(v*s));
+          pp[i]=selectValid(v, r);
+        }
+      }
+    }
+
+  private:
+
+    double s;
+};
+
+/**
+ * Dividing all valid pixels by a factor, like operator/=().
+ */
+
+template<class T> class DivOperation : public PointOperation<T>
+{
+  public:
+
+    typedef PixelTraits<T> ptraits;
+
+    DivOperation(double _s) : s(_s) { }
+
+    void run(T *const *p, int depth, long n) const
+    {
+      for (int d=0; d<depth; d++)
+      {
+        T *pp=p[d];
+
+        for (long i=0; i<n; i++)
+        {
+          const T v=pp[i];
+          const T r=ptraits::limit(static_cast<typename ptraits::work_t>(v/s));
+          pp[i]=selectValid(v, r);
+        }
+      }
+    }
+
+  private:
+
+    double s;
+};
+
+/**
+ * Computing the reciprocal of all valid pixels, like reciprocal().
+ */
+
+template<class T> class ReciprocalOperation : public PointOperation<T>
+{
+  public:
+
+    typedef PixelTraits<T> ptraits;
+
+    void run(T *const *p, int depth, long n) const
+    {
+      for (int d=0; d<depth; d++)
+      {
+        T *pp=p[d];
+
+        for (long i=0; i<n; i++)
+        {
+          const T v=pp[i];
+          const T r=ptraits::limit(1/(v));
+          pp[i]=selectValid(v, r);
+        }
+      }
+    }
+};
+
+/**
+ * Setting values outside the given range to the range limits, like
+ * clipRange().
+ */
+
+template<class T> class ClipOperation : public PointOperation<T>
+{
+  public:
+
+    ClipOperation(T _from, T _to) : from(_from), to(_to) { }
+
+    void run(T *const *p, int depth, long n) const
+    {
+      for (int d=0; d<depth; d++)
+      {
+        T *pp=p[d];
+
+        for (long i=0; i<n; i++)
+        {
+          T v=pp[i];
+          v=(v < from) ? from : v;
+          v=(pp[i] > to) ? to : v;
+          pp[i]=v;
+        }
+      }
+    }
+
+  private:
+
+    T from, to;
+};
+
+/**
+ * Invalidating all channels of pixels if one value is outside the given
+ * range, like validRange().
+ */
+
+template<class T> class ValidOperation : public PointOperation<T>
+{
+  public:
+
+    typedef PixelTraits<T> ptraits;
+
+    ValidOperation(T _from, T _to) : from(_from), to(_to) { }
+
+    void run(T *const *p, int depth, long n) const
+    {
+      const T inv=ptraits::limit(ptraits::invalid());
+
+      for (long i=0; i<n; i++)
+      {
+        for (int d=0; d<depth; d++)
+        {
+          T v=p[d][i];
+
+          if ((v < from || v > to) && ptraits::isValidS(v))
+          {
+            for (int j=0; j<depth; j++)
+            {
+              p[j][i]=inv;
+            }
+          }
+        }
+      }
+    }
+
+  private:
+
+    T from, to;
+};
+
+/**
+ * Mapping the values of pixels with all channels valid through a lookup
+ * table, like remapImage(). The map is copied.
+ */
+
+template<class T> class RemapOperation : public PointOperation<T>
+{
+  public:
+
+    typedef PixelTraits<T> ptraits;
+
+    RemapOperation(const Image<T> &_map) : map(_map) { }
+
+    void run(T *const *p, int depth, long n) const
+    {
+      for (long i=0; i<n; i++)
+      {
+        bool valid=true;
+
+        for (int d=0; d<depth; d++)
+        {
+          valid=valid && ptraits::isValidS(p[d][i]);
+        }
+
+        if (valid)
+        {
+          for (int d=0; d<depth; d++)
+          {
+            p[d][i]=map.get(static_cast<long>(p[d][i]), 0, d);
+          }
+        }
+      }
+    }
+
+  private:
+
+    Image<T> map;
+};
+
+/**
+ * Sequence of point operations that is applied in one pass over the image.
+ * All operations are applied to a block of a row that fits into the cache,
+ * before the next block is processed. The result is exactly the same as
+ * applying the corresponding functions one after another.
+ */
+
+template<class T> class PointPipeline
+{
+  public:
+
+    PointPipeline() { }
+
+    ~PointPipeline()
+    {
+      clear();
+    }
+
+    /**
+     * Appends an operation to the pipeline. The pipeline takes ownership of
+     * the operation.
+     */
+
+    void add(PointOperation<T> *o)
+    {
+      op.push_back(o);
+    }
+
+    int size() const
+    {
+      return static_cast<int>(op.size());
+    }
+
+    void clear()
+    {
+      for (size_t i=0; i<op.size(); i++)
+      {
+        delete op[i];
+      }
+
+      op.clear();
+    }
+
+    /**
+     * Applies all operations in place.
+     */
+
+    void apply(Image<T> &image) const
+    {
+      std::vector<T *> p(std::max(1, image.getDepth()));
+
+      for (long k=0; k<image.getHeight(); k++)
+      {
+        for (long i=0; i<image.getWidth(); i+=block)
+        {
+          const long n=std::min(block, image.getWidth()-i);
+
+          for (int d=0; d<image.getDepth(); d++)
+          {
+            p[d]=image.getPtr(i, k, d);
+          }
+
+          run(&p[0], image.getDepth(), n);
+        }
+      }
+    }
+
+    /**
+     * Applies all operations to the given image and stores the result in
+     * ret, which can have a different pixel type. The conversion is the same
+     * as in Image::setImageLimited().
+     */
+
+    template<class S> void apply(Image<S> &ret, const Image<T> &image) const
+    {
+      typedef PixelTraits<S> straits;
+
+      ret.setSize(image.getWidth(), image.getHeight(), image.getDepth());
+
+      std::vector<T> buffer(std::max(1, image.getDepth())*block);
+      std::vector<T *> p(std::max(1, image.getDepth()));
+
+      for (int d=0; d<image.getDepth(); d++)
+      {
+        p[d]=&buffer[d*block];
+      }
+
+      for (long k=0; k<image.getHeight(); k++)
+      {
+        for (long i=0; i<image.getWidth(); i+=block)
+        {
+          const long n=std::min(block, image.getWidth()-i);
+
+          for (int d=0; d<image.getDepth(); d++)
+          {
+            memcpy(p[d], image.getPtr(i, k, d), n*sizeof(T));
+          }
+
+          run(&p[0], image.getDepth(), n);
+
+          for (int d=0; d<image.getDepth(); d++)
+          {
+            const T *pp=p[d];
+            S *out=ret.getPtr(i, k, d);
+
+            for (long ii=0; ii<n; ii++)
+            {
+              out[ii]=straits::limit(static_cast<typename straits::work_t>(pp[ii]));
+            }
+          }
+        }
+      }
+    }
+
+  private:
+
+    static const long block=1024;
+
+    PointPipeline(const PointPipeline &);
+    PointPipeline &operator=(const PointPipeline &);
+
+    void run(T *const *p, int depth, long n) const
+    {
+      for (size_t j=0; j<op.size(); j++)
+      {
+        op[j]->run(p, depth, n);
+      }
+    }
+
+    std::vector<PointOperation<T> *> op;
+};
+
+template<class T> const long PointPipeline<T>::block;
+
+}
+
+#endif
@@ -36,6 +36,7 @@
 #include "raw_io.h"
 
 #include <gutil/properties.h>
+#include <gutil/misc.h>
 
 #include <limits>
 #include <stdexcept>
@@ -119,6 +120,197 @@ void writeRAWHeader(const char *name, int type, long width, long height)
   prop.save(s.c_str(), (std::string("Header information of RAW File: ")+std::string(name)).c_str());
 }
 
+/*
+ * Reads bands of rows from a RAW image. The file is kept open.
+ */
+
+class RAWImageReader : public ImageReader
+{
+  private:
+
+    std::string   name;
+    std::ifstream in;
+    int           type;
+    bool          msbfirst;
+
+  public:
+
+    RAWImageReader(const char *_name, const std::string &filename, long width, long height,
+                   int _type, bool _msbfirst) :
+      ImageReader(width, height, 1), name(_name), type(_type), msbfirst(_msbfirst)
+    {
+      in.exceptions(std::ios_base::failbit | std::ios_base::badbit | std::ios_base::eofbit);
+
+      try
+      {
+        in.open(filename.c_str(), std::ios::binary);
+      }
+      catch (const std::ios_base::failure &ex)
+      {
+        throw gutil::IOException(ex.what());
+      }
+    }
+
+  protected:
+
+    void readRows(ImageU8 &band, long k)
+    {
+      if (type > 1)
+      {
+        throw gutil::IOException("A 16 bit image cannot be read as 8 bit image ("+name+")");
+      }
+
+      try
+      {
+        in.seekg(static_cast<std::streamoff>(k)*getWidth());
+
+        for (long j=0; j<band.getHeight(); j++)
+        {
+          in.read(reinterpret_cast<char *>(band.getPtr(0, j, 0)),
+                  static_cast<std::streamsize>(getWidth()));
+        }
+      }
+      catch (const std::ios_base::failure &ex)
+      {
+        throw gutil::IOException(ex.what());
+      }
+    }
+
+    void readRows(ImageU16 &band, long k)
+    {
+      if (type > 1)
+      {
+        try
+        {
+          in.seekg(static_cast<std::streamoff>(k)*getWidth()*2);
+
+          std::streambuf *sb=in.rdbuf();
+
+          for (long j=0; j<band.getHeight(); j++)
+          {
+            ImageU16::store_t *p=band.getPtr(0, j, 0);
+
+            for (long i=0; i<getWidth(); i++)
+            {
+              ImageU16::store_t v;
+
+              if (msbfirst)
+              {
+                v=(static_cast<ImageU16::store_t>(sb->sbumpc())&0xff);
+                v=(v<<8)|(static_cast<ImageU16::store_t>(sb->sbumpc())&0xff);
+              }
+              else
+              {
+                v=(static_cast<ImageU16::store_t>(sb->sbumpc())&0xff);
+                v=v|((static_cast<ImageU16::store_t>(sb->sbumpc())&0xff)<<8);
+              }
+
+              p[i]=v;
+            }
+          }
+        }
+        catch (const std::ios_base::failure &ex)
+        {
+          throw gutil::IOException(ex.what());
+        }
+      }
+      else
+      {
+        ImageReader::readRows(band, k);
+      }
+    }
+};
+
+/*
+ * Writes bands of rows into a RAW image with header file.
+ */
+
+class RAWImageWriter : public ImageWriter
+{
+  private:
+
+    std::string   name;
+    std::ofstream out;
+
+    void open(int type)
+    {
+      writeRAWHeader(name.c_str(), type, getWidth(), getHeight());
+
+      out.open(name.c_str(), std::ios::binary);
+    }
+
+  public:
+
+    RAWImageWriter(const char *_name, long width, long height) :
+      ImageWriter(width, height, 1), name(_name)
+    {
+      out.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+    }
+
+  protected:
+
+    void writeRows(const ImageU8 &band, long k)
+    {
+      try
+      {
+        if (k == 0)
+        {
+          open(1);
+        }
+
+        for (long j=0; j<band.getHeight(); j++)
+        {
+          out.write(reinterpret_cast<const char *>(band.getPtr(0, j, 0)),
+                    static_cast<std::streamsize>(getWidth()));
+        }
+      }
+      catch (const std::ios_base::failure &ex)
+      {
+        throw gutil::IOException(ex.what());
+      }
+    }
+
+    void writeRows(const ImageU16 &band, long k)
+    {
+      try
+      {
+        if (k == 0)
+        {
+          open(2);
+        }
+
+        std::streambuf *sb=out.rdbuf();
+
+        for (long j=0; j<band.getHeight(); j++)
+        {
+          const ImageU16::store_t *p=band.getPtr(0, j, 0);
+
+          for (long i=0; i<getWidth(); i++)
+          {
+            sb->sputc(static_cast<char>(p[i]&0xff));
+            sb->sputc(static_cast<char>((p[i]>>8)&0xff));
+          }
+        }
+      }
+      catch (const std::ios_base::failure &ex)
+      {
+        throw gutil::IOException(ex.what());
+      }
+    }
+
+    void finish()
+    {
+      try
+      {
+        out.close();
+      }
+      catch (const std::ios_base::failure &ex)
+      {
+        throw gutil::IOException(ex.what());
+      }
+    }
+};
+
 }
 
 BasicImageIO *RAWImageIO::create() const
@@ -126,7 +318,7 @@ BasicImageIO *RAWImageIO::create() const
   return new RAWImageIO();
 }
 
-bool RAWImageIO::handlesFile(const char *name, bool reading) const
+bool RAWImageIO::handlesFile(const char *name, bool /* reading */) const
 {
   std::string s=name;
   size_t pos;
@@ -428,6 +620,55 @@ void RAWImageIO::load(ImageU16 &image, const char *name, int ds, long x, long y,
   }
 }
 
+void RAWImageIO::map(MappedImageU8 &image, const char *name, MapMode mode) const
+{
+  std::string filename;
+  long   width, height;
+  int    type;
+  bool   msbfirst;
+
+  if (!handlesFile(name, true))
+  {
+    throw gutil::IOException("Can only map RAW image ("+std::string(name)+")");
+  }
+
+  filename=readRAWHeader(name, type, msbfirst, width, height);
+
+  if (type != 1)
+  {
+    throw gutil::IOException("Only 8 bit RAW images can be mapped as 8 bit image ("+std::string(name)+")");
+  }
+
+  image.map(filename.c_str(), 0, width, height, mode);
+}
+
+void RAWImageIO::map(MappedImageU16 &image, const char *name, MapMode mode) const
+{
+  std::string filename;
+  long   width, height;
+  int    type;
+  bool   msbfirst;
+
+  if (!handlesFile(name, true))
+  {
+    throw gutil::IOException("Can only map RAW image ("+std::string(name)+")");
+  }
+
+  filename=readRAWHeader(name, type, msbfirst, width, height);
+
+  if (type != 2)
+  {
+    throw gutil::IOException("Only 16 bit RAW images can be mapped as 16 bit image ("+std::string(name)+")");
+  }
+
+  if (msbfirst != gutil::isMSBFirst())
+  {
+    throw gutil::IOException("Only RAW images in native byte order can be mapped ("+std::string(name)+")");
+  }
+
+  image.map(filename.c_str(), 0, width, height, mode);
+}
+
 void RAWImageIO::save(const ImageU8 &image, const char *name) const
 {
   if (!handlesFile(name, false) || image.getDepth() != 1)
@@ -497,4 +738,32 @@ void RAWImageIO::save(const ImageU16 &image, const char *name) const
   }
 }
 
-}
\ No newline at end of file
+ImageReader *RAWImageIO::openReader(const char *name) const
+{
+  std::string filename;
+  long   width, height;
+  int    type;
+  bool   msbfirst;
+
+  if (!handlesFile(name, true))
+  {
+    throw gutil::IOException("Can only load RAW image ("+std::string(name)+")");
+  }
+
+  filename=readRAWHeader(name, type, msbfirst, width, height);
+
+  return new RAWImageReader(name, filename, width, height, type, msbfirst);
+}
+
+ImageWriter *RAWImageIO::openWriter(const char *name, long width, long height,
+                                    int depth) const
+{
+  if (!handlesFile(name, false) || depth != 1)
+  {
+    throw gutil::IOException("Can only save RAW images with depth 1 ("+std::string(name)+")");
+  }
+
+  return new RAWImageWriter(name, width, height);
+}
+
+}
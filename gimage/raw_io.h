@@ -37,6 +37,7 @@
 #define GIMAGE_RAW_IO_H
 
 #include "io.h"
+#include "mapped.h"
 
 namespace gimage
 {
@@ -60,8 +61,20 @@ class RAWImageIO : public BasicImageIO
     void load(ImageU16 &image, const char *name, int ds=1, long x=0, long y=0, long w=-1,
               long h=-1) const;
 
+    /**
+     * Maps a RAW image in native byte order directly into memory instead of
+     * loading it. Throws gutil::IOException if this is not possible without
+     * conversion.
+     */
+
+    void map(MappedImageU8 &image, const char *name, MapMode mode=map_read_only) const;
+    void map(MappedImageU16 &image, const char *name, MapMode mode=map_read_only) const;
+
     void save(const ImageU8 &image, const char *name) const;
     void save(const ImageU16 &image, const char *name) const;
+
+    ImageReader *openReader(const char *name) const;
+    ImageWriter *openWriter(const char *name, long width, long height, int depth) const;
 };
 
 }
@@ -0,0 +1,1021 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2014, Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "size.h"
+
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GIMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(GIMAGE_SSE2) && defined(__GNUC__) && !defined(GIMAGE_NO_AVX2)
+#define GIMAGE_AVX2
+#include <immintrin.h>
+#define GIMAGE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace gimage
+{
+
+namespace
+{
+
+/*
+ * Number of input columns that are vertically summed at once for the general
+ * downscale factors.
+ */
+
+const long chunk=4096;
+
+/*
+ * Horizontal summation of factor consecutive vertical sums and rounding
+ * division by the number of pixels. The constant factor permits the compiler
+ * to replace the division by a multiplication.
+ */
+
+template<int factor, class S, class T> inline void horizontalMean(T *out, const S *sum, long n)
+{
+  for (long i=0; i<n; i++)
+  {
+    long v=0;
+
+    for (int ii=0; ii<factor; ii++)
+    {
+      v+=sum[ii];
+    }
+
+    *out++=static_cast<T>((v+(factor*factor>>1))/(factor*factor));
+    sum+=factor;
+  }
+}
+
+template<class S, class T> inline void horizontalMean(T *out, const S *sum, long n, int factor)
+{
+  if (factor == 3)
+  {
+    horizontalMean<3>(out, sum, n);
+    return;
+  }
+
+  const long nn=factor*factor;
+
+  for (long i=0; i<n; i++)
+  {
+    long v=0;
+
+    for (int ii=0; ii<factor; ii++)
+    {
+      v+=sum[ii];
+    }
+
+    *out++=static_cast<T>((v+(nn>>1))/nn);
+    sum+=factor;
+  }
+}
+
+#ifdef GIMAGE_SSE2
+
+/*
+ * SSE2 kernels. All of them return the number of computed output pixels.
+ */
+
+long downscale2SSE2(gutil::uint8 *out, const gutil::uint8 *in, long stride, long width)
+{
+  const long n=width/32*16;
+  const __m128i mask=_mm_set1_epi16(0x00ff);
+  const __m128i two=_mm_set1_epi16(2);
+
+  for (long i=0; i<n; i+=16)
+  {
+    const gutil::uint8 *p=in+2*i;
+
+    __m128i a0=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i a1=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p+16));
+    __m128i b0=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p+stride));
+    __m128i b1=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p+stride+16));
+
+    __m128i s0=_mm_add_epi16(_mm_add_epi16(_mm_and_si128(a0, mask), _mm_srli_epi16(a0, 8)),
+                             _mm_add_epi16(_mm_and_si128(b0, mask), _mm_srli_epi16(b0, 8)));
+    __m128i s1=_mm_add_epi16(_mm_add_epi16(_mm_and_si128(a1, mask), _mm_srli_epi16(a1, 8)),
+                             _mm_add_epi16(_mm_and_si128(b1, mask), _mm_srli_epi16(b1, 8)));
+
+    s0=_mm_srli_epi16(_mm_add_epi16(s0, two), 2);
+    s1=_mm_srli_epi16(_mm_add_epi16(s1, two), 2);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out+i), _mm_packus_epi16(s0, s1));
+  }
+
+  return n;
+}
+
+long downscale4SSE2(gutil::uint8 *out, const gutil::uint8 *in, long stride, long width)
+{
+  const long n=width/64*16;
+  const __m128i mask=_mm_set1_epi16(0x00ff);
+  const __m128i one=_mm_set1_epi16(1);
+  const __m128i eight=_mm_set1_epi32(8);
+
+  for (long i=0; i<n; i+=16)
+  {
+    __m128i r[4];
+
+    for (int c=0; c<4; c++)
+    {
+      const gutil::uint8 *p=in+4*i+16*c;
+      __m128i s=_mm_setzero_si128();
+
+      for (int kk=0; kk<4; kk++)
+      {
+        __m128i a=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        s=_mm_add_epi16(s, _mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8)));
+        p+=stride;
+      }
+
+      s=_mm_madd_epi16(s, one);
+      r[c]=_mm_srli_epi32(_mm_add_epi32(s, eight), 4);
+    }
+
+    __m128i v=_mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), _mm_packs_epi32(r[2], r[3]));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out+i), v);
+  }
+
+  return n;
+}
+
+/*
+ * Packing of 32 bit values between 0 and 65535 into 16 bit values.
+ */
+
+inline __m128i packU16SSE2(__m128i a, __m128i b)
+{
+  const __m128i offset32=_mm_set1_epi32(32768);
+  const __m128i offset16=_mm_set1_epi16(-32768);
+
+  a=_mm_sub_epi32(a, offset32);
+  b=_mm_sub_epi32(b, offset32);
+
+  return _mm_add_epi16(_mm_packs_epi32(a, b), offset16);
+}
+
+long downscale2SSE2(gutil::uint16 *out, const gutil::uint16 *in, long stride, long width)
+{
+  const long n=width/16*8;
+  const __m128i mask=_mm_set1_epi32(0xffff);
+  const __m128i two=_mm_set1_epi32(2);
+
+  for (long i=0; i<n; i+=8)
+  {
+    const gutil::uint16 *p=in+2*i;
+    __m128i s[2];
+
+    for (int c=0; c<2; c++)
+    {
+      __m128i a=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p+8*c));
+      __m128i b=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p+8*c+stride));
+
+      s[c]=_mm_add_epi32(_mm_add_epi32(_mm_and_si128(a, mask), _mm_srli_epi32(a, 16)),
+                         _mm_add_epi32(_mm_and_si128(b, mask), _mm_srli_epi32(b, 16)));
+      s[c]=_mm_srli_epi32(_mm_add_epi32(s[c], two), 2);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out+i), packU16SSE2(s[0], s[1]));
+  }
+
+  return n;
+}
+
+long downscale4SSE2(gutil::uint16 *out, const gutil::uint16 *in, long stride, long width)
+{
+  const long n=width/32*8;
+  const __m128i mask=_mm_set1_epi32(0xffff);
+  const __m128i eight=_mm_set1_epi32(8);
+
+  for (long i=0; i<n; i+=8)
+  {
+    __m128i r[2];
+
+    for (int c=0; c<2; c++)
+    {
+      const gutil::uint16 *p=in+4*i+16*c;
+      __m128i sa=_mm_setzero_si128();
+      __m128i sb=_mm_setzero_si128();
+
+      for (int kk=0; kk<4; kk++)
+      {
+        __m128i a=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i b=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p+8));
+
+        sa=_mm_add_epi32(sa, _mm_add_epi32(_mm_and_si128(a, mask), _mm_srli_epi32(a, 16)));
+        sb=_mm_add_epi32(sb, _mm_add_epi32(_mm_and_si128(b, mask), _mm_srli_epi32(b, 16)));
+        p+=stride;
+      }
+
+      __m128 fa=_mm_castsi128_ps(sa);
+      __m128 fb=_mm_castsi128_ps(sb);
+
+      __m128i even=_mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+      __m128i odd=_mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+
+      r[c]=_mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(even, odd), eight), 4);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out+i), packU16SSE2(r[0], r[1]));
+  }
+
+  return n;
+}
+
+/*
+ * Vertical summation of factor rows for general downscale factors.
+ */
+
+void verticalSumSSE2(gutil::uint16 *sum, const gutil::uint8 *in, long stride, long width,
+                     int factor)
+{
+  const __m128i zero=_mm_setzero_si128();
+  long i=0;
+
+  while (i+16 <= width)
+  {
+    __m128i s0=_mm_setzero_si128();
+    __m128i s1=_mm_setzero_si128();
+
+    const gutil::uint8 *p=in+i;
+
+    for (int kk=0; kk<factor; kk++)
+    {
+      __m128i a=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+
+      s0=_mm_add_epi16(s0, _mm_unpacklo_epi8(a, zero));
+      s1=_mm_add_epi16(s1, _mm_unpackhi_epi8(a, zero));
+      p+=stride;
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sum+i), s0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sum+i+8), s1);
+    i+=16;
+  }
+
+  while (i < width)
+  {
+    int v=0;
+
+    for (int kk=0; kk<factor; kk++)
+    {
+      v+=in[kk*stride+i];
+    }
+
+    sum[i++]=static_cast<gutil::uint16>(v);
+  }
+}
+
+void verticalSumSSE2(gutil::uint32 *sum, const gutil::uint16 *in, long stride, long width,
+                     int factor)
+{
+  const __m128i zero=_mm_setzero_si128();
+  long i=0;
+
+  while (i+8 <= width)
+  {
+    __m128i s0=_mm_setzero_si128();
+    __m128i s1=_mm_setzero_si128();
+
+    const gutil::uint16 *p=in+i;
+
+    for (int kk=0; kk<factor; kk++)
+    {
+      __m128i a=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+
+      s0=_mm_add_epi32(s0, _mm_unpacklo_epi16(a, zero));
+      s1=_mm_add_epi32(s1, _mm_unpackhi_epi16(a, zero));
+      p+=stride;
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sum+i), s0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sum+i+4), s1);
+    i+=8;
+  }
+
+  while (i < width)
+  {
+    gutil::uint32 v=0;
+
+    for (int kk=0; kk<factor; kk++)
+    {
+      v+=in[kk*stride+i];
+    }
+
+    sum[i++]=v;
+  }
+}
+
+/*
+ * Masked accumulation of valid (i.e. finite) float values. Invalid values
+ * contribute 0, which gives exactly the same sum as skipping them.
+ */
+
+inline void accumulateSSE2(__m128 &v, __m128 &n, __m128 x)
+{
+  const __m128 absmask=_mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  const __m128 inf=_mm_set1_ps(std::numeric_limits<float>::infinity());
+  const __m128 one=_mm_set1_ps(1.0f);
+
+  __m128 valid=_mm_cmplt_ps(_mm_and_ps(x, absmask), inf);
+
+  v=_mm_add_ps(v, _mm_and_ps(valid, x));
+  n=_mm_add_ps(n, _mm_and_ps(valid, one));
+}
+
+inline __m128 meanSSE2(__m128 v, __m128 n)
+{
+  const __m128 inf=_mm_set1_ps(std::numeric_limits<float>::infinity());
+
+  __m128 valid=_mm_cmpgt_ps(n, _mm_setzero_ps());
+
+  return _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(v, n)), _mm_andnot_ps(valid, inf));
+}
+
+long downscale2SSE2(float *out, const float *in, long stride, long width)
+{
+  const long n=width/8*4;
+
+  for (long i=0; i<n; i+=4)
+  {
+    const float *p=in+2*i;
+
+    __m128 v=_mm_setzero_ps();
+    __m128 c=_mm_setzero_ps();
+
+    for (int kk=0; kk<2; kk++)
+    {
+      __m128 a=_mm_loadu_ps(p);
+      __m128 b=_mm_loadu_ps(p+4);
+
+      accumulateSSE2(v, c, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+      accumulateSSE2(v, c, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+      p+=stride;
+    }
+
+    _mm_storeu_ps(out+i, meanSSE2(v, c));
+  }
+
+  return n;
+}
+
+long downscale4SSE2(float *out, const float *in, long stride, long width)
+{
+  const long n=width/16*4;
+
+  for (long i=0; i<n; i+=4)
+  {
+    const float *p=in+4*i;
+
+    __m128 v=_mm_setzero_ps();
+    __m128 c=_mm_setzero_ps();
+
+    for (int kk=0; kk<4; kk++)
+    {
+      __m128 a0=_mm_loadu_ps(p);
+      __m128 a1=_mm_loadu_ps(p+4);
+      __m128 a2=_mm_loadu_ps(p+8);
+      __m128 a3=_mm_loadu_ps(p+12);
+
+      _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+
+      accumulateSSE2(v, c, a0);
+      accumulateSSE2(v, c, a1);
+      accumulateSSE2(v, c, a2);
+      accumulateSSE2(v, c, a3);
+      p+=stride;
+    }
+
+    _mm_storeu_ps(out+i, meanSSE2(v, c));
+  }
+
+  return n;
+}
+
+long downscaleNSSE2(float *out, const float *in, long stride, long width, int factor)
+{
+  const long n=width/(4*factor)*4;
+
+  for (long i=0; i<n; i+=4)
+  {
+    const float *p=in+factor*i;
+
+    __m128 v=_mm_setzero_ps();
+    __m128 c=_mm_setzero_ps();
+
+    for (int kk=0; kk<factor; kk++)
+    {
+      for (int ii=0; ii<factor; ii++)
+      {
+        accumulateSSE2(v, c, _mm_set_ps(p[3*factor+ii], p[2*factor+ii], p[factor+ii], p[ii]));
+      }
+
+      p+=stride;
+    }
+
+    _mm_storeu_ps(out+i, meanSSE2(v, c));
+  }
+
+  return n;
+}
+
+#endif
+
+#ifdef GIMAGE_AVX2
+
+/*
+ * AVX2 kernels for the most common cases. They are only called if the CPU
+ * supports AVX2.
+ */
+
+GIMAGE_TARGET_AVX2
+long downscale2AVX2(gutil::uint8 *out, const gutil::uint8 *in, long stride, long width)
+{
+  const long n=width/64*32;
+  const __m256i mask=_mm256_set1_epi16(0x00ff);
+  const __m256i two=_mm256_set1_epi16(2);
+
+  for (long i=0; i<n; i+=32)
+  {
+    const gutil::uint8 *p=in+2*i;
+
+    __m256i a0=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i a1=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p+32));
+    __m256i b0=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p+stride));
+    __m256i b1=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p+stride+32));
+
+    __m256i s0=_mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a0, mask),
+                                                 _mm256_srli_epi16(a0, 8)),
+                                _mm256_add_epi16(_mm256_and_si256(b0, mask),
+                                                 _mm256_srli_epi16(b0, 8)));
+    __m256i s1=_mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a1, mask),
+                                                 _mm256_srli_epi16(a1, 8)),
+                                _mm256_add_epi16(_mm256_and_si256(b1, mask),
+                                                 _mm256_srli_epi16(b1, 8)));
+
+    s0=_mm256_srli_epi16(_mm256_add_epi16(s0, two), 2);
+    s1=_mm256_srli_epi16(_mm256_add_epi16(s1, two), 2);
+
+    // packing works within 128 bit lanes, which requires reordering
+
+    __m256i v=_mm256_permute4x64_epi64(_mm256_packus_epi16(s0, s1), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out+i), v);
+  }
+
+  return n;
+}
+
+GIMAGE_TARGET_AVX2
+long downscale2AVX2(gutil::uint16 *out, const gutil::uint16 *in, long stride, long width)
+{
+  const long n=width/32*16;
+  const __m256i mask=_mm256_set1_epi32(0xffff);
+  const __m256i two=_mm256_set1_epi32(2);
+
+  for (long i=0; i<n; i+=16)
+  {
+    const gutil::uint16 *p=in+2*i;
+    __m256i s[2];
+
+    for (int c=0; c<2; c++)
+    {
+      __m256i a=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p+16*c));
+      __m256i b=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p+16*c+stride));
+
+      s[c]=_mm256_add_epi32(_mm256_add_epi32(_mm256_and_si256(a, mask), _mm256_srli_epi32(a, 16)),
+                            _mm256_add_epi32(_mm256_and_si256(b, mask), _mm256_srli_epi32(b, 16)));
+      s[c]=_mm256_srli_epi32(_mm256_add_epi32(s[c], two), 2);
+    }
+
+    __m256i v=_mm256_permute4x64_epi64(_mm256_packus_epi32(s[0], s[1]), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out+i), v);
+  }
+
+  return n;
+}
+
+GIMAGE_TARGET_AVX2
+void verticalSumAVX2(gutil::uint16 *sum, const gutil::uint8 *in, long stride, long width,
+                     int factor)
+{
+  long i=0;
+
+  while (i+16 <= width)
+  {
+    __m256i s=_mm256_setzero_si256();
+
+    const gutil::uint8 *p=in+i;
+
+    for (int kk=0; kk<factor; kk++)
+    {
+      __m128i a=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+
+      s=_mm256_add_epi16(s, _mm256_cvtepu8_epi16(a));
+      p+=stride;
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(sum+i), s);
+    i+=16;
+  }
+
+  while (i < width)
+  {
+    int v=0;
+
+    for (int kk=0; kk<factor; kk++)
+    {
+      v+=in[kk*stride+i];
+    }
+
+    sum[i++]=static_cast<gutil::uint16>(v);
+  }
+}
+
+GIMAGE_TARGET_AVX2
+void verticalSumAVX2(gutil::uint32 *sum, const gutil::uint16 *in, long stride, long width,
+                     int factor)
+{
+  long i=0;
+
+  while (i+8 <= width)
+  {
+    __m256i s=_mm256_setzero_si256();
+
+    const gutil::uint16 *p=in+i;
+
+    for (int kk=0; kk<factor; kk++)
+    {
+      __m128i a=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+
+      s=_mm256_add_epi32(s, _mm256_cvtepu16_epi32(a));
+      p+=stride;
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(sum+i), s);
+    i+=8;
+  }
+
+  while (i < width)
+  {
+    gutil::uint32 v=0;
+
+    for (int kk=0; kk<factor; kk++)
+    {
+      v+=in[kk*stride+i];
+    }
+
+    sum[i++]=v;
+  }
+}
+
+GIMAGE_TARGET_AVX2
+inline void accumulateAVX2(__m256 &v, __m256 &n, __m256 x)
+{
+  const __m256 absmask=_mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  const __m256 inf=_mm256_set1_ps(std::numeric_limits<float>::infinity());
+  const __m256 one=_mm256_set1_ps(1.0f);
+
+  __m256 valid=_mm256_cmp_ps(_mm256_and_ps(x, absmask), inf, _CMP_LT_OQ);
+
+  v=_mm256_add_ps(v, _mm256_and_ps(valid, x));
+  n=_mm256_add_ps(n, _mm256_and_ps(valid, one));
+}
+
+GIMAGE_TARGET_AVX2
+inline __m256 meanAVX2(__m256 v, __m256 n)
+{
+  const __m256 inf=_mm256_set1_ps(std::numeric_limits<float>::infinity());
+
+  __m256 valid=_mm256_cmp_ps(n, _mm256_setzero_ps(), _CMP_GT_OQ);
+
+  return _mm256_blendv_ps(inf, _mm256_div_ps(v, n), valid);
+}
+
+GIMAGE_TARGET_AVX2
+long downscale2AVX2(float *out, const float *in, long stride, long width)
+{
+  const long n=width/16*8;
+
+  for (long i=0; i<n; i+=8)
+  {
+    const float *p=in+2*i;
+
+    __m256 v=_mm256_setzero_ps();
+    __m256 c=_mm256_setzero_ps();
+
+    for (int kk=0; kk<2; kk++)
+    {
+      // shuffling works within 128 bit lanes, which requires reordering
+
+      __m256 a=_mm256_loadu_ps(p);
+      __m256 b=_mm256_loadu_ps(p+8);
+
+      __m256 even=_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+      __m256 odd=_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+      even=_mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(even), _MM_SHUFFLE(3, 1, 2, 0)));
+      odd=_mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(odd), _MM_SHUFFLE(3, 1, 2, 0)));
+
+      accumulateAVX2(v, c, even);
+      accumulateAVX2(v, c, odd);
+      p+=stride;
+    }
+
+    _mm256_storeu_ps(out+i, meanAVX2(v, c));
+  }
+
+  return n;
+}
+
+GIMAGE_TARGET_AVX2
+long downscaleNAVX2(float *out, const float *in, long stride, long width, int factor)
+{
+  const long n=width/(8*factor)*8;
+  const __m256i index=_mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                          _mm256_set1_epi32(factor));
+
+  for (long i=0; i<n; i+=8)
+  {
+    const float *p=in+factor*i;
+
+    __m256 v=_mm256_setzero_ps();
+    __m256 c=_mm256_setzero_ps();
+
+    for (int kk=0; kk<factor; kk++)
+    {
+      for (int ii=0; ii<factor; ii++)
+      {
+        accumulateAVX2(v, c, _mm256_i32gather_ps(p+ii, index, 4));
+      }
+
+      p+=stride;
+    }
+
+    _mm256_storeu_ps(out+i, meanAVX2(v, c));
+  }
+
+  return n;
+}
+
+#endif
+
+#ifdef GIMAGE_AVX2
+
+bool checkAVX2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+}
+
+inline bool hasAVX2()
+{
+  static const bool avx2=checkAVX2();
+  return avx2;
+}
+
+#else
+
+inline bool hasAVX2()
+{
+  return false;
+}
+
+#endif
+
+template<class T, class S> long downscaleRowGeneral(T *out, const T *in, long stride, long width,
+                                                    int factor)
+{
+  S sum[chunk];
+
+  const long cw=chunk/factor*factor;
+  long i=0;
+
+  while (i+factor <= width)
+  {
+    long w=std::min(cw, width/factor*factor-i);
+
+#ifdef GIMAGE_AVX2
+    if (hasAVX2())
+    {
+      verticalSumAVX2(sum, in+i, stride, w, factor);
+    }
+    else
+#endif
+    {
+      verticalSumSSE2(sum, in+i, stride, w, factor);
+    }
+
+    horizontalMean(out, sum, w/factor, factor);
+
+    out+=w/factor;
+    i+=w;
+  }
+
+  return i/factor;
+}
+
+}
+
+#ifdef GIMAGE_SSE2
+
+long downscaleRowSIMD(gutil::uint8 *out, const gutil::uint8 *in, long stride, long width,
+                      int factor)
+{
+  switch (factor)
+  {
+    case 1:
+      return 0;
+
+    case 2:
+#ifdef GIMAGE_AVX2
+      if (hasAVX2())
+      {
+        return downscale2AVX2(out, in, stride, width);
+      }
+#endif
+      return downscale2SSE2(out, in, stride, width);
+
+    case 4:
+      return downscale4SSE2(out, in, stride, width);
+
+    default:
+      if (factor > 257 || factor > chunk)
+      {
+        return 0;
+      }
+
+      return downscaleRowGeneral<gutil::uint8, gutil::uint16>(out, in, stride, width, factor);
+  }
+}
+
+long downscaleRowSIMD(gutil::uint16 *out, const gutil::uint16 *in, long stride, long width,
+                      int factor)
+{
+  switch (factor)
+  {
+    case 1:
+      return 0;
+
+    case 2:
+#ifdef GIMAGE_AVX2
+      if (hasAVX2())
+      {
+        return downscale2AVX2(out, in, stride, width);
+      }
+#endif
+      return downscale2SSE2(out, in, stride, width);
+
+    case 4:
+      return downscale4SSE2(out, in, stride, width);
+
+    default:
+      if (factor > 181 || factor > chunk)
+      {
+        return 0;
+      }
+
+      return downscaleRowGeneral<gutil::uint16, gutil::uint32>(out, in, stride, width, factor);
+  }
+}
+
+long downscaleRowSIMD(float *out, const float *in, long stride, long width, int factor)
+{
+  switch (factor)
+  {
+    case 1:
+      return 0;
+
+    case 2:
+#ifdef GIMAGE_AVX2
+      if (hasAVX2())
+      {
+        return downscale2AVX2(out, in, stride, width);
+      }
+#endif
+      return downscale2SSE2(out, in, stride, width);
+
+    case 4:
+      return downscale4SSE2(out, in, stride, width);
+
+    default:
+#ifdef GIMAGE_AVX2
+      if (hasAVX2())
+      {
+        return downscaleNAVX2(out, in, stride, width, factor);
+      }
+#endif
+      return downscaleNSSE2(out, in, stride, width, factor);
+  }
+}
+
+#else
+
+long downscaleRowSIMD(gutil::uint8 *out, const gutil::uint8 *in, long stride, long width,
+                      int factor)
+{
+  return 0;
+}
+
+long downscaleRowSIMD(gutil::uint16 *out, const gutil::uint16 *in, long stride, long width,
+                      int factor)
+{
+  return 0;
+}
+
+long downscaleRowSIMD(float *out, const float *in, long stride, long width, int factor)
+{
+  return 0;
+}
+
+#endif
+
+
+namespace
+{
+
+inline double sinc(double x)
+{
+  if (x == 0)
+  {
+    return 1;
+  }
+
+  x*=3.14159265358979323846;
+
+  return std::sin(x)/x;
+}
+
+/*
+ * Support of the kernel and kernel function. The area kernel is handled
+ * separately by computing the overlap of pixels.
+ */
+
+inline double getKernelSupport(ResampleKernel kernel)
+{
+  return kernel == kernel_lanczos3 ? 3 : 1;
+}
+
+inline double getKernelWeight(ResampleKernel kernel, double x)
+{
+  x=std::abs(x);
+
+  if (kernel == kernel_lanczos3)
+  {
+    return x < 3 ? sinc(x)*sinc(x/3) : 0;
+  }
+
+  return x < 1 ? 1-x : 0;
+}
+
+}
+
+ResampleKernel getResampleKernel(const std::string &name)
+{
+  if (name == "bilinear")
+  {
+    return kernel_bilinear;
+  }
+
+  if (name == "area")
+  {
+    return kernel_area;
+  }
+
+  if (name == "lanczos3")
+  {
+    return kernel_lanczos3;
+  }
+
+  throw std::invalid_argument("Unknown resampling kernel: "+name);
+}
+
+ResampleTable::ResampleTable(long _nin, long _nout, ResampleKernel kernel)
+{
+  nin=std::max(0l, _nin);
+  nout=std::max(0l, _nout);
+  n=0;
+
+  first.assign(nout, 0);
+
+  if (nin == 0 || nout == 0)
+  {
+    return;
+  }
+
+  // determine range of input pixels for each output pixel
+
+  const double scale=static_cast<double>(nin)/nout;
+  const double fs=std::max(1.0, scale);
+  const double support=getKernelSupport(kernel)*fs;
+
+  std::vector<long> j0(nout), j1(nout);
+
+  for (long i=0; i<nout; i++)
+  {
+    double a, b;
+
+    if (kernel == kernel_area)
+    {
+      a=i*scale;
+      b=(i+1)*scale;
+    }
+    else
+    {
+      const double c=(i+0.5)*scale;
+
+      a=c-support-0.5;
+      b=c+support+0.5;
+    }
+
+    j0[i]=std::max(0l, static_cast<long>(std::floor(a)));
+    j1[i]=std::min(nin, static_cast<long>(std::ceil(b)));
+    j1[i]=std::max(j0[i]+1, j1[i]);
+
+    n=std::max(n, static_cast<int>(j1[i]-j0[i]));
+  }
+
+  // compute normalized weights, all output pixels use the same number of
+  // input pixels, which requires shifting the first pixel at the border
+
+  weight.assign(nout*n, 0.0f);
+
+  std::vector<double> w(n);
+
+  for (long i=0; i<nout; i++)
+  {
+    const double c=(i+0.5)*scale;
+    double sum=0;
+
+    for (long j=j0[i]; j<j1[i]; j++)
+    {
+      double v;
+
+      if (kernel == kernel_area)
+      {
+        v=std::max(0.0, std::min(static_cast<double>(j+1), (i+1)*scale)-
+                   std::max(static_cast<double>(j), i*scale));
+      }
+      else
+      {
+        v=getKernelWeight(kernel, (j+0.5-c)/fs);
+      }
+
+      w[j-j0[i]]=v;
+      sum+=v;
+    }
+
+    if (sum == 0)
+    {
+      sum=1;
+    }
+
+    first[i]=std::min(j0[i], nin-n);
+
+    float *wp=&weight[i*n+j0[i]-first[i]];
+
+    for (long j=j0[i]; j<j1[i]; j++)
+    {
+      *wp++=static_cast<float>(w[j-j0[i]]/sum);
+    }
+  }
+}
+
+}
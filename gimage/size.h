@@ -39,122 +39,138 @@
 
 #include "image.h"
 
+#include <gutil/thread.h>
+
 #include <vector>
+#include <string>
+#include <limits>
+#include <cmath>
 
 namespace gimage
 {
 
-template<class T> Image<T> downscaleImage(const Image<T> &image, int factor)
+/**
+ * Computes as many pixels of one output row of downscaleImage() with SIMD
+ * instructions as possible and returns their number. Only full blocks of
+ * factor*factor pixels are handled. The result is exactly the same as that of
+ * the plain implementation. The return value is 0 if the pixel type, factor or
+ * CPU is not supported.
+ */
+
+long downscaleRowSIMD(gutil::uint8 *out, const gutil::uint8 *in, long stride, long width,
+                      int factor);
+long downscaleRowSIMD(gutil::uint16 *out, const gutil::uint16 *in, long stride, long width,
+                      int factor);
+long downscaleRowSIMD(float *out, const float *in, long stride, long width, int factor);
+
+template<class T> inline long downscaleRowSIMD(T *out, const T *in, long stride, long width,
+                                               int factor)
 {
-  factor=std::max(1, factor);
+  return 0;
+}
 
-  if (factor == 1)
+/*
+ * Runs the given function for the given number of rows. The rows are
+ * processed in parallel, if the number of pixels is big enough. The number of
+ * threads can be limited by gutil::Thread::setMaxThreads() or the environment
+ * variable CVKIT_MAX_THREADS. The result does not depend on the number of
+ * threads.
+ */
+
+inline void runParallelRows(gutil::ParallelFunction &fct, long rows, double pixels)
+{
+  if (pixels >= 262144)
   {
-    return image;
+    gutil::runParallel(fct, 0, rows-1, 1);
   }
-
-  Image<T> ret((image.getWidth()+factor-1)/factor,
-               (image.getHeight()+factor-1)/factor, image.getDepth());
-
-  for (int d=0; d<image.getDepth(); d++)
+  else if (rows > 0)
   {
-    T *out=ret.getPtr(0, 0, d);
+    fct.run(0, rows-1, 1);
+  }
+}
 
-    long k=0;
+/*
+ * Computes row ko of channel d of the downscaled image.
+ */
 
-    while (k+factor <= image.getHeight())
-    {
-      long i=0;
+template<class T> void downscaleRow(Image<T> &ret, const ImageView<const T> &image, int factor,
+                                    int d, long ko)
+{
+  const long stride=image.getRowStride();
+  const long k=ko*factor;
 
-      if (factor == 2)
-      {
-        // speeding up special case of averaging over 2*2 pixels
+  T *out=ret.getPtr(0, ko, d);
 
-        while (i+2 <= image.getWidth())
-        {
-          typename Image<T>::work_t v;
+  if (k+factor <= image.getHeight())
+  {
+    long i=downscaleRowSIMD(out, image.getPtr(0, k, d), stride, image.getWidth(), factor);
 
-          const T *in=image.getPtr(i, k, d);
+    out+=i;
+    i*=factor;
 
-          v=*in+in[1];
-          in+=image.getWidth();
-          v+=*in+in[1];
+    if (factor == 2)
+    {
+      // speeding up special case of averaging over 2*2 pixels
 
-          *out++=static_cast<typename Image<T>::store_t>((v+2)/4);
-          i+=2;
-        }
-      }
-      else if (factor == 3)
+      while (i+2 <= image.getWidth())
       {
-        // speeding up special case of averaging over 3*3 pixels
+        typename Image<T>::work_t v;
 
-        while (i+3 <= image.getWidth())
-        {
-          typename Image<T>::work_t v=0;
-
-          const T *in=image.getPtr(i, k, d);
+        const T *in=image.getPtr(i, k, d);
 
-          for (int j=0; j<3; j++)
-          {
-            v+=*in+in[1]+in[2];
-            in+=image.getWidth();
-          }
+        v=*in+in[1];
+        in+=stride;
+        v+=*in+in[1];
 
-          *out++=static_cast<typename Image<T>::store_t>((v+4)/9);
-          i+=3;
-        }
+        *out++=static_cast<typename Image<T>::store_t>((v+2)/4);
+        i+=2;
       }
-      else if (factor == 4)
-      {
-        // speeding up special case of averaging over 4*4 pixels
-
-        while (i+4 <= image.getWidth())
-        {
-          typename Image<T>::work_t v=0;
-
-          const T *in=image.getPtr(i, k, d);
-
-          for (int j=0; j<4; j++)
-          {
-            v+=*in+in[1]+in[2]+in[3];
-            in+=image.getWidth();
-          }
+    }
+    else if (factor == 3)
+    {
+      // speeding up special case of averaging over 3*3 pixels
 
-          *out++=static_cast<typename Image<T>::store_t>((v+8)/16);
-          i+=4;
-        }
-      }
-      else
+      while (i+3 <= image.getWidth())
       {
-        // average over factor*factor pixels of the input image
+        typename Image<T>::work_t v=0;
 
-        while (i+factor <= image.getWidth())
+        const T *in=image.getPtr(i, k, d);
+
+        for (int j=0; j<3; j++)
         {
-          typename Image<T>::work_t v=0;
-          int n=0;
+          v+=*in+in[1]+in[2];
+          in+=stride;
+        }
 
-          const T *in=image.getPtr(i, k, d);
+        *out++=static_cast<typename Image<T>::store_t>((v+4)/9);
+        i+=3;
+      }
+    }
+    else if (factor == 4)
+    {
+      // speeding up special case of averaging over 4*4 pixels
 
-          for (int kk=0; kk<factor; kk++)
-          {
-            for (int ii=0; ii<factor; ii++)
-            {
-              v+=in[ii];
-              n++;
-            }
+      while (i+4 <= image.getWidth())
+      {
+        typename Image<T>::work_t v=0;
 
-            in+=image.getWidth();
-          }
+        const T *in=image.getPtr(i, k, d);
 
-          *out++=static_cast<typename Image<T>::store_t>((v+(n>>1))/n);
-          i+=factor;
+        for (int j=0; j<4; j++)
+        {
+          v+=*in+in[1]+in[2]+in[3];
+          in+=stride;
         }
-      }
 
-      // if there are less than factor pixels left in the image row, then
-      // average with boundary check
+        *out++=static_cast<typename Image<T>::store_t>((v+8)/16);
+        i+=4;
+      }
+    }
+    else
+    {
+      // average over factor*factor pixels of the input image
 
-      if (i < image.getWidth())
+      while (i+factor <= image.getWidth())
       {
         typename Image<T>::work_t v=0;
         int n=0;
@@ -163,273 +179,676 @@ template<class T> Image<T> downscaleImage(const Image<T> &image, int factor)
 
         for (int kk=0; kk<factor; kk++)
         {
-          for (int ii=0; ii<factor && i+ii<image.getWidth(); ii++)
+          for (int ii=0; ii<factor; ii++)
           {
             v+=in[ii];
             n++;
           }
 
-          in+=image.getWidth();
+          in+=stride;
         }
 
         *out++=static_cast<typename Image<T>::store_t>((v+(n>>1))/n);
+        i+=factor;
       }
-
-      k+=factor;
     }
 
-    // if there are less than factor image rows left in the image, then
+    // if there are less than factor pixels left in the image row, then
     // average with boundary check
 
-    if (k < image.getHeight())
+    if (i < image.getWidth())
     {
-      for (long i=0; i<image.getWidth(); i+=factor)
-      {
-        typename Image<T>::work_t v=0;
-        int n=0;
+      typename Image<T>::work_t v=0;
+      int n=0;
 
-        const T *in=image.getPtr(i, k, d);
+      const T *in=image.getPtr(i, k, d);
 
-        for (int kk=0; kk<factor && k+kk<image.getHeight(); kk++)
+      for (int kk=0; kk<factor; kk++)
+      {
+        for (int ii=0; ii<factor && i+ii<image.getWidth(); ii++)
         {
-          for (int ii=0; ii<factor && i+ii<image.getWidth(); ii++)
-          {
-            v+=in[ii];
-            n++;
-          }
+          v+=in[ii];
+          n++;
+        }
+
+        in+=stride;
+      }
+
+      *out++=static_cast<typename Image<T>::store_t>((v+(n>>1))/n);
+    }
+  }
+  else
+  {
+    // if there are less than factor image rows left in the image, then
+    // average with boundary check
+
+    for (long i=0; i<image.getWidth(); i+=factor)
+    {
+      typename Image<T>::work_t v=0;
+      int n=0;
+
+      const T *in=image.getPtr(i, k, d);
 
-          in+=image.getWidth();
+      for (int kk=0; kk<factor && k+kk<image.getHeight(); kk++)
+      {
+        for (int ii=0; ii<factor && i+ii<image.getWidth(); ii++)
+        {
+          v+=in[ii];
+          n++;
         }
 
-        *out++=static_cast<typename Image<T>::store_t>((v+(n>>1))/n);
+        in+=stride;
       }
+
+      *out++=static_cast<typename Image<T>::store_t>((v+(n>>1))/n);
     }
   }
+}
 
-  return ret;
+template<> inline void downscaleRow(Image<float> &ret, const ImageView<const float> &image,
+                                    int factor, int d, long ko)
+{
+  const long stride=image.getRowStride();
+  const long k=ko*factor;
+
+  float *out=ret.getPtr(0, ko, d);
+
+  // number of rows that are available for averaging
+
+  const int kn=static_cast<int>(std::min(static_cast<long>(factor), image.getHeight()-k));
+
+  long i=0;
+
+  if (kn == factor)
+  {
+    i=downscaleRowSIMD(out, image.getPtr(0, k, d), stride, image.getWidth(), factor);
+
+    out+=i;
+    i*=factor;
+  }
+
+  // average over factor*factor pixels of the input image, with boundary check
+
+  while (i < image.getWidth())
+  {
+    typename Image<float>::work_t v=0;
+    int n=0;
+
+    const float *in=image.getPtr(i, k, d);
+
+    for (int kk=0; kk<kn; kk++)
+    {
+      for (int ii=0; ii<factor && i+ii<image.getWidth(); ii++)
+      {
+        if (image.isValidS(in[ii]))
+        {
+          v+=in[ii];
+          n++;
+        }
+      }
+
+      in+=stride;
+    }
+
+    if (n > 0)
+    {
+      *out++=static_cast<typename Image<float>::store_t>(v/n);
+    }
+    else
+    {
+      *out++=PixelTraits<float>::invalid();
+    }
+
+    i+=factor;
+  }
 }
 
-template<> inline Image<float> downscaleImage(const Image<float> &image, int factor)
+template<class T> class DownscaleFct : public gutil::ParallelFunction
+{
+  public:
+
+    DownscaleFct(Image<T> &_ret, const ImageView<const T> &_image, int _factor) :
+      ret(_ret), image(_image), factor(_factor)
+    { }
+
+    void run(long start, long end, long step)
+    {
+      for (long j=start; j<=end; j+=step)
+      {
+        downscaleRow(ret, image, factor, static_cast<int>(j/ret.getHeight()),
+                     j%ret.getHeight());
+      }
+    }
+
+  private:
+
+    Image<T> &ret;
+    const ImageView<const T> &image;
+    int factor;
+};
+
+/**
+ * Downscaling by computing the mean of factor*factor pixels. Invalid pixels
+ * are only considered for floating point images. Rows are processed in
+ * parallel for big images.
+ */
+
+template<class T> Image<T> downscaleImage(const ImageView<const T> &image, int factor)
 {
   factor=std::max(1, factor);
 
-  if (factor == 1)
+  if (factor == 1 || image.getXStride() != 1)
+  {
+    Image<T> tmp;
+    tmp.setImage(image);
+
+    if (factor == 1)
+    {
+      return tmp;
+    }
+
+    return downscaleImage(ImageView<const T>(tmp), factor);
+  }
+
+  Image<T> ret((image.getWidth()+factor-1)/factor,
+               (image.getHeight()+factor-1)/factor, image.getDepth());
+
+  DownscaleFct<T> fct(ret, image, factor);
+  runParallelRows(fct, ret.getHeight()*ret.getDepth(),
+                  static_cast<double>(image.getWidth())*image.getHeight()*image.getDepth());
+
+  return ret;
+}
+
+template<class T> Image<T> downscaleImage(const Image<T> &image, int factor)
+{
+  if (factor <= 1)
   {
     return image;
   }
 
-  Image<float> ret((image.getWidth()+factor-1)/factor,
-                   (image.getHeight()+factor-1)/factor, image.getDepth());
+  return downscaleImage(ImageView<const T>(image), factor);
+}
+
+/*
+ * Returns the element with rank n/2 of the n given values, i.e. the median
+ * for odd n and the upper median for even n. The order of the values is
+ * changed.
+ */
 
-  for (int d=0; d<image.getDepth(); d++)
+template<class T> inline void sortPair(T &a, T &b)
+{
+  if (b < a)
   {
-    float *out=ret.getPtr(0, 0, d);
+    std::swap(a, b);
+  }
+}
 
-    long k=0;
+template<class T> inline T selectMedian(T *v, int n)
+{
+  if (n == 4)
+  {
+    sortPair(v[0], v[1]);
+    sortPair(v[2], v[3]);
 
-    while (k+factor <= image.getHeight())
-    {
-      long i=0;
+    return std::max(std::min(v[1], v[3]), std::max(v[0], v[2]));
+  }
+  else if (n == 9)
+  {
+    // selection network for the median of 9 values
 
-      // average over factor*factor pixels of the input image
+    sortPair(v[1], v[2]); sortPair(v[4], v[5]); sortPair(v[7], v[8]);
+    sortPair(v[0], v[1]); sortPair(v[3], v[4]); sortPair(v[6], v[7]);
+    sortPair(v[1], v[2]); sortPair(v[4], v[5]); sortPair(v[7], v[8]);
+    sortPair(v[0], v[3]); sortPair(v[5], v[8]); sortPair(v[4], v[7]);
+    sortPair(v[3], v[6]); sortPair(v[1], v[4]); sortPair(v[2], v[5]);
+    sortPair(v[4], v[7]); sortPair(v[4], v[2]); sortPair(v[6], v[4]);
+    sortPair(v[4], v[2]);
 
-      while (i+factor <= image.getWidth())
-      {
-        typename Image<float>::work_t v=0;
-        int n=0;
+    return v[4];
+  }
 
-        const float *in=image.getPtr(i, k, d);
+  std::nth_element(v, v+(n>>1), v+n);
 
-        for (int kk=0; kk<factor; kk++)
-        {
-          for (int ii=0; ii<factor; ii++)
-          {
-            if (image.isValidS(in[ii]))
-            {
-              v+=in[ii];
-              n++;
-            }
-          }
+  return v[n>>1];
+}
 
-          in+=image.getWidth();
-        }
+/*
+ * Histogram based selection for integer types with many values.
+ */
 
-        if (n > 0)
-        {
-          *out++=static_cast<typename Image<float>::store_t>(v/n);
-        }
-        else
-        {
-          *out++=PixelTraits<float>::invalid();
-        }
+inline gutil::uint8 selectMedian(gutil::uint8 *v, int n)
+{
+  if (n < 64)
+  {
+    return selectMedian<gutil::uint8>(v, n);
+  }
 
-        i+=factor;
-      }
+  int hist[256]={0};
 
-      // if there are less than factor pixels left in the image row, then
-      // average with boundary check
+  for (int i=0; i<n; i++)
+  {
+    hist[v[i]]++;
+  }
 
-      if (i < image.getWidth())
-      {
-        typename Image<float>::work_t v=0;
-        int n=0;
+  int j=0;
+  int c=hist[0];
 
-        const float *in=image.getPtr(i, k, d);
+  while (c <= (n>>1))
+  {
+    c+=hist[++j];
+  }
 
-        for (int kk=0; kk<factor; kk++)
-        {
-          for (int ii=0; ii<factor && i+ii<image.getWidth(); ii++)
-          {
-            if (image.isValidS(in[ii]))
-            {
-              v+=in[ii];
-              n++;
-            }
-          }
+  return static_cast<gutil::uint8>(j);
+}
 
-          in+=image.getWidth();
-        }
+inline gutil::uint16 selectMedian(gutil::uint16 *v, int n)
+{
+  if (n < 64)
+  {
+    return selectMedian<gutil::uint16>(v, n);
+  }
 
-        if (n > 0)
-        {
-          *out++=static_cast<typename Image<float>::store_t>(v/n);
-        }
-        else
-        {
-          *out++=PixelTraits<float>::invalid();
-        }
-      }
+  // find upper byte of median and then the lower byte
 
-      k+=factor;
+  int hist[256]={0};
+
+  for (int i=0; i<n; i++)
+  {
+    hist[v[i]>>8]++;
+  }
+
+  int rank=n>>1;
+  int high=0;
+
+  while (rank >= hist[high])
+  {
+    rank-=hist[high++];
+  }
+
+  std::fill(hist, hist+256, 0);
+
+  for (int i=0; i<n; i++)
+  {
+    if ((v[i]>>8) == high)
+    {
+      hist[v[i]&0xff]++;
     }
+  }
 
-    // if there are less than factor image rows left in the image, then
-    // average with boundary check
+  int low=0;
+
+  while (rank >= hist[low])
+  {
+    rank-=hist[low++];
+  }
+
+  return static_cast<gutil::uint16>((high<<8)|low);
+}
+
+template<class T> class MedianDownscaleFct : public gutil::ParallelFunction
+{
+  public:
 
-    if (k < image.getHeight())
+    MedianDownscaleFct(Image<T> &_ret, const ImageView<const T> &_image, int _factor) :
+      ret(_ret), image(_image), factor(_factor)
+    { }
+
+    void run(long start, long end, long step)
     {
-      for (long i=0; i<image.getWidth(); i+=factor)
-      {
-        typename Image<float>::work_t v=0;
-        int n=0;
+      std::vector<T> v(factor*factor, 0);
 
-        const float *in=image.getPtr(i, k, d);
+      for (long ko=start; ko<=end; ko+=step)
+      {
+        const long k=ko*factor;
 
-        for (int kk=0; kk<factor && k+kk<image.getHeight(); kk++)
+        for (long i=0; i<image.getWidth(); i+=factor)
         {
-          for (int ii=0; ii<factor && i+ii<image.getWidth(); ii++)
+          for (int d=0; d<image.getDepth(); d++)
           {
-            if (image.isValidS(in[ii]))
+            int n=0;
+
+            for (int kk=0; kk<factor && k+kk<image.getHeight(); kk++)
             {
-              v+=in[ii];
-              n++;
+              for (int ii=0; ii<factor && i+ii<image.getWidth(); ii++)
+              {
+                if (image.isValid(i+ii, k+kk))
+                {
+                  v[n]=image.get(i+ii, k+kk, d);
+                  n++;
+                }
+              }
             }
-          }
 
-          in+=image.getWidth();
-        }
+            ret.setInvalid(i/factor, ko, d);
 
-        if (n > 0)
-        {
-          *out++=static_cast<typename Image<float>::store_t>(v/n);
+            if (n > 0)
+            {
+              ret.set(i/factor, ko, d, selectMedian(&v[0], n));
+            }
+          }
         }
-        else
+      }
+    }
+
+  private:
+
+    Image<T> &ret;
+    const ImageView<const T> &image;
+    int factor;
+};
+
+/**
+ * Downscaling by computing the median of factor*factor pixels. Invalid pixels
+ * are ignored. Rows are processed in parallel for big images.
+ */
+
+template<class T> Image<T> medianDownscaleImage(const ImageView<const T> &image, int factor)
+{
+  factor=std::max(1, factor);
+
+  Image<T> ret((image.getWidth()+factor-1)/factor,
+               (image.getHeight()+factor-1)/factor, image.getDepth());
+
+  MedianDownscaleFct<T> fct(ret, image, factor);
+  runParallelRows(fct, ret.getHeight(),
+                  static_cast<double>(image.getWidth())*image.getHeight()*image.getDepth());
+
+  return ret;
+}
+
+template<class T> Image<T> medianDownscaleImage(const Image<T> &image, int factor)
+{
+  return medianDownscaleImage(ImageView<const T>(image), factor);
+}
+
+template<class T> class ResizeBilinearFct : public gutil::ParallelFunction
+{
+  public:
+
+    ResizeBilinearFct(Image<T> &_ret, const ImageView<const T> &_image) :
+      ret(_ret), image(_image)
+    { }
+
+    void run(long start, long end, long step)
+    {
+      std::vector<typename Image<T>::work_t> v(image.getDepth());
+
+      const float fx=static_cast<float>(image.getWidth())/ret.getWidth();
+      const float fy=static_cast<float>(image.getHeight())/ret.getHeight();
+
+      for (long k=start; k<=end; k+=step)
+      {
+        for (long i=0; i<ret.getWidth(); i++)
         {
-          *out++=PixelTraits<float>::invalid();
+          image.getBilinear(v, i*fx, k*fy);
+
+          for (int d=0; d<image.getDepth(); d++)
+          {
+            ret.set(i, k, d, static_cast<typename Image<T>::store_t>(v[d]));
+          }
         }
       }
     }
-  }
+
+  private:
+
+    Image<T> &ret;
+    const ImageView<const T> &image;
+};
+
+/**
+ * Resizing with bilinear interpolation. Rows are processed in parallel for big
+ * images.
+ */
+
+template<class T> Image<T> resizeImageBilinear(const ImageView<const T> &image, long w, long h)
+{
+  Image<T> ret(w, h, image.getDepth());
+
+  ResizeBilinearFct<T> fct(ret, image);
+  runParallelRows(fct, h, static_cast<double>(w)*h*image.getDepth());
 
   return ret;
 }
 
-template<class T> Image<T> medianDownscaleImage(const Image<T> &image, int factor)
+template<class T> Image<T> resizeImageBilinear(const Image<T> &image, long w, long h)
 {
-  factor=std::max(1, factor);
+  return resizeImageBilinear(ImageView<const T>(image), w, h);
+}
 
-  Image<T> ret((image.getWidth()+factor-1)/factor,
-               (image.getHeight()+factor-1)/factor, image.getDepth());
+/**
+ * Kernels for resampling images with resampleImage().
+ */
 
-  std::vector<T> v(factor*factor, 0);
+enum ResampleKernel {kernel_bilinear, kernel_area, kernel_lanczos3};
 
-  for (int d=0; d<image.getDepth(); d++)
-  {
-    for (long k=0; k<image.getHeight(); k+=factor)
+/**
+ * Returns the kernel with the given name, i.e. bilinear, area or lanczos3. An
+ * exception is thrown for unknown names.
+ */
+
+ResampleKernel getResampleKernel(const std::string &name);
+
+/**
+ * Precomputed weights for resampling along one dimension. Output pixel i is
+ * the weighted sum of getSize() input pixels, starting at input pixel
+ * getFirst(i). The weights are normalized such that their sum is 1. Kernels
+ * are widened by the scale factor for downscaling.
+ */
+
+class ResampleTable
+{
+  public:
+
+    ResampleTable(long nin, long nout, ResampleKernel kernel);
+
+    long getInputSize() const { return nin; }
+    long getOutputSize() const { return nout; }
+    int getSize() const { return n; }
+
+    long getFirst(long i) const { return first[i]; }
+    const float *getWeights(long i) const { return weight.data()+i*n; }
+
+  private:
+
+    long nin, nout;
+    int n;
+
+    std::vector<long> first;
+    std::vector<float> weight;
+};
+
+template<class T> class ResampleFct : public gutil::ParallelFunction
+{
+  public:
+
+    ResampleFct(Image<T> &_ret, const ImageView<const T> &_image, const ResampleTable &_xt,
+                const ResampleTable &_yt) :
+      ret(_ret), image(_image), xt(_xt), yt(_yt)
+    { }
+
+    void run(long start, long end, long step)
     {
-      for (long i=0; i<image.getWidth(); i+=factor)
+      const bool valid=std::numeric_limits<T>::is_integer;
+      const long w=image.getWidth();
+      const long stride=image.getRowStride();
+
+      std::vector<float> vs(w), ns(w);
+
+      float *v=&vs[0];
+      float *n=&ns[0];
+
+      for (long j=start; j<=end; j+=step)
       {
-        int n=0;
+        const int d=static_cast<int>(j/ret.getHeight());
+        const long k=j%ret.getHeight();
+
+        // vertical pass into a row of weighted sums of valid pixels and sums
+        // of weights of valid pixels
+
+        const float *wy=yt.getWeights(k);
+        const T *in=image.getPtr(0, yt.getFirst(k), d);
+
+        std::fill(vs.begin(), vs.end(), 0.0f);
 
-        for (int kk=0; kk<factor && k+kk<image.getHeight(); kk++)
+        if (valid)
         {
-          for (int ii=0; ii<factor && i+ii<image.getWidth(); ii++)
+          for (int t=0; t<yt.getSize(); t++)
           {
-            if (image.isValid(i+ii, k+kk))
+            const float f=wy[t];
+
+            for (long i=0; i<w; i++)
+            {
+              v[i]+=f*in[i];
+            }
+
+            in+=stride;
+          }
+        }
+        else
+        {
+          std::fill(ns.begin(), ns.end(), 0.0f);
+
+          for (int t=0; t<yt.getSize(); t++)
+          {
+            const float f=wy[t];
+
+            for (long i=0; i<w; i++)
             {
-              v[n]=image.get(i+ii, k+kk, d);
-              n++;
+              const bool ok=image.isValidS(in[i]);
+
+              v[i]+=ok ? f*in[i] : 0.0f;
+              n[i]+=ok ? f : 0.0f;
             }
+
+            in+=stride;
           }
         }
 
-        ret.setInvalid(i/factor, k/factor, d);
+        // horizontal pass
+
+        T *out=ret.getPtr(0, k, d);
 
-        if (n > 0)
+        for (long i=0; i<ret.getWidth(); i++)
         {
-          partial_sort(v.begin(), v.begin()+(n>>1), v.begin()+n);
-          ret.set(i/factor, k/factor, d, v[n>>1]);
+          const float *wx=xt.getWeights(i);
+          const long i0=xt.getFirst(i);
+
+          float s=0;
+
+          for (int t=0; t<xt.getSize(); t++)
+          {
+            s+=wx[t]*v[i0+t];
+          }
+
+          if (valid)
+          {
+            out[i]=ptraits::limit(static_cast<typename ImageView<T>::work_t>(std::floor(s+0.5f)));
+          }
+          else
+          {
+            float c=0;
+
+            for (int t=0; t<xt.getSize(); t++)
+            {
+              c+=wx[t]*n[i0+t];
+            }
+
+            // the output pixel is invalid if the valid input pixels contribute
+            // less than half of the weight
+
+            if (c >= 0.5f)
+            {
+              out[i]=ptraits::limit(static_cast<typename ImageView<T>::work_t>(s/c));
+            }
+            else
+            {
+              out[i]=ptraits::limit(ptraits::invalid());
+            }
+          }
         }
       }
     }
-  }
 
-  return ret;
-}
+  private:
 
-template<class T> Image<T> resizeImageBilinear(const Image<T> &image, long w, long h)
-{
-  std::vector<typename Image<T>::work_t> v(image.getDepth());
-  Image<T> ret(w, h, image.getDepth());
+    typedef PixelTraits<T> ptraits;
+
+    Image<T> &ret;
+    const ImageView<const T> &image;
+    const ResampleTable &xt, &yt;
+};
+
+/**
+ * Resampling to the given size with a separable kernel. All weights are
+ * precomputed. Pixel centers are aligned, i.e. pixel i of the result
+ * corresponds to position (i+0.5)*image.getWidth()/w-0.5 of the given image.
+ * Invalid pixels are only considered for floating point images. An output
+ * pixel is invalid if the valid input pixels contribute less than half of the
+ * weight. Rows are processed in parallel for big images.
+ */
 
-  const float fx=static_cast<float>(image.getWidth())/w;
-  const float fy=static_cast<float>(image.getHeight())/h;
+template<class T> Image<T> resampleImage(const ImageView<const T> &image, long w, long h,
+                                         ResampleKernel kernel)
+{
+  w=std::max(0l, w);
+  h=std::max(0l, h);
 
-  for (long k=0; k<h; k++)
+  if (image.getXStride() != 1)
   {
-    for (long i=0; i<w; i++)
-    {
-      image.getBilinear(v, i*fx, k*fy);
+    Image<T> tmp;
+    tmp.setImage(image);
 
-      for (int d=0; d<image.getDepth(); d++)
-      {
-        ret.set(i, k, d, static_cast<typename Image<T>::store_t>(v[d]));
-      }
-    }
+    return resampleImage(ImageView<const T>(tmp), w, h, kernel);
   }
 
+  Image<T> ret(w, h, image.getDepth());
+
+  if (image.getWidth() == 0 || image.getHeight() == 0)
+  {
+    ret=PixelTraits<T>::limit(PixelTraits<T>::invalid());
+    return ret;
+  }
+
+  ResampleTable xt(image.getWidth(), w, kernel);
+  ResampleTable yt(image.getHeight(), h, kernel);
+
+  ResampleFct<T> fct(ret, image, xt, yt);
+  runParallelRows(fct, h*image.getDepth(),
+                  static_cast<double>(std::max(w, image.getWidth()))*
+                  std::max(h, image.getHeight())*image.getDepth());
+
   return ret;
 }
 
-template<class T> Image<T> cropImage(const Image<T> &image, long x, long y, long w, long h)
+template<class T> Image<T> resampleImage(const Image<T> &image, long w, long h,
+                                         ResampleKernel kernel)
+{
+  return resampleImage(ImageView<const T>(image), w, h, kernel);
+}
+
+/**
+ * Returns a copy of a part of the image. Pixels outside the image are set to
+ * invalid. Use ImageView for accessing a part of the image without copying.
+ */
+
+template<class T> Image<T> cropImage(const ImageView<const T> &image, long x, long y, long w,
+                                     long h)
 {
   w=std::max(0l, w);
   h=std::max(0l, h);
 
-  Image<T> ret(w, h, image.getDepth());
+  Image<T> ret;
 
   if (x >= 0 && y >= 0 && x+w <= image.getWidth() && y+h <= image.getHeight())
   {
-    for (int d=0; d<image.getDepth(); d++)
-    {
-      for (long k=0; k<h; k++)
-      {
-        memcpy(ret.getPtr(0, k, d), image.getPtr(x, y+k, d), w*sizeof(T));
-      }
-    }
+    ret.setImage(image.crop(x, y, w, h));
   }
   else
   {
+    ret.setSize(w, h, image.getDepth());
+
     for (int d=0; d<image.getDepth(); d++)
     {
       for (long k=0; k<h; k++)
@@ -444,6 +863,11 @@ template<class T> Image<T> cropImage(const Image<T> &image, long x, long y, long
   return ret;
 }
 
+template<class T> Image<T> cropImage(const Image<T> &image, long x, long y, long w, long h)
+{
+  return cropImage(ImageView<const T>(image), x, y, w, h);
+}
+
 }
 
 #endif
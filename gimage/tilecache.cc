@@ -0,0 +1,219 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tilecache.h"
+
+#include <gutil/semaphore.h>
+
+#include <map>
+#include <list>
+#include <cstdlib>
+
+namespace gimage
+{
+
+namespace
+{
+
+struct TileEntry
+{
+  std::shared_ptr<const void> data;
+  long long mtime;
+  size_t size;
+  std::list<std::string>::iterator lru;
+};
+
+}
+
+struct TileCacheData
+{
+  TileCacheData() : mutex(1) { }
+
+  gutil::Semaphore mutex;
+
+  size_t capacity;
+  size_t cached;
+  unsigned long hits, misses;
+
+  std::map<std::string, TileEntry> entry;
+  std::list<std::string> lru; // most recently used first
+
+  void remove(std::map<std::string, TileEntry>::iterator it)
+  {
+    cached-=it->second.size;
+    lru.erase(it->second.lru);
+    entry.erase(it);
+  }
+
+  void shrink(size_t size)
+  {
+    while (cached > size && lru.size() > 0)
+    {
+      remove(entry.find(lru.back()));
+    }
+  }
+};
+
+TileCache::TileCache()
+{
+  p=new TileCacheData();
+
+  p->capacity=0;
+  p->cached=0;
+  p->hits=0;
+  p->misses=0;
+
+  const char *s=std::getenv("CVKIT_TILE_CACHE");
+
+  if (s != 0)
+  {
+    long mb=std::atol(s);
+
+    if (mb > 0)
+    {
+      p->capacity=static_cast<size_t>(mb)<<20;
+    }
+  }
+}
+
+TileCache::~TileCache()
+{
+  delete p;
+}
+
+std::shared_ptr<const void> TileCache::getEntry(const std::string &key, long long mtime)
+{
+  gutil::Lock lock(p->mutex);
+
+  std::map<std::string, TileEntry>::iterator it=p->entry.find(key);
+
+  if (it != p->entry.end())
+  {
+    if (it->second.mtime == mtime)
+    {
+      p->lru.splice(p->lru.begin(), p->lru, it->second.lru);
+      p->hits++;
+
+      return it->second.data;
+    }
+
+    // the file has been changed
+
+    p->remove(it);
+  }
+
+  p->misses++;
+
+  return std::shared_ptr<const void>();
+}
+
+void TileCache::putEntry(const std::string &key, long long mtime,
+                         const std::shared_ptr<const void> &data, size_t size)
+{
+  gutil::Lock lock(p->mutex);
+
+  std::map<std::string, TileEntry>::iterator it=p->entry.find(key);
+
+  if (it != p->entry.end())
+  {
+    p->remove(it);
+  }
+
+  if (size <= p->capacity)
+  {
+    p->shrink(p->capacity-size);
+
+    p->lru.push_front(key);
+
+    TileEntry &e=p->entry[key];
+
+    e.data=data;
+    e.mtime=mtime;
+    e.size=size;
+    e.lru=p->lru.begin();
+
+    p->cached+=size;
+  }
+}
+
+void TileCache::setCapacity(size_t bytes)
+{
+  gutil::Lock lock(p->mutex);
+
+  p->capacity=bytes;
+  p->shrink(p->capacity);
+}
+
+size_t TileCache::getCapacity() const
+{
+  gutil::Lock lock(p->mutex);
+  return p->capacity;
+}
+
+void TileCache::flush()
+{
+  gutil::Lock lock(p->mutex);
+  p->shrink(0);
+}
+
+TileCacheStatistics TileCache::getStatistics() const
+{
+  gutil::Lock lock(p->mutex);
+
+  TileCacheStatistics ret;
+
+  ret.hits=p->hits;
+  ret.misses=p->misses;
+  ret.cached=p->cached;
+
+  return ret;
+}
+
+void TileCache::resetStatistics()
+{
+  gutil::Lock lock(p->mutex);
+
+  p->hits=0;
+  p->misses=0;
+}
+
+TileCache &getTileCache()
+{
+  static TileCache *cache=new TileCache();
+  return *cache;
+}
+
+}
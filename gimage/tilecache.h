@@ -0,0 +1,154 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GIMAGE_TILECACHE_H
+#define GIMAGE_TILECACHE_H
+
+#include "image.h"
+
+#include <string>
+#include <memory>
+#include <typeinfo>
+#include <cstddef>
+
+namespace gimage
+{
+
+/**
+ * Statistics of a tile cache.
+ */
+
+struct TileCacheStatistics
+{
+  unsigned long hits;   /**< requests that were served from the cache */
+  unsigned long misses; /**< requests that required decoding the tile */
+  size_t cached;        /**< bytes of all tiles that are currently kept */
+};
+
+struct TileCacheData;
+
+/**
+ * Cache of decoded tiles of tiled images, which is used by ImageIO. Tiles
+ * are stored separately for each pixel type. If the capacity is exceeded,
+ * the least recently used tiles are removed. A tile is only returned if the
+ * modification time of its file did not change.
+ *
+ * The initial capacity is 0, i.e. nothing is cached, unless the environment
+ * variable CVKIT_TILE_CACHE defines the capacity in MB.
+ *
+ * Thread safety:
+ *
+ * All methods can be called concurrently.
+ */
+
+class TileCache
+{
+  public:
+
+    TileCache();
+    ~TileCache();
+
+    /**
+     * Returns the tile with the given file name or an empty pointer if the
+     * tile is not in the cache.
+     */
+
+    template<class T> std::shared_ptr<const Image<T> > get(const std::string &name,
+        long long mtime)
+    {
+      return std::static_pointer_cast<const Image<T> >(getEntry(getKey<T>(name), mtime));
+    }
+
+    /**
+     * Stores the tile with the given file name and the modification time of
+     * the file.
+     */
+
+    template<class T> void put(const std::string &name, long long mtime,
+                               const std::shared_ptr<const Image<T> > &tile)
+    {
+      putEntry(getKey<T>(name), mtime, tile, static_cast<size_t>(tile->getWidth())*
+               tile->getHeight()*tile->getDepth()*sizeof(T));
+    }
+
+    /**
+     * Sets the maximum number of bytes of all kept tiles. Tiles are removed
+     * if necessary.
+     */
+
+    void setCapacity(size_t bytes);
+    size_t getCapacity() const;
+
+    /**
+     * Removes all tiles.
+     */
+
+    void flush();
+
+    /**
+     * Returns the current statistics. Hits and misses are counted since
+     * creation or since the last call to resetStatistics().
+     */
+
+    TileCacheStatistics getStatistics() const;
+    void resetStatistics();
+
+  private:
+
+    TileCache(const TileCache &);
+    TileCache &operator=(const TileCache &);
+
+    template<class T> static std::string getKey(const std::string &name)
+    {
+      return std::string(typeid(T).name())+':'+name;
+    }
+
+    std::shared_ptr<const void> getEntry(const std::string &key, long long mtime);
+    void putEntry(const std::string &key, long long mtime,
+                  const std::shared_ptr<const void> &data, size_t size);
+
+    TileCacheData *p;
+};
+
+/**
+ * Returns the global tile cache that is used by ImageIO.
+ */
+
+TileCache &getTileCache();
+
+}
+
+#endif
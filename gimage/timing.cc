@@ -0,0 +1,122 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "timing.h"
+#include "bufferpool.h"
+
+#include <gutil/proctime.h>
+
+namespace gimage
+{
+
+namespace
+{
+
+thread_local TimingHook *thread_hook=0;
+thread_local int thread_depth=0;
+
+}
+
+void setTimingHook(TimingHook *hook)
+{
+  thread_hook=hook;
+}
+
+TimingHook *getTimingHook()
+{
+  return thread_hook;
+}
+
+Timing::Timing()
+{
+  active=false;
+  tstart=0;
+  bstart=0;
+}
+
+Timing::~Timing()
+{
+  // measurements that are not stopped, e.g. due to an exception, are dropped
+
+  if (active)
+  {
+    thread_depth--;
+  }
+}
+
+void Timing::start(const std::string &_operation, const std::string &_name)
+{
+  if (active)
+  {
+    thread_depth--;
+    active=false;
+  }
+
+  if (thread_hook != 0 && thread_depth == 0)
+  {
+    thread_depth++;
+    active=true;
+
+    operation=_operation;
+    name=_name;
+    tstart=gutil::ProcTime::monotonic();
+    bstart=BufferPool::getThreadAllocated();
+  }
+}
+
+void Timing::stop(double pixels)
+{
+  if (active)
+  {
+    TimingRecord rec;
+
+    rec.operation=operation;
+    rec.name=name;
+    rec.seconds=gutil::ProcTime::monotonic()-tstart;
+    rec.mpixel=pixels/1000000;
+    rec.bytes=BufferPool::getThreadAllocated()-bstart;
+
+    thread_depth--;
+    active=false;
+
+    if (thread_hook != 0)
+    {
+      thread_hook->record(rec);
+    }
+  }
+}
+
+}
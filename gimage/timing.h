@@ -0,0 +1,119 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef GIMAGE_TIMING_H
+#define GIMAGE_TIMING_H
+
+#include <string>
+#include <cstddef>
+
+namespace gimage
+{
+
+/**
+ * Measurement of one operation, e.g. loading, processing or saving an image.
+ */
+
+struct TimingRecord
+{
+  std::string operation; /**< e.g. load, save or name of the operation */
+  std::string name;      /**< file name or empty */
+  double seconds;        /**< wall time */
+  double mpixel;         /**< processed mega pixels */
+  size_t bytes;          /**< bytes that have been allocated for images */
+};
+
+/**
+ * Receiver of measurements.
+ */
+
+class TimingHook
+{
+  public:
+
+    virtual ~TimingHook() { }
+
+    virtual void record(const TimingRecord &rec)=0;
+};
+
+/**
+ * Sets the hook that receives the measurements of the calling thread. 0
+ * switches measuring off, which is the default. ImageIO reports loading and
+ * saving of images.
+ */
+
+void setTimingHook(TimingHook *hook);
+TimingHook *getTimingHook();
+
+/**
+ * Measures the wall time and the bytes that the calling thread allocates for
+ * images between start() and stop() and reports them to the hook of the
+ * thread. Measurements within another measurement are only contained in the
+ * outer one.
+ */
+
+class Timing
+{
+  public:
+
+    Timing();
+    ~Timing();
+
+    void start(const std::string &operation, const std::string &name=std::string());
+
+    /**
+     * Reports the measurement. Nothing happens if the measurement has not
+     * been started or has already been stopped.
+     *
+     * @param pixels Number of processed pixels.
+     */
+
+    void stop(double pixels);
+
+  private:
+
+    Timing(const Timing &);
+    Timing &operator=(const Timing &);
+
+    bool        active;
+    std::string operation, name;
+    double      tstart;
+    size_t      bstart;
+};
+
+}
+
+#endif
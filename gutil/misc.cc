@@ -187,6 +187,65 @@ void gutil::getFileList(std::set<std::string> &list, const std::string &prefix,
 #endif
 }
 
+long long gutil::getFileModificationTime(const char *name)
+{
+#ifdef __GNUC__
+  struct stat st;
+
+  if (stat(name, &st) != 0)
+  {
+    return -1;
+  }
+
+#if defined(__linux__)
+  return static_cast<long long>(st.st_mtim.tv_sec)*1000000000ll+st.st_mtim.tv_nsec;
+#else
+  return static_cast<long long>(st.st_mtime)*1000000000ll;
+#endif
+#elif defined(WIN32)
+  WIN32_FILE_ATTRIBUTE_DATA data;
+
+  if (!GetFileAttributesExA(name, GetFileExInfoStandard, &data))
+  {
+    return -1;
+  }
+
+  // file time is given in 100 ns since 1601-01-01
+
+  long long t=(static_cast<long long>(data.ftLastWriteTime.dwHighDateTime)<<32)|
+              data.ftLastWriteTime.dwLowDateTime;
+
+  return (t-116444736000000000ll)*100;
+#else
+  return -1;
+#endif
+}
+
+long long gutil::getFileSize(const char *name)
+{
+#ifdef __GNUC__
+  struct stat st;
+
+  if (stat(name, &st) != 0)
+  {
+    return -1;
+  }
+
+  return static_cast<long long>(st.st_size);
+#elif defined(WIN32)
+  WIN32_FILE_ATTRIBUTE_DATA data;
+
+  if (!GetFileAttributesExA(name, GetFileExInfoStandard, &data))
+  {
+    return -1;
+  }
+
+  return (static_cast<long long>(data.nFileSizeHigh)<<32)|data.nFileSizeLow;
+#else
+  return -1;
+#endif
+}
+
 bool gutil::syncFileByName(const char *name)
 {
   bool ret=false;
@@ -73,6 +73,20 @@ void split(std::vector<std::string> &list, const std::string &s, char delim=' ',
 
 void getFileList(std::set<std::string> &list, const std::string &prefix, const std::string &suffix);
 
+/**
+ * Returns the time of the last modification of the given file or directory
+ * in nanoseconds since the epoch or -1 if it does not exist. The resolution
+ * depends on the operating system and file system.
+ */
+
+long long getFileModificationTime(const char *name);
+
+/**
+ * Returns the size of the given file in bytes or -1 if it does not exist.
+ */
+
+long long getFileSize(const char *name);
+
 /**
  * Forces given file to be synchronized to the device.
  */
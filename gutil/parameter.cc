@@ -289,6 +289,19 @@ bool Parameter::isNextParameter()
   return ret;
 }
 
+bool Parameter::nextParameterIs(const std::string &p)
+{
+  if (isNextParameter() && list[pos] == p)
+  {
+    cparam=pos;
+    pos++;
+
+    return true;
+  }
+
+  return false;
+}
+
 void Parameter::nextParameter(std::string &p)
 {
   if (pos < list.size())
@@ -118,6 +118,15 @@ class Parameter
 
     void nextParameter(std::string &p);
 
+    /**
+     * Returns true and moves the read position behind the next value, if the
+     * next value is the given parameter. Otherwise, the read position is not
+     * changed. This permits handling combinations of parameters, e.g. a
+     * parameter that is directly followed by another one.
+     */
+
+    bool nextParameterIs(const std::string &p);
+
     /**
      * Searches the given parameter and sets the read position to the value
      * behind, for reading the arguments. If an empty std::string is given, then the
@@ -0,0 +1,80 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+/*
+ * Minimal support for test programs. A failed check prints the location and
+ * the condition. The program returns the number of failed checks.
+ */
+
+namespace
+{
+
+int check_failed=0;
+
+void checkResult(bool ok, const char *cond, const char *file, int line)
+{
+  if (!ok)
+  {
+    std::cerr << file << ":" << line << ": check failed: " << cond << std::endl;
+    check_failed++;
+  }
+}
+
+}
+
+#define CHECK(cond) checkResult((cond), #cond, __FILE__, __LINE__)
+
+/*
+ * Checks that the given statement throws an exception of the given type.
+ */
+
+#define CHECK_THROWS(stmt, ex) \
+  { \
+    bool thrown=false; \
+    try { stmt; } \
+    catch (const ex &) { thrown=true; } \
+    catch (...) { } \
+    checkResult(thrown, #stmt " throws " #ex, __FILE__, __LINE__); \
+  }
+
+#endif
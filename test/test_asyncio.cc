@@ -0,0 +1,201 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "check.h"
+
+#include <gimage/io.h>
+#include <gutil/thread.h>
+#include <gutil/semaphore.h>
+
+#include <stdexcept>
+
+/*
+ * Checks that asynchronous requests can be cancelled before they are
+ * started, that exceptions of failed requests are passed to the caller and
+ * that destroying the pool cancels waiting requests and finishes running
+ * ones.
+ */
+
+namespace
+{
+
+gutil::Semaphore started(0), gate(0);
+int loads=0;
+
+/*
+ * Loading ".blk" images signals the start and blocks until the gate is
+ * opened. Loading ".err" images fails.
+ */
+
+class BlockingImageIO : public gimage::BasicImageIO
+{
+  public:
+
+    BasicImageIO *create() const { return new BlockingImageIO(); }
+
+    bool handlesFile(const char *name, bool /* reading */) const
+    {
+      std::string s=name;
+      return s.size() > 4 && (s.compare(s.size()-4, 4, ".blk") == 0 ||
+                              s.compare(s.size()-4, 4, ".err") == 0);
+    }
+
+    void load(gimage::ImageU8 &image, const char *name, int /* ds */, long /* x */,
+              long /* y */, long /* w */, long /* h */) const
+    {
+      std::string s=name;
+
+      if (s.compare(s.size()-4, 4, ".err") == 0)
+      {
+        throw std::runtime_error("broken");
+      }
+
+      loads++;
+      started.increment();
+      gate.decrement();
+
+      image.setSize(1, 1, 1);
+    }
+};
+
+class DeleteFct : public gutil::ThreadFunction
+{
+  public:
+
+    gimage::ImageIO *io;
+
+    void run()
+    {
+      delete io;
+    }
+};
+
+}
+
+int main()
+{
+  // exceptions of failed requests are passed through the future
+
+  {
+    gimage::ImageIO io;
+    io.addBasicImageIO(BlockingImageIO());
+
+    gimage::ImageU8 image;
+    gimage::ImageFuture f=io.loadAsync(image, "x.err");
+
+    CHECK(f.valid());
+    CHECK_THROWS(f.get(), std::runtime_error);
+    CHECK(!f.valid());
+
+    f=io.loadAsync(image, "x.unknown");
+    f.wait();
+    CHECK(f.isReady());
+    CHECK_THROWS(f.get(), gutil::IOException);
+  }
+
+  // waiting requests can be cancelled, running requests cannot
+
+  {
+    gimage::ImageIO io;
+    io.addBasicImageIO(BlockingImageIO());
+    io.setAsyncThreads(1);
+
+    gimage::ImageU8 a, b, c;
+
+    loads=0;
+    gimage::ImageFuture fa=io.loadAsync(a, "a.blk");
+    started.decrement();
+
+    gimage::ImageFuture fb=io.loadAsync(b, "b.blk");
+
+    CHECK(!fa.cancel());
+    CHECK(fb.cancel());
+    CHECK(fb.isReady());
+    CHECK_THROWS(fb.get(), gutil::IOException);
+
+    // destroying a future cancels its waiting request
+
+    {
+      gimage::ImageFuture fc=io.loadAsync(c, "c.blk");
+    }
+
+    CHECK(!fa.isReady());
+    gate.increment();
+    fa.get();
+
+    CHECK(a.getWidth() == 1);
+    CHECK(b.getWidth() == 0);
+    CHECK(c.getWidth() == 0);
+    CHECK(loads == 1);
+  }
+
+  // destroying the pool finishes running requests and cancels waiting ones
+
+  {
+    gimage::ImageIO *io=new gimage::ImageIO();
+    io->addBasicImageIO(BlockingImageIO());
+    io->setAsyncThreads(1);
+
+    gimage::ImageU8 a, b;
+
+    loads=0;
+    gimage::ImageFuture fa=io->loadAsync(a, "a.blk");
+    started.decrement();
+
+    gimage::ImageFuture fb=io->loadAsync(b, "b.blk");
+
+    DeleteFct fct;
+    fct.io=io;
+
+    gutil::Thread thread;
+    thread.create(fct);
+
+    fb.wait();
+    CHECK_THROWS(fb.get(), gutil::IOException);
+
+    gate.increment();
+    thread.join();
+
+    CHECK(fa.isReady());
+    fa.get();
+
+    CHECK(a.getWidth() == 1);
+    CHECK(b.getWidth() == 0);
+    CHECK(loads == 1);
+  }
+
+  return check_failed;
+}
@@ -0,0 +1,297 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "check.h"
+
+#include <gimage/io.h>
+#include <gutil/exception.h>
+
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+
+/*
+ * Checks that images that are written in bands of rows and read back in
+ * bands of a different number of rows are identical to the original for
+ * all formats that implement reading or writing in bands, as well as for
+ * the default implementation and for tiled images.
+ */
+
+namespace
+{
+
+const long width=23, height=31;
+
+template<class T> void createImage(gimage::Image<T> &image, int depth, int scale)
+{
+  image.setSize(width, height, depth);
+
+  for (int d=0; d<depth; d++)
+  {
+    for (long k=0; k<height; k++)
+    {
+      for (long i=0; i<width; i++)
+      {
+        image.set(i, k, d, static_cast<T>(((i*7+k*13+d*29)%251)*scale));
+      }
+    }
+  }
+}
+
+template<class T> bool isEqual(const gimage::Image<T> &a, const gimage::Image<T> &b)
+{
+  if (a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight() ||
+      a.getDepth() != b.getDepth())
+  {
+    return false;
+  }
+
+  for (int d=0; d<a.getDepth(); d++)
+  {
+    for (long k=0; k<a.getHeight(); k++)
+    {
+      for (long i=0; i<a.getWidth(); i++)
+      {
+        if (a.get(i, k, d) != b.get(i, k, d))
+        {
+          return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+/*
+ * Writes the image in bands of wn rows.
+ */
+
+template<class T> void writeBands(const gimage::Image<T> &image, const std::string &name, long wn)
+{
+  std::unique_ptr<gimage::ImageWriter> writer(gimage::getImageIO().openWriter(name.c_str(),
+      image.getWidth(), image.getHeight(), image.getDepth()));
+
+  for (long k=0; k<image.getHeight(); k+=wn)
+  {
+    long n=std::min(wn, image.getHeight()-k);
+    gimage::Image<T> band(image.getWidth(), n, image.getDepth());
+
+    gimage::ImageView<T>(band).copyFrom(gimage::ImageView<const T>(image, 0, k,
+                                        image.getWidth(), n));
+
+    CHECK(writer->getRow() == k);
+    writer->write(band);
+  }
+
+  writer->close();
+}
+
+/*
+ * Reads the image in bands of rn rows.
+ */
+
+template<class T> void readBands(gimage::Image<T> &image, const std::string &name, long rn)
+{
+  std::unique_ptr<gimage::ImageReader> reader(gimage::getImageIO().openReader(name.c_str()));
+  gimage::Image<T> band;
+
+  image.setSize(reader->getWidth(), reader->getHeight(), reader->getDepth());
+
+  long k=0;
+
+  while (reader->read(band, rn))
+  {
+    CHECK(band.getWidth() == image.getWidth());
+    CHECK(band.getHeight() == std::min(rn, image.getHeight()-k));
+
+    gimage::ImageView<T>(image, 0, k, band.getWidth(), band.getHeight()).copyFrom(band);
+    k+=band.getHeight();
+
+    CHECK(reader->getRow() == k);
+  }
+
+  CHECK(k == image.getHeight());
+  CHECK(!reader->read(band, rn));
+}
+
+template<class T> void testRoundTrip(const std::string &name, int depth, int scale)
+{
+  gimage::Image<T> image, loaded;
+
+  createImage(image, depth, scale);
+
+  // written in bands and loaded at once
+
+  writeBands(image, name, 4);
+  gimage::getImageIO().load(loaded, name.c_str());
+
+  if (!isEqual(image, loaded))
+  {
+    std::cerr << "Round trip failed for " << name << std::endl;
+    check_failed++;
+  }
+
+  // written at once and read in bands, including bands that are larger
+  // than the image
+
+  gimage::getImageIO().save(image, name.c_str());
+
+  readBands(loaded, name, 5);
+  CHECK(isEqual(image, loaded));
+
+  readBands(loaded, name, 1);
+  CHECK(isEqual(image, loaded));
+
+  readBands(loaded, name, height+10);
+  CHECK(isEqual(image, loaded));
+
+  // written in bands and read in bands
+
+  writeBands(image, name, 7);
+  readBands(loaded, name, 3);
+  CHECK(isEqual(image, loaded));
+}
+
+void testWriterErrors(const std::string &name)
+{
+  gimage::ImageU8 image;
+  createImage(image, 1, 1);
+
+  std::unique_ptr<gimage::ImageWriter> writer(gimage::getImageIO().openWriter(name.c_str(),
+      width, height, 1));
+
+  // bands must have the width and depth of the image and the same type
+
+  CHECK_THROWS(writer->write(gimage::ImageU8(width+1, 2, 1)), gutil::IOException);
+  CHECK_THROWS(writer->write(gimage::ImageU8(width, 2, 3)), gutil::IOException);
+  CHECK(writer->getRow() == 0);
+
+  writer->write(gimage::ImageU8(width, 2, 1));
+  CHECK_THROWS(writer->write(gimage::ImageU16(width, 2, 1)), gutil::IOException);
+
+  // the image cannot be finished before all rows have been written and
+  // rows cannot be written beyond the image
+
+  CHECK_THROWS(writer->close(), gutil::IOException);
+  CHECK_THROWS(writer->write(gimage::ImageU8(width, height, 1)), gutil::IOException);
+
+  writer->write(gimage::ImageU8(width, height-2, 1));
+  writer->close();
+
+  CHECK_THROWS(writer->write(gimage::ImageU8(width, 1, 1)), gutil::IOException);
+}
+
+void testTiled(const std::string &tmp)
+{
+  gimage::ImageU8 image, tile, loaded;
+  createImage(image, 1, 1);
+
+  // 2x2 tiles that cover the image
+
+  const long tw=(width+1)/2, th=(height+1)/2;
+
+  for (int row=0; row<2; row++)
+  {
+    for (int col=0; col<2; col++)
+    {
+      char name[32];
+      std::snprintf(name, sizeof(name), "/t_%02d_%02d_a.pgm", row, col);
+
+      tile.setSize(tw, th, 1);
+      tile.clear();
+
+      long w=std::min(tw, width-col*tw);
+      long h=std::min(th, height-row*th);
+
+      gimage::ImageView<gimage::ImageU8::store_t>(tile, 0, 0, w, h).copyFrom(
+        gimage::ImageView<const gimage::ImageU8::store_t>(image, col*tw, row*th, w, h));
+
+      gimage::getImageIO().save(tile, (tmp+name).c_str());
+    }
+  }
+
+  readBands(loaded, tmp+"/t:a.pgm", 5);
+
+  CHECK(loaded.getWidth() == 2*tw && loaded.getHeight() == 2*th);
+
+  gimage::ImageU8 part(width, height, 1);
+  gimage::ImageView<gimage::ImageU8::store_t>(part).copyFrom(
+    gimage::ImageView<const gimage::ImageU8::store_t>(loaded, 0, 0, width, height));
+
+  CHECK(isEqual(image, part));
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: test_bandio <tmp-dir>" << std::endl;
+    return 1;
+  }
+
+  std::string tmp=argv[1];
+
+  testRoundTrip<gimage::ImageU8::store_t>(tmp+"/u8.pgm", 1, 1);
+  testRoundTrip<gimage::ImageU16::store_t>(tmp+"/u16.pgm", 1, 257);
+  testRoundTrip<gimage::ImageU8::store_t>(tmp+"/rgb.ppm", 3, 1);
+  testRoundTrip<float>(tmp+"/f.pfm", 1, 1);
+  testRoundTrip<float>(tmp+"/rgb.pfm", 3, 1);
+  testRoundTrip<gimage::ImageU8::store_t>(tmp+"/u8.raw", 1, 1);
+  testRoundTrip<gimage::ImageU16::store_t>(tmp+"/u16.raw", 1, 257);
+
+  if (gimage::getImageIO().handlesFile("test.png", false))
+  {
+    testRoundTrip<gimage::ImageU8::store_t>(tmp+"/rgb.png", 3, 1);
+    testRoundTrip<gimage::ImageU16::store_t>(tmp+"/u16.png", 1, 257);
+  }
+
+  // CVZ uses the default implementation, which loads parts and saves all
+  // collected bands at once
+
+  if (gimage::getImageIO().handlesFile("test.cvz", false))
+  {
+    testRoundTrip<gimage::ImageU16::store_t>(tmp+"/u16.cvz", 1, 257);
+    testRoundTrip<float>(tmp+"/f.cvz", 2, 1);
+  }
+
+  testWriterErrors(tmp+"/err.pgm");
+  testTiled(tmp);
+
+  return check_failed;
+}
@@ -0,0 +1,136 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "check.h"
+
+#include <gimage/image.h>
+#include <gimage/bufferpool.h>
+
+#include <new>
+#include <limits>
+
+/*
+ * Checks reuse and eviction of buffers in the buffer pool and the rejection
+ * of image sizes that are negative or would overflow.
+ */
+
+int main()
+{
+  // released buffers are reused for requests of the same bucket
+
+  {
+    gimage::BufferPool pool;
+    pool.setCapacity(1<<20);
+
+    void *a=pool.allocate(1000);
+    CHECK(reinterpret_cast<size_t>(a)%64 == 0);
+
+    pool.release(a);
+    CHECK(pool.getStatistics().cached == 1024);
+
+    void *b=pool.allocate(1010);
+    CHECK(b == a);
+
+    gimage::BufferPoolStatistics st=pool.getStatistics();
+    CHECK(st.hits == 1 && st.misses == 1);
+    CHECK(st.used == 1024 && st.cached == 0);
+
+    pool.release(b);
+  }
+
+  // buffers that exceed the capacity are freed, reducing the capacity evicts
+  // kept buffers
+
+  {
+    gimage::BufferPool pool;
+    pool.setCapacity(2048);
+
+    void *a=pool.allocate(1000);
+    void *b=pool.allocate(5000);
+
+    pool.release(a);
+    pool.release(b);
+    CHECK(pool.getStatistics().cached == 1024);
+
+    pool.setCapacity(0);
+    CHECK(pool.getStatistics().cached == 0);
+
+    a=pool.allocate(1000);
+    CHECK(pool.getStatistics().misses == 3);
+    pool.release(a);
+    CHECK(pool.getStatistics().cached == 0);
+  }
+
+  // pixels of released images are reused by the global pool
+
+  {
+    gimage::BufferPool &pool=gimage::getBufferPool();
+    pool.setCapacity(1<<20);
+    pool.resetStatistics();
+
+    {
+      gimage::ImageU8 image(100, 100, 1);
+    }
+
+    gimage::ImageU8 image(100, 100, 1);
+
+    gimage::BufferPoolStatistics st=pool.getStatistics();
+    CHECK(st.hits == 1 && st.misses == 1);
+
+    pool.setCapacity(0);
+  }
+
+  // negative sizes and sizes that overflow are rejected without changing
+  // the image
+
+  {
+    const long large=std::numeric_limits<long>::max()/2;
+
+    gimage::ImageU16 image(10, 10, 1);
+
+    CHECK_THROWS(image.setSize(-1, 10, 1), std::bad_alloc);
+    CHECK_THROWS(image.setSize(large, large, 1), std::bad_alloc);
+    CHECK_THROWS(image.setSize(large, 2, 3), std::bad_alloc);
+    CHECK(image.getWidth() == 10 && image.getHeight() == 10 && image.getDepth() == 1);
+
+    CHECK_THROWS(gimage::ImageFloat(large, large, 3), std::bad_alloc);
+
+    gimage::BufferPool pool;
+    CHECK_THROWS(pool.allocate(std::numeric_limits<size_t>::max()-16), std::bad_alloc);
+  }
+
+  return check_failed;
+}
@@ -0,0 +1,293 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "check.h"
+
+#include <gimage/cvz_io.h>
+#include <gutil/exception.h>
+
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <vector>
+
+/*
+ * Checks that CVZ and CVT images are read back losslessly and that files
+ * with corrupted headers, tile tables or tile data are rejected with an
+ * IOException.
+ */
+
+namespace
+{
+
+const long width=40, height=30, tile=16;
+const long ntiles=3*2;
+
+std::vector<char> readFile(const std::string &name)
+{
+  std::ifstream in(name.c_str(), std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string &name, const std::vector<char> &data)
+{
+  std::ofstream out(name.c_str(), std::ios::binary);
+  out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+void setU32(std::vector<char> &data, size_t pos, unsigned long v)
+{
+  for (int i=0; i<4; i++)
+  {
+    data[pos+i]=static_cast<char>((v>>(8*i))&0xff);
+  }
+}
+
+void setU64(std::vector<char> &data, size_t pos, unsigned long long v)
+{
+  for (int i=0; i<8; i++)
+  {
+    data[pos+i]=static_cast<char>((v>>(8*i))&0xff);
+  }
+}
+
+unsigned long long getU64(const std::vector<char> &data, size_t pos)
+{
+  unsigned long long ret=0;
+
+  for (int i=7; i>=0; i--)
+  {
+    ret=(ret<<8)|static_cast<unsigned char>(data[pos+i]);
+  }
+
+  return ret;
+}
+
+/*
+ * Returns true if loading the given file throws an IOException.
+ */
+
+bool isRejected(const gimage::CVZImageIO &io, const std::string &name)
+{
+  gimage::ImageU16 image;
+
+  try
+  {
+    io.load(image, name.c_str());
+  }
+  catch (const gutil::IOException &)
+  {
+    return true;
+  }
+
+  return false;
+}
+
+/*
+ * Writes a modified copy of the given file and checks that it is rejected.
+ */
+
+bool isRejected(const gimage::CVZImageIO &io, const std::string &name,
+                const std::vector<char> &data)
+{
+  writeFile(name, data);
+  return isRejected(io, name);
+}
+
+void testCVZ(const std::string &tmp)
+{
+  gimage::CVZImageIO io(1, tile);
+  gimage::ImageU16 image(width, height, 1);
+
+  for (long k=0; k<height; k++)
+  {
+    for (long i=0; i<width; i++)
+    {
+      image.set(i, k, 0, static_cast<gimage::ImageU16::store_t>(1000+7*i+k*k));
+    }
+  }
+
+  // valid file
+
+  std::string name=tmp+"/valid.cvz";
+  io.save(image, name.c_str());
+
+  gimage::ImageU16 loaded;
+  io.load(loaded, name.c_str());
+
+  CHECK(loaded.getWidth() == width && loaded.getHeight() == height);
+  CHECK(loaded.getPtr(0, 0, 0) != 0 &&
+        std::equal(image.getPtr(0, 0, 0), image.getPtr(0, 0, 0)+width*height,
+                   loaded.getPtr(0, 0, 0)));
+
+  io.load(loaded, name.c_str(), 1, 10, 20, 15, 5);
+  CHECK(loaded.getWidth() == 15 && loaded.getHeight() == 5);
+  CHECK(loaded.get(0, 0, 0) == image.get(10, 20, 0));
+  CHECK(loaded.get(14, 4, 0) == image.get(24, 24, 0));
+
+  const std::vector<char> valid=readFile(name);
+  const size_t table=24, data=table+8*(ntiles+1);
+
+  CHECK(valid.size() > data);
+  CHECK(getU64(valid, table) == data);
+  CHECK(getU64(valid, table+8*ntiles) == valid.size());
+
+  std::string corrupt=tmp+"/corrupt.cvz";
+  std::vector<char> v;
+
+  // corrupted header
+
+  v=valid;
+  v[0]='X';
+  CHECK(isRejected(io, corrupt, v));
+
+  v=valid;
+  setU32(v, 4, 3);
+  CHECK(isRejected(io, corrupt, v));
+
+  v=valid;
+  setU32(v, 8, 0);
+  CHECK(isRejected(io, corrupt, v));
+
+  v=valid;
+  setU32(v, 20, 0);
+  CHECK(isRejected(io, corrupt, v));
+
+  // a huge image size cannot be contained in the file
+
+  v=valid;
+  setU32(v, 12, 0x7fffffff);
+  setU32(v, 16, 0x7fffffff);
+  CHECK(isRejected(io, corrupt, v));
+
+  v=valid;
+  setU32(v, 12, 0xffffffff);
+  CHECK(isRejected(io, corrupt, v));
+
+  // truncated files
+
+  v.assign(valid.begin(), valid.begin()+10);
+  CHECK(isRejected(io, corrupt, v));
+
+  v.assign(valid.begin(), valid.begin()+table+20);
+  CHECK(isRejected(io, corrupt, v));
+
+  v.assign(valid.begin(), valid.begin()+(data+valid.size())/2);
+  CHECK(isRejected(io, corrupt, v));
+
+  v.assign(valid.begin(), valid.end()-1);
+  CHECK(isRejected(io, corrupt, v));
+
+  // tile offsets that point into the header or table, behind the end of the
+  // file or backwards
+
+  v=valid;
+  setU64(v, table, 0);
+  CHECK(isRejected(io, corrupt, v));
+
+  v=valid;
+  setU64(v, table, table);
+  CHECK(isRejected(io, corrupt, v));
+
+  v=valid;
+  setU64(v, table+8*ntiles, valid.size()+1);
+  CHECK(isRejected(io, corrupt, v));
+
+  v=valid;
+  setU64(v, table+8*ntiles, 0xffffffffffffffffull);
+  CHECK(isRejected(io, corrupt, v));
+
+  v=valid;
+  setU64(v, table+8, getU64(valid, table)-1);
+  CHECK(isRejected(io, corrupt, v));
+
+  // corrupted tile data
+
+  v=valid;
+
+  for (size_t i=data; i<getU64(valid, table+8); i++)
+  {
+    v[i]=0;
+  }
+
+  CHECK(isRejected(io, corrupt, v));
+
+  // tiles that are not needed for loading a part are not read
+
+  io.load(loaded, corrupt.c_str(), 1, 20, 20, 20, 10);
+  CHECK(loaded.get(0, 0, 0) == image.get(20, 20, 0));
+
+  // CVT file with more levels than needed for the last level to fit into
+  // one tile
+
+  name=tmp+"/valid.cvt";
+  io.save(image, name.c_str());
+
+  io.load(loaded, name.c_str());
+  CHECK(loaded.getWidth() == width && loaded.getHeight() == height);
+  CHECK(loaded.get(39, 29, 0) == image.get(39, 29, 0));
+
+  const std::vector<char> cvt=readFile(name);
+
+  corrupt=tmp+"/corrupt.cvt";
+
+  v=cvt;
+  setU32(v, 24, 0);
+  CHECK(isRejected(io, corrupt, v));
+
+  v=cvt;
+  setU32(v, 24, 20);
+  CHECK(isRejected(io, corrupt, v));
+
+  v=cvt;
+  setU32(v, 24, 0x7fffffff);
+  CHECK(isRejected(io, corrupt, v));
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: test_cvz <tmp-dir>" << std::endl;
+    return 1;
+  }
+
+  testCVZ(argv[1]);
+
+  return check_failed;
+}
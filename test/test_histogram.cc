@@ -0,0 +1,252 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "check.h"
+
+#include <gimage/analysis.h>
+#include <gutil/thread.h>
+
+#include <vector>
+#include <limits>
+
+/*
+ * Checks that histograms that are counted in parallel are equal to
+ * histograms that are counted in one thread and to a simple reference
+ * count.
+ */
+
+namespace
+{
+
+unsigned long rnd()
+{
+  static unsigned long s=12345;
+  s=s*1103515245+12345;
+  return (s>>16)&0x7fff;
+}
+
+bool equal(const gimage::Histogram &a, const gimage::Histogram &b)
+{
+  if (a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight())
+  {
+    return false;
+  }
+
+  for (int k=0; k<a.getHeight(); k++)
+  {
+    for (int i=0; i<a.getWidth(); i++)
+    {
+      if (a(i, k) != b(i, k))
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/*
+ * Counts into the given histogram with four threads that process
+ * interleaved rows, like gutil::runParallel() on a machine with four
+ * processing units.
+ */
+
+template<class T, class B> void countParallel(gimage::Histogram &hist,
+    const gimage::Image<T> &image1, const gimage::Image<T> *image2, const B &b1, const B &b2)
+{
+  gimage::HistogramFct<T, B> fct(&hist(0, 0), image1, image2, b1, b2);
+  gutil::Thread thread[4];
+
+  hist.clear();
+
+  for (int i=0; i<4; i++)
+  {
+    thread[i].create(fct, i, image1.getHeight()-1, 4);
+  }
+
+  for (int i=0; i<4; i++)
+  {
+    thread[i].join();
+  }
+}
+
+}
+
+int main()
+{
+  // histograms of the constructors are counted in one thread
+
+  gutil::Thread::setMaxThreads(1);
+
+  // images must be large enough for counting in parallel
+
+  const long w=701, h=503;
+
+  // 1D histogram of a 16 bit image with bins of size 4
+
+  {
+    gimage::ImageU16 image(w, h, 1);
+
+    for (long k=0; k<h; k++)
+      for (long i=0; i<w; i++)
+      {
+        image.set(i, k, 0, static_cast<gutil::uint16>(rnd()%3000));
+      }
+
+    gimage::Histogram serial(image, 4);
+    gimage::Histogram parallel(serial.getWidth(), 1, 4);
+    countParallel(parallel, image, static_cast<const gimage::ImageU16 *>(0),
+                  gimage::HistogramBins<gutil::uint16>(serial.getWidth(), 4),
+                  gimage::HistogramBins<gutil::uint16>(1, 4));
+
+    gimage::Histogram ref(serial.getWidth(), 1, 4);
+
+    for (long k=0; k<h; k++)
+      for (long i=0; i<w; i++)
+      {
+        ref(image.get(i, k)/4)++;
+      }
+
+    CHECK(equal(serial, ref));
+    CHECK(equal(parallel, ref));
+    CHECK(parallel.sumAll() == static_cast<unsigned long>(w*h));
+  }
+
+  // 1D histogram of a color image
+
+  {
+    gimage::ImageU8 image(w, h, 3);
+
+    for (int j=0; j<3; j++)
+      for (long k=0; k<h; k++)
+        for (long i=0; i<w; i++)
+        {
+          image.set(i, k, j, static_cast<gutil::uint8>(rnd()));
+        }
+
+    gimage::Histogram serial(image);
+    gimage::Histogram parallel(256);
+    countParallel(parallel, image, static_cast<const gimage::ImageU8 *>(0),
+                  gimage::HistogramBins<gutil::uint8>(256, 1),
+                  gimage::HistogramBins<gutil::uint8>(1, 1));
+
+    gimage::Histogram ref(256);
+
+    for (int j=0; j<3; j++)
+      for (long k=0; k<h; k++)
+        for (long i=0; i<w; i++)
+        {
+          ref(image.get(i, k, j))++;
+        }
+
+    CHECK(equal(serial, ref));
+    CHECK(equal(parallel, ref));
+  }
+
+  // histogram of a float image over a range, with invalid pixels and values
+  // outside the range
+
+  {
+    gimage::ImageFloat image(w, h, 1);
+
+    for (long k=0; k<h; k++)
+      for (long i=0; i<w; i++)
+      {
+        float v=static_cast<float>(rnd())/100-20;
+
+        if (rnd()%50 == 0)
+        {
+          v=std::numeric_limits<float>::infinity();
+        }
+
+        image.set(i, k, 0, v);
+      }
+
+    gimage::Histogram serial(image, 0.0, 300.0, 100);
+    gimage::Histogram parallel(100);
+    countParallel(parallel, image, static_cast<const gimage::ImageFloat *>(0),
+                  gimage::HistogramRange<float>(100, 0, 300), gimage::HistogramRange<float>(1, 0, 1));
+
+    gimage::Histogram ref(100);
+
+    for (long k=0; k<h; k++)
+      for (long i=0; i<w; i++)
+      {
+        const float v=image.get(i, k);
+        const double f=(v-0.0)*(100/300.0);
+
+        if (image.isValidS(v) && f >= 0 && f <= 100)
+        {
+          ref(std::min(static_cast<int>(f), 99))++;
+        }
+      }
+
+    CHECK(equal(serial, ref));
+    CHECK(equal(parallel, ref));
+  }
+
+  // 2D correspondence histogram
+
+  {
+    gimage::ImageU8 image1(w, h, 1), image2(w, h, 1);
+
+    for (long k=0; k<h; k++)
+      for (long i=0; i<w; i++)
+      {
+        image1.set(i, k, 0, static_cast<gutil::uint8>(rnd()));
+        image2.set(i, k, 0, static_cast<gutil::uint8>((image1.get(i, k)+rnd()%16)&0xff));
+      }
+
+    gimage::Histogram serial(image1, image2, 2);
+    gimage::Histogram parallel(128, 128, 2);
+    countParallel(parallel, image1, &image2, gimage::HistogramBins<gutil::uint8>(128, 2),
+                  gimage::HistogramBins<gutil::uint8>(128, 2));
+
+    gimage::Histogram ref(128, 128, 2);
+
+    for (long k=0; k<h; k++)
+      for (long i=0; i<w; i++)
+      {
+        ref(image1.get(i, k)/2, image2.get(i, k)/2)++;
+      }
+
+    CHECK(equal(serial, ref));
+    CHECK(equal(parallel, ref));
+  }
+
+  return check_failed;
+}
@@ -0,0 +1,169 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "check.h"
+
+#include <gimage/io.h>
+
+#include <fstream>
+#include <cstdio>
+
+/*
+ * Checks that cached headers of images are re-read if the image has been
+ * changed or removed, that names without files are never cached and that
+ * the least recently used entries are evicted.
+ */
+
+namespace
+{
+
+int calls=0;
+
+class CountingImageIO : public gimage::BasicImageIO
+{
+  public:
+
+    BasicImageIO *create() const { return new CountingImageIO(); }
+
+    bool handlesFile(const char *name, bool /* reading */) const
+    {
+      std::string s=name;
+      return s.size() > 4 && s.compare(s.size()-4, 4, ".tst") == 0;
+    }
+
+    void loadHeader(const char * /* name */, long &width, long &height, int &depth) const
+    {
+      calls++;
+
+      width=calls;
+      height=1;
+      depth=1;
+    }
+};
+
+void writeFile(const std::string &name, const char *content)
+{
+  std::ofstream out(name.c_str());
+  out << content;
+}
+
+long loadWidth(const std::string &name)
+{
+  long w, h;
+  int d;
+
+  gimage::getImageIO().loadHeader(name.c_str(), w, h, d);
+
+  return w;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: test_imageinfo <tmp-dir>" << std::endl;
+    return 1;
+  }
+
+  const std::string dir=argv[1];
+
+  gimage::getImageIO().addBasicImageIO(CountingImageIO());
+
+  // unchanged files are read once, changed files again
+
+  const std::string a=dir+"/a.tst";
+  writeFile(a, "a");
+
+  calls=0;
+  loadWidth(a);
+  loadWidth(a);
+  CHECK(calls == 1);
+
+  writeFile(a, "changed");
+  CHECK(loadWidth(a) == 2);
+  CHECK(calls == 2);
+
+  // removed files and names without files are read every time
+
+  std::remove(a.c_str());
+  calls=0;
+  loadWidth(a);
+  loadWidth(a);
+  CHECK(calls == 2);
+
+  calls=0;
+  loadWidth(dir+"/missing.tst");
+  loadWidth(dir+"/missing.tst");
+  CHECK(calls == 2);
+
+  // the least recently used entry is evicted
+
+  const std::string f[3]={dir+"/f0.tst", dir+"/f1.tst", dir+"/f2.tst"};
+
+  for (int i=0; i<3; i++)
+  {
+    writeFile(f[i], "f");
+  }
+
+  gimage::clearImageInfoCache();
+  gimage::setImageInfoCacheCapacity(2);
+
+  calls=0;
+  loadWidth(f[0]);
+  loadWidth(f[1]);
+  loadWidth(f[0]);
+  loadWidth(f[2]);
+  CHECK(calls == 3);
+
+  loadWidth(f[0]);
+  CHECK(calls == 3);
+
+  loadWidth(f[1]);
+  CHECK(calls == 4);
+
+  // capacity 0 disables caching
+
+  gimage::setImageInfoCacheCapacity(0);
+
+  calls=0;
+  loadWidth(f[0]);
+  loadWidth(f[0]);
+  CHECK(calls == 2);
+
+  return check_failed;
+}
@@ -0,0 +1,88 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "check.h"
+
+#include <gimage/image.h>
+
+#include <stdexcept>
+
+/*
+ * Checks read-only views of const images and the size check of copying
+ * between views.
+ */
+
+int main()
+{
+  gimage::ImageU8 image(4, 3, 3);
+
+  for (int j=0; j<3; j++)
+    for (long k=0; k<3; k++)
+      for (long i=0; i<4; i++)
+      {
+        image.set(i, k, j, static_cast<gutil::uint8>(100*j+10*k+i));
+      }
+
+  // read-only views of const images and conversion of views
+
+  const gimage::ImageU8 &cimage=image;
+
+  gimage::ImageView<const gutil::uint8> cview(cimage, 1, 1, 2, 2);
+  CHECK(cview.get(0, 0, 2) == 211);
+
+  gimage::ImageView<gutil::uint8> view(image);
+  gimage::ImageView<const gutil::uint8> rview(view);
+  CHECK(rview.getPtr(0, 0, 0) == view.getPtr(0, 0, 0));
+
+  gimage::ImageU8 copy;
+  copy.setImage(cview.channel(1));
+  CHECK(copy.getWidth() == 2 && copy.getHeight() == 2 && copy.getDepth() == 1);
+  CHECK(copy.get(1, 1, 0) == 122);
+
+  // copying requires the same size and depth
+
+  gimage::ImageU8 target(2, 2, 1);
+  gimage::ImageView<gutil::uint8> tview(target);
+
+  tview.copyFrom(cview.channel(0));
+  CHECK(target.get(1, 0, 0) == 12);
+
+  CHECK_THROWS(tview.copyFrom(cview), std::runtime_error);
+  CHECK_THROWS(tview.copyFrom(gimage::ImageView<const gutil::uint8>(cimage)),
+               std::runtime_error);
+
+  return check_failed;
+}
@@ -0,0 +1,125 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "check.h"
+
+#include <gimage/mapped.h>
+#include <gutil/misc.h>
+
+#include <fstream>
+#include <stdexcept>
+
+/*
+ * Checks mapping of PGM images with read only and copy on write access.
+ */
+
+namespace
+{
+
+void writePGM(const std::string &name, int maxval, int bytes)
+{
+  std::ofstream out(name.c_str(), std::ios::binary);
+
+  out << "P5\n4 2\n" << maxval << "\n";
+
+  for (int i=0; i<8*bytes; i++)
+  {
+    out.put(static_cast<char>(i));
+  }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: test_mapped <tmp-dir>" << std::endl;
+    return 1;
+  }
+
+  const std::string dir=argv[1];
+  const std::string name8=dir+"/m8.pgm";
+  const std::string name16=dir+"/m16.pgm";
+
+  writePGM(name8, 255, 1);
+  writePGM(name16, 65535, 2);
+
+  // read only mappings are only accessible through a read-only view
+
+  {
+    gimage::MappedImageU8 image;
+    gimage::mapImage(image, name8.c_str());
+
+    gimage::ImageView<const gutil::uint8> view=image.getImage();
+
+    CHECK(view.getWidth() == 4 && view.getHeight() == 2 && view.getDepth() == 1);
+    CHECK(view.get(1, 1) == 5);
+    CHECK_THROWS(image.getWritableImage(), std::runtime_error);
+  }
+
+  // changes of copy on write mappings do not reach the file
+
+  {
+    gimage::MappedImageU8 image;
+    gimage::mapImage(image, name8.c_str(), gimage::map_copy_on_write);
+
+    image.getWritableImage().set(1, 1, 0, 200);
+    CHECK(image.getImage().get(1, 1) == 200);
+
+    gimage::MappedImageU8 other;
+    gimage::mapImage(other, name8.c_str());
+    CHECK(other.getImage().get(1, 1) == 5);
+  }
+
+  // 16 bit PGM images are big endian and can only be mapped on such hosts
+
+  {
+    gimage::MappedImageU16 image;
+
+    if (gutil::isMSBFirst())
+    {
+      gimage::mapImage(image, name16.c_str());
+      CHECK(image.getImage().get(1, 0) == 0x0203);
+    }
+    else
+    {
+      CHECK_THROWS(gimage::mapImage(image, name16.c_str()), gutil::IOException);
+    }
+  }
+
+  return check_failed;
+}
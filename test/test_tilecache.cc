@@ -0,0 +1,276 @@
+/*
+ * This file is part of the Computer Vision Toolkit (cvkit).
+ *
+ * Author: Heiko Hirschmueller
+ *
+ * Copyright (c) 2016 Roboception GmbH
+ * Copyright (c) 2014 Institute of Robotics and Mechatronics, German Aerospace Center
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "check.h"
+
+#include <gimage/io.h>
+#include <gimage/tilecache.h>
+
+#include <utime.h>
+#include <cstdio>
+
+/*
+ * Checks that the tile cache only returns tiles with unchanged modification
+ * time and evicts the least recently used tiles, and that tiled images are
+ * re-read if tiles are changed, removed or added.
+ */
+
+namespace
+{
+
+const long tw=4, th=3;
+
+/*
+ * Sets the modification time of a file or directory explicitly, so that a
+ * change is detected independent of the resolution of the file system.
+ */
+
+void setModificationTime(const std::string &name, time_t t)
+{
+  struct utimbuf ut;
+
+  ut.actime=t;
+  ut.modtime=t;
+
+  utime(name.c_str(), &ut);
+}
+
+void writeTile(const std::string &dir, int row, int col, int value, time_t t)
+{
+  gimage::ImageU8 image(tw, th, 1);
+
+  for (long k=0; k<th; k++)
+  {
+    for (long i=0; i<tw; i++)
+    {
+      image.set(i, k, 0, static_cast<gimage::ImageU8::store_t>(value+k*tw+i));
+    }
+  }
+
+  char name[32];
+  std::snprintf(name, sizeof(name), "/t_%02d_%02d_a.pgm", row, col);
+
+  gimage::getImageIO().save(image, (dir+name).c_str());
+  setModificationTime(dir+name, t);
+}
+
+/*
+ * Checks that the tile at the given row and column has been loaded with the
+ * given value or is missing if value is 0.
+ */
+
+bool checkTile(const gimage::ImageU8 &image, int row, int col, int value)
+{
+  for (long k=0; k<th; k++)
+  {
+    for (long i=0; i<tw; i++)
+    {
+      int v=image.get(col*tw+i, row*th+k, 0);
+
+      if ((value == 0 && v != 0) || (value != 0 && v != value+k*tw+i))
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+void testTileCache()
+{
+  gimage::TileCache cache;
+  std::shared_ptr<gimage::ImageU8> tile(new gimage::ImageU8(tw, th, 1));
+  size_t size=static_cast<size_t>(tw*th);
+
+  CHECK(cache.getCapacity() == 0);
+
+  // nothing is kept without capacity
+
+  cache.put<gimage::ImageU8::store_t>("a", 1, tile);
+  CHECK(!cache.get<gimage::ImageU8::store_t>("a", 1));
+
+  // tiles are only returned for the same modification time and pixel type
+
+  cache.setCapacity(2*size);
+  cache.resetStatistics();
+
+  cache.put<gimage::ImageU8::store_t>("a", 1, tile);
+  CHECK(cache.get<gimage::ImageU8::store_t>("a", 1) == tile);
+  CHECK(!cache.get<float>("a", 1));
+  CHECK(!cache.get<gimage::ImageU8::store_t>("a", 2));
+  CHECK(!cache.get<gimage::ImageU8::store_t>("a", 1));
+
+  gimage::TileCacheStatistics stat=cache.getStatistics();
+  CHECK(stat.hits == 1);
+  CHECK(stat.misses == 3);
+  CHECK(stat.cached == 0);
+
+  // the least recently used tile is evicted
+
+  cache.put<gimage::ImageU8::store_t>("a", 1, tile);
+  cache.put<gimage::ImageU8::store_t>("b", 1, tile);
+  CHECK(cache.get<gimage::ImageU8::store_t>("a", 1) == tile);
+
+  cache.put<gimage::ImageU8::store_t>("c", 1, tile);
+  CHECK(cache.getStatistics().cached == 2*size);
+  CHECK(!cache.get<gimage::ImageU8::store_t>("b", 1));
+  CHECK(cache.get<gimage::ImageU8::store_t>("a", 1) == tile);
+  CHECK(cache.get<gimage::ImageU8::store_t>("c", 1) == tile);
+
+  // reducing the capacity and flushing removes tiles
+
+  cache.setCapacity(size);
+  CHECK(cache.getStatistics().cached == size);
+  CHECK(cache.get<gimage::ImageU8::store_t>("c", 1) == tile);
+
+  cache.flush();
+  CHECK(cache.getStatistics().cached == 0);
+  CHECK(!cache.get<gimage::ImageU8::store_t>("c", 1));
+}
+
+void testTiledImage(const std::string &tmp)
+{
+  const std::string &dir=tmp;
+  std::string name=dir+"/t:a.pgm";
+
+  for (int row=0; row<2; row++)
+  {
+    for (int col=0; col<2; col++)
+    {
+      std::remove((dir+"/t_0"+static_cast<char>('0'+row)+"_0"+
+                   static_cast<char>('0'+col)+"_a.pgm").c_str());
+    }
+  }
+
+  gimage::TileCache &cache=gimage::getTileCache();
+  size_t capacity=cache.getCapacity();
+
+  gimage::clearTileIndexCache();
+  cache.flush();
+  cache.setCapacity(1<<20);
+  cache.resetStatistics();
+
+  // initial grid of 2x2 tiles with the tile at row 1 and column 1 missing
+
+  writeTile(dir, 0, 0, 10, 1000);
+  writeTile(dir, 0, 1, 30, 1000);
+  writeTile(dir, 1, 0, 50, 1000);
+  setModificationTime(dir, 1000);
+
+  gimage::ImageU8 image;
+
+  gimage::getImageIO().load(image, name.c_str());
+
+  CHECK(image.getWidth() == 2*tw);
+  CHECK(image.getHeight() == 2*th);
+  CHECK(checkTile(image, 0, 0, 10));
+  CHECK(checkTile(image, 0, 1, 30));
+  CHECK(checkTile(image, 1, 0, 50));
+  CHECK(checkTile(image, 1, 1, 0));
+  CHECK(cache.getStatistics().misses == 3);
+
+  // loading again is served from the cache
+
+  gimage::getImageIO().load(image, name.c_str());
+
+  CHECK(checkTile(image, 0, 1, 30));
+  CHECK(cache.getStatistics().hits == 3);
+  CHECK(cache.getStatistics().misses == 3);
+
+  // a changed tile is read again
+
+  writeTile(dir, 0, 1, 130, 2000);
+  setModificationTime(dir, 1000);
+
+  gimage::getImageIO().load(image, name.c_str());
+
+  CHECK(checkTile(image, 0, 0, 10));
+  CHECK(checkTile(image, 0, 1, 130));
+  CHECK(cache.getStatistics().misses == 4);
+
+  // an added tile is found, since the modification time of the directory
+  // changed
+
+  writeTile(dir, 1, 1, 170, 1000);
+  setModificationTime(dir, 2000);
+
+  gimage::getImageIO().load(image, name.c_str());
+
+  CHECK(checkTile(image, 1, 0, 50));
+  CHECK(checkTile(image, 1, 1, 170));
+
+  // a removed tile is not requested anymore
+
+  std::remove((dir+"/t_01_00_a.pgm").c_str());
+  setModificationTime(dir, 3000);
+
+  gimage::getImageIO().load(image, name.c_str());
+
+  CHECK(checkTile(image, 0, 0, 10));
+  CHECK(checkTile(image, 1, 0, 0));
+  CHECK(checkTile(image, 1, 1, 170));
+
+  // a changed first tile, which defines the tile size, changes the index
+
+  writeTile(dir, 0, 0, 200, 3000);
+  setModificationTime(dir, 3000);
+
+  gimage::getImageIO().load(image, name.c_str());
+
+  CHECK(image.getWidth() == 2*tw);
+  CHECK(checkTile(image, 0, 0, 200));
+
+  cache.flush();
+  cache.setCapacity(capacity);
+  gimage::clearTileIndexCache();
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: test_tilecache <tmp-dir>" << std::endl;
+    return 1;
+  }
+
+  testTileCache();
+  testTiledImage(argv[1]);
+
+  return check_failed;
+}
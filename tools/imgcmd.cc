@@ -42,16 +42,28 @@
 #include <gimage/arithmetic.h>
 #include <gimage/paint.h>
 #include <gimage/compare.h>
+#include <gimage/bufferpool.h>
+#include <gimage/pointop.h>
+#include <gimage/timing.h>
 
 #include <gutil/parameter.h>
 #include <gutil/misc.h>
 #include <gutil/proctime.h>
+#include <gutil/thread.h>
 #include <gutil/version.h>
 
 #include <iostream>
 #include <iomanip>
 #include <fstream>
 #include <vector>
+#include <utility>
+#include <memory>
+#include <sstream>
+#include <deque>
+#include <cctype>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
 
 namespace
 {
@@ -74,8 +86,231 @@ std::string nextParameterFilename(gutil::Parameter &param, const std::string &re
   return prefix+repl+suffix;
 }
 
+template<class T> void selectChannel(gimage::Image<T> &ret, const gimage::ImageView<const T> &image,
+                                     const std::string &channel)
+{
+  if (channel == "I")
+  {
+    imageToGrey(ret, image);
+  }
+  else if (channel == "R")
+  {
+    imageSelect(ret, image, 0);
+  }
+  else if (channel == "G")
+  {
+    imageSelect(ret, image, 1);
+  }
+  else if (channel == "B")
+  {
+    imageSelect(ret, image, 2);
+  }
+}
+
+/*
+ * Writers for all images that are stored while an image is processed in
+ * bands of rows. The writers are opened with the first band and identified
+ * by the order of storing within the processing of a band.
+ */
+
+class BandOutput
+{
+  private:
+
+    long height;
+    size_t next;
+    std::vector<std::unique_ptr<gimage::ImageWriter> > list;
+
+    BandOutput(const BandOutput &);
+    BandOutput &operator=(const BandOutput &);
+
+  public:
+
+    BandOutput(long _height)
+    {
+      height=_height;
+      next=0;
+    }
+
+    /**
+     * Must be called before processing the next band.
+     */
+
+    void rewind()
+    {
+      next=0;
+    }
+
+    template<class T> void write(const gimage::Image<T> &band, const std::string &name)
+    {
+      if (next >= list.size())
+      {
+        list.push_back(std::unique_ptr<gimage::ImageWriter>(gimage::getImageIO().openWriter(
+                         name.c_str(), band.getWidth(), height, band.getDepth())));
+      }
+
+      list[next++]->write(band);
+    }
+
+    void close()
+    {
+      for (size_t i=0; i<list.size(); i++)
+      {
+        list[i]->close();
+      }
+    }
+};
+
+/*
+ * Returns true if the remaining options only compute each row of the result
+ * from the same row of the image and if the result is stored. In this case,
+ * the options can be applied to bands of rows independently.
+ */
+
+bool isRowLocal(gutil::Parameter param)
+{
+  bool out=false;
+
+  try
+  {
+    while (param.remaining() > 0)
+    {
+      std::string p, s;
+      int n=-1;
+
+      param.nextParameter(p);
+
+      if (p == "-reciprocal" || p == "-u8" || p == "-u16" || p == "-float" || p == "-color" ||
+          p == "-rgb2hsv" || p == "-hsv2rgb8")
+      {
+        n=0;
+      }
+      else if (p == "-out" || p == "-gamma" || p == "-add" || p == "-sub" || p == "-mul" ||
+               p == "-div" || p == "-select" || p == "-noise")
+      {
+        n=1;
+      }
+      else if (p == "-valid" || p == "-clip")
+      {
+        n=2;
+      }
+
+      if (n < 0)
+      {
+        return false;
+      }
+
+      for (int i=0; i<n; i++)
+      {
+        param.nextString(s);
+      }
+
+      out=out || (p == "-out");
+    }
+  }
+  catch (const std::exception &)
+  {
+    return false;
+  }
+
+  return out;
+}
+
+/*
+ * Parses the given option and adds it to the pipeline, if it is a point
+ * operation. False is returned otherwise.
+ */
+
+template<class T> bool addPointOperation(gimage::PointPipeline<T> &pipe,
+                                         const gimage::Image<T> &image, const std::string &p,
+                                         gutil::Parameter &param)
+{
+  if (p == "-gamma")
+  {
+    gimage::Image<T> map;
+    double s;
+
+    param.nextValue(s);
+    fillGammaMap(map, image, s);
+    pipe.add(new gimage::RemapOperation<T>(map));
+
+    return true;
+  }
+
+  if (p == "-add" || p == "-sub")
+  {
+    double s;
+
+    param.nextValue(s);
+
+    if (p == "-add")
+    {
+      pipe.add(new gimage::AddOperation<T>(static_cast<typename gimage::Image<T>::work_t>(s)));
+    }
+    else
+    {
+      pipe.add(new gimage::SubOperation<T>(static_cast<typename gimage::Image<T>::work_t>(s)));
+    }
+
+    return true;
+  }
+
+  if (p == "-mul" || p == "-div")
+  {
+    double s;
+
+    param.nextValue(s);
+
+    if (p == "-mul")
+    {
+      pipe.add(new gimage::MulOperation<T>(s));
+    }
+    else
+    {
+      pipe.add(new gimage::DivOperation<T>(s));
+    }
+
+    return true;
+  }
+
+  if (p == "-reciprocal")
+  {
+    pipe.add(new gimage::ReciprocalOperation<T>());
+
+    return true;
+  }
+
+  if (p == "-valid" || p == "-clip")
+  {
+    double from, to;
+
+    param.nextValue(from);
+    param.nextValue(to);
+
+    if (p == "-valid")
+    {
+      pipe.add(new gimage::ValidOperation<T>(static_cast<T>(from), static_cast<T>(to)));
+    }
+    else
+    {
+      pipe.add(new gimage::ClipOperation<T>(static_cast<T>(from), static_cast<T>(to)));
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+/*
+ * Applies the options to the image. Results and errors are printed to out and
+ * err. If band is given, then the image is one band of rows, which is written
+ * to the outputs of band and exceptions are passed to the caller.
+ */
+
 template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
-                               const std::string &repl)
+                               const std::string &repl, std::ostream &out, std::ostream &err,
+                               BandOutput *band=0)
 {
   try
   {
@@ -85,9 +320,102 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
 
       param.nextParameter(p);
 
+      // consecutive point operations and a directly following type
+      // conversion are applied in one pass over the image
+
+      gimage::PointPipeline<T> pipe;
+      std::string op;
+
+      while (addPointOperation(pipe, image, p, param))
+      {
+        op+=(op.size() > 0 ? " " : "")+p;
+        p.clear();
+
+        if (param.remaining() > 0)
+        {
+          param.nextParameter(p);
+        }
+      }
+
+      // all point operations and the following conversion are measured as
+      // one operation
+
+      gimage::Timing timing;
+      double pixels=static_cast<double>(image.getWidth())*image.getHeight();
+
+      if (pipe.size() > 0)
+      {
+        if (p == "-u8" || p == "-u16" || p == "-float")
+        {
+          op+=" "+p;
+        }
+
+        timing.start(op);
+      }
+      else
+      {
+        timing.start(p);
+      }
+
+      if (pipe.size() > 0)
+      {
+        if (p == "-u8")
+        {
+          gimage::ImageU8 imageu8;
+          pipe.apply(imageu8, image);
+          image.setSize(0, 0, 0);
+          timing.stop(pixels);
+          process(imageu8, param, repl, out, err, band);
+          break;
+        }
+
+        if (p == "-u16")
+        {
+          gimage::ImageU16 imageu16;
+          pipe.apply(imageu16, image);
+          image.setSize(0, 0, 0);
+          timing.stop(pixels);
+          process(imageu16, param, repl, out, err, band);
+          break;
+        }
+
+        if (p == "-float")
+        {
+          gimage::ImageFloat imagef;
+          pipe.apply(imagef, image);
+          image.setSize(0, 0, 0);
+          timing.stop(pixels);
+          process(imagef, param, repl, out, err, band);
+          break;
+        }
+
+        pipe.apply(image);
+        timing.stop(pixels);
+
+        // the option that follows the point operations is processed next
+
+        if (p.size() > 0)
+        {
+          param.previous();
+        }
+
+        continue;
+      }
+
       if (p == "-out")
       {
-        gimage::getImageIO().save(image, nextParameterFilename(param, repl).c_str());
+        std::string name=nextParameterFilename(param, repl);
+
+        timing.start("save", name);
+
+        if (band != 0)
+        {
+          band->write(image, name);
+        }
+        else
+        {
+          gimage::getImageIO().save(image, name.c_str());
+        }
       }
 
       if (p == "-ds")
@@ -106,6 +434,18 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
         image=medianDownscaleImage(image, factor);
       }
 
+      if (p == "-resize")
+      {
+        long w, h;
+        std::string kernel;
+
+        param.nextValue(w);
+        param.nextValue(h);
+        param.nextString(kernel, "bilinear|area|lanczos3");
+
+        image=resampleImage(image, w, h, gimage::getResampleKernel(kernel));
+      }
+
       if (p == "-crop")
       {
         long x, y, w, h;
@@ -114,7 +454,38 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
         param.nextValue(y);
         param.nextValue(w);
         param.nextValue(h);
-        image=cropImage(image, x, y, w, h);
+
+        if (x >= 0 && y >= 0 && w >= 0 && h >= 0 && x+w <= image.getWidth() &&
+            y+h <= image.getHeight())
+        {
+          // crop on a view, so that a directly following selection of a
+          // color channel only copies the pixels that are finally needed
+
+          gimage::ImageView<const T> view(image, x, y, w, h);
+          gimage::Image<T> tmp;
+
+          std::string channel;
+
+          if (param.nextParameterIs("-select"))
+          {
+            param.nextString(channel, "I|R|G|B");
+          }
+
+          if (channel.size() > 0)
+          {
+            selectChannel(tmp, view, channel);
+          }
+          else
+          {
+            tmp.setImage(view);
+          }
+
+          image=std::move(tmp);
+        }
+        else
+        {
+          image=cropImage(image, x, y, w, h);
+        }
       }
 
       if (p == "-u8")
@@ -122,7 +493,8 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
         gimage::ImageU8 imageu8;
         imageu8.setImageLimited(image);
         image.setSize(0, 0, 0);
-        process(imageu8, param, repl);
+        timing.stop(pixels);
+        process(imageu8, param, repl, out, err, band);
         break;
       }
 
@@ -131,7 +503,8 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
         gimage::ImageU16 imageu16;
         imageu16.setImageLimited(image);
         image.setSize(0, 0, 0);
-        process(imageu16, param, repl);
+        timing.stop(pixels);
+        process(imageu16, param, repl, out, err, band);
         break;
       }
 
@@ -140,7 +513,8 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
         gimage::ImageFloat imagef;
         imagef.setImageLimited(image);
         image.setSize(0, 0, 0);
-        process(imagef, param, repl);
+        timing.stop(pixels);
+        process(imagef, param, repl, out, err, band);
         break;
       }
 
@@ -151,24 +525,9 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
 
         param.nextString(channel, "I|R|G|B");
 
-        if (channel == "I")
-        {
-          imageToGrey(tmp, image);
-        }
-        else if (channel == "R")
-        {
-          imageSelect(tmp, image, 0);
-        }
-        else if (channel == "G")
-        {
-          imageSelect(tmp, image, 1);
-        }
-        else if (channel == "B")
-        {
-          imageSelect(tmp, image, 2);
-        }
+        selectChannel(tmp, gimage::ImageView<const T>(image), channel);
 
-        image=tmp;
+        image=std::move(tmp);
       }
 
       if (p == "-color")
@@ -185,7 +544,8 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
         gimage::ImageU8 image8;
 
         gimage::imageToJET(image8, image);
-        process(image8, param, repl);
+        timing.stop(pixels);
+        process(image8, param, repl, out, err, band);
         break;
       }
 
@@ -195,7 +555,8 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
 
         rgbToHSV(imagef, image);
         image.setSize(0, 0, 0);
-        process(imagef, param, repl);
+        timing.stop(pixels);
+        process(imagef, param, repl, out, err, band);
         break;
       }
 
@@ -209,7 +570,8 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
 
         hsvToRGB(imageu8, imagef);
         imagef.setSize(0, 0, 0);
-        process(imageu8, param, repl);
+        timing.stop(pixels);
+        process(imageu8, param, repl, out, err, band);
         break;
       }
 
@@ -219,7 +581,7 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
 
         for (int i=0; i<hist.getWidth(); i++)
         {
-          std::cout << i << " " << hist(i) << std::endl;
+          out << i << " " << hist(i) << std::endl;
         }
       }
 
@@ -230,7 +592,8 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
 
         hist.visualize(himage);
         image.setSize(0, 0, 0);
-        process(himage, param, repl);
+        timing.stop(pixels);
+        process(himage, param, repl, out, err, band);
         break;
       }
 
@@ -246,57 +609,11 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
         hist.visualize(himage);
         image.setSize(0, 0, 0);
         image2.setSize(0, 0, 0);
-        process(himage, param, repl);
+        timing.stop(pixels);
+        process(himage, param, repl, out, err, band);
         break;
       }
 
-      if (p == "-gamma")
-      {
-        gimage::Image<T> map;
-        double s;
-
-        param.nextValue(s);
-        fillGammaMap(map, image, s);
-        remapImage(image, map);
-      }
-
-      if (p == "-add")
-      {
-        double s;
-
-        param.nextValue(s);
-        image+=static_cast<typename gimage::Image<T>::work_t>(s);
-      }
-
-      if (p == "-sub")
-      {
-        double s;
-
-        param.nextValue(s);
-        image-=static_cast<typename gimage::Image<T>::work_t>(s);
-      }
-
-      if (p == "-mul")
-      {
-        double s;
-
-        param.nextValue(s);
-        image*=s;
-      }
-
-      if (p == "-div")
-      {
-        double s;
-
-        param.nextValue(s);
-        image/=s;
-      }
-
-      if (p == "-reciprocal")
-      {
-        reciprocal(image);
-      }
-
       if (p == "-noise")
       {
         double s;
@@ -307,24 +624,6 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
         addScaledNoise(image, static_cast<float>(s));
       }
 
-      if (p == "-valid")
-      {
-        double from, to;
-
-        param.nextValue(from);
-        param.nextValue(to);
-        validRange(image, static_cast<T>(from), static_cast<T>(to));
-      }
-
-      if (p == "-clip")
-      {
-        double from, to;
-
-        param.nextValue(from);
-        param.nextValue(to);
-        clipRange(image, static_cast<T>(from), static_cast<T>(to));
-      }
-
       if (p == "-cmp")
       {
         gimage::Image<T> image2;
@@ -359,14 +658,14 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
 
         if (outlier >= 0 && f <= tf)
         {
-          std::cout << "Images are the same within given tolerances." << std::endl;
+          out << "Images are the same within given tolerances." << std::endl;
         }
         else if (outlier < 0)
         {
-          std::cout << "Size or number of color channels differs!" << std::endl;
+          out << "Size or number of color channels differs!" << std::endl;
         }
         else
-          std::cout << "Image differences exceed given tolerances. Oulier: "
+          out << "Image differences exceed given tolerances. Oulier: "
                     << std::setprecision(5) << f << " %" << std::endl;
       }
 
@@ -393,14 +692,14 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
         param.nextValue(x);
         param.nextValue(y);
 
-        std::cout << "image(" << x << ", " << y << "):";
+        out << "image(" << x << ", " << y << "):";
 
         for (int d=0; d<image.getDepth(); d++)
         {
-          std::cout << " " << image.getW(x, y, d);
+          out << " " << image.getW(x, y, d);
         }
 
-        std::cout << std::endl;
+        out << std::endl;
       }
 
       if (p == "-print")
@@ -411,17 +710,17 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
         if (what == "all" || what == "type")
         {
           typedef typename gimage::Image<T>::ptraits ptraits;
-          std::cout << "type=" << ptraits::description() << std::endl;
+          out << "type=" << ptraits::description() << std::endl;
         }
 
         if (what == "all" || what == "min")
         {
-          std::cout << "min=" << image.minValue() << std::endl;
+          out << "min=" << image.minValue() << std::endl;
         }
 
         if (what == "all" || what == "max")
         {
-          std::cout << "max=" << image.maxValue() << std::endl;
+          out << "max=" << image.maxValue() << std::endl;
         }
 
         if (what == "all" || what == "mean")
@@ -438,54 +737,1114 @@ template<class T> void process(gimage::Image<T> &image, gutil::Parameter param,
 
           v/=image.getWidth()*image.getHeight();
 
-          std::cout << "mean=" << v << std::endl;
+          out << "mean=" << v << std::endl;
         }
 
         if (what == "all" || what == "width")
         {
-          std::cout << "width=" << image.getWidth() << std::endl;
+          out << "width=" << image.getWidth() << std::endl;
         }
 
         if (what == "all" || what == "height")
         {
-          std::cout << "height=" << image.getHeight() << std::endl;
+          out << "height=" << image.getHeight() << std::endl;
         }
 
         if (what == "all" || what == "depth")
         {
-          std::cout << "depth=" << image.getDepth() << std::endl;
+          out << "depth=" << image.getDepth() << std::endl;
         }
       }
+
+      timing.stop(pixels);
     }
   }
   catch (gutil::Exception &ex)
   {
-    std::cerr << ex.what() << std::endl;
-    std::cerr << ex.where() << std::endl;
+    if (band != 0)
+    {
+      throw;
+    }
+
+    err << ex.what() << std::endl;
+    err << ex.where() << std::endl;
   }
   catch (std::exception &ex)
   {
-    std::cerr << ex.what() << std::endl;
+    if (band != 0)
+    {
+      throw;
+    }
+
+    err << ex.what() << std::endl;
   }
 }
 
-}
+/*
+ * Reads the first band with the given pixel type. False is returned if the
+ * stored type is larger.
+ */
 
-int main(int argc, char *argv[])
+template<class T> bool readFirstBand(gimage::ImageReader &reader, gimage::Image<T> &band,
+                                     long rows)
 {
-  // command line definition
-
-  const char *def[]=
+  try
   {
-    "# imgcmd [-help | -version] <in> [<options>]",
-    "#",
-    "# The input and output names may contain the wildcard '%'.",
-    "#",
+    gimage::Timing timing;
+    timing.start("load");
 
-    "-help # Print help and exit.",
+    bool ret=reader.read(band, rows);
+
+    timing.stop(static_cast<double>(band.getWidth())*band.getHeight());
+
+    return ret;
+  }
+  catch (const std::exception &)
+  {
+    return false;
+  }
+}
+
+template<class T> void processBands(gimage::ImageReader &reader, gimage::Image<T> &band,
+                                    const gutil::Parameter &param, const std::string &repl,
+                                    long rows, std::ostream &out, std::ostream &err)
+{
+  BandOutput bout(reader.getHeight());
+
+  while (true)
+  {
+    bout.rewind();
+    process(band, param, repl, out, err, &bout);
+
+    gimage::Timing timing;
+    timing.start("load");
+
+    if (!reader.read(band, rows))
+    {
+      break;
+    }
+
+    timing.stop(static_cast<double>(band.getWidth())*band.getHeight());
+  }
+
+  bout.close();
+}
+
+/*
+ * Processes the image in bands of rows, using the smallest pixel type that
+ * can hold the stored values. Bands have at least 256 rows or about 16 MB
+ * as float image.
+ */
+
+void processBands(const std::string &name, const gutil::Parameter &param,
+                  const std::string &repl, std::ostream &out, std::ostream &err)
+{
+  std::unique_ptr<gimage::ImageReader> reader(gimage::getImageIO().openReader(name.c_str()));
+
+  long rows=std::max(256l, (16l<<20)/std::max(1l, reader->getWidth()*reader->getDepth()*4));
+
+  gimage::ImageU8 bandu8;
+
+  if (readFirstBand(*reader, bandu8, rows))
+  {
+    processBands(*reader, bandu8, param, repl, rows, out, err);
+    return;
+  }
+
+  gimage::ImageU16 bandu16;
+
+  if (readFirstBand(*reader, bandu16, rows))
+  {
+    processBands(*reader, bandu16, param, repl, rows, out, err);
+    return;
+  }
+
+  gimage::ImageFloat bandf;
+  gimage::Timing timing;
+
+  timing.start("load");
+
+  if (reader->read(bandf, rows))
+  {
+    timing.stop(static_cast<double>(bandf.getWidth())*bandf.getHeight());
+    processBands(*reader, bandf, param, repl, rows, out, err);
+  }
+}
+
+/*
+ * Returns the string in double quotes with JSON escape sequences.
+ */
+
+std::string jsonString(const std::string &s)
+{
+  std::ostringstream ret;
+
+  ret << '"';
+
+  for (size_t i=0; i<s.size(); i++)
+  {
+    unsigned char c=static_cast<unsigned char>(s[i]);
+
+    if (c == '"' || c == '\\')
+    {
+      ret << '\\' << s[i];
+    }
+    else if (c < 0x20)
+    {
+      ret << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+          << std::dec;
+    }
+    else
+    {
+      ret << s[i];
+    }
+  }
+
+  ret << '"';
+
+  return ret.str();
+}
+
+/*
+ * Collects the measurements of loading, processing and saving images, summed
+ * up per operation in the order of first appearance.
+ */
+
+class TimingCollector : public gimage::TimingHook
+{
+  private:
+
+    struct Entry
+    {
+      std::string operation;
+      long   count;
+      double seconds;
+      double mpixel;
+      double bytes;
+    };
+
+    std::vector<Entry> list;
+    long   files;
+    double seconds, wall;
+
+    void add(const Entry &e)
+    {
+      size_t i=0;
+
+      while (i < list.size() && list[i].operation != e.operation)
+      {
+        i++;
+      }
+
+      if (i < list.size())
+      {
+        list[i].count+=e.count;
+        list[i].seconds+=e.seconds;
+        list[i].mpixel+=e.mpixel;
+        list[i].bytes+=e.bytes;
+      }
+      else
+      {
+        list.push_back(e);
+      }
+    }
+
+  public:
+
+    TimingCollector()
+    {
+      files=0;
+      seconds=0;
+      wall=0;
+    }
+
+    virtual void record(const gimage::TimingRecord &rec)
+    {
+      Entry e;
+
+      e.operation=rec.operation;
+      e.count=1;
+      e.seconds=rec.seconds;
+      e.mpixel=rec.mpixel;
+      e.bytes=static_cast<double>(rec.bytes);
+
+      add(e);
+    }
+
+    /**
+     * Counts a processed file with the given total wall time.
+     */
+
+    void addFile(double s)
+    {
+      files++;
+      seconds+=s;
+    }
+
+    void add(const TimingCollector &tc)
+    {
+      for (size_t i=0; i<tc.list.size(); i++)
+      {
+        add(tc.list[i]);
+      }
+
+      files+=tc.files;
+      seconds+=tc.seconds;
+    }
+
+    /**
+     * Sets the wall time of processing all files, which is reported in
+     * addition if it is not 0.
+     */
+
+    void setWallTime(double s)
+    {
+      wall=s;
+    }
+
+    /**
+     * Prints the measurements as table or json. The name of the file is
+     * given if the measurements are not an aggregate over several files.
+     */
+
+    void print(std::ostream &out, const std::string &format, const std::string &name) const
+    {
+      std::ostringstream os;
+
+      if (format == "json")
+      {
+        os << "{";
+
+        if (name.size() > 0)
+        {
+          os << "\"file\": " << jsonString(name);
+        }
+        else
+        {
+          os << "\"files\": " << files;
+        }
+
+        os << ", \"seconds\": " << seconds;
+
+        if (wall > 0)
+        {
+          os << ", \"wall_seconds\": " << wall;
+        }
+
+        os << ", \"operations\": [";
+
+        for (size_t i=0; i<list.size(); i++)
+        {
+          const Entry &e=list[i];
+
+          os << (i > 0 ? ", " : "") << "{\"operation\": " << jsonString(e.operation)
+             << ", \"count\": " << e.count << ", \"seconds\": " << e.seconds
+             << ", \"mpixel\": " << e.mpixel << ", \"mpixel_per_second\": "
+             << (e.seconds > 0 ? e.mpixel/e.seconds : 0) << ", \"bytes\": "
+             << static_cast<unsigned long long>(e.bytes) << "}";
+        }
+
+        os << "]}" << std::endl;
+      }
+      else
+      {
+        os << std::left << std::setw(24) << "operation" << std::right << std::setw(8) << "count"
+           << std::setw(12) << "time [s]" << std::setw(12) << "MPixel/s" << std::setw(12)
+           << "MB alloc" << std::endl;
+
+        os << std::fixed;
+
+        for (size_t i=0; i<list.size(); i++)
+        {
+          const Entry &e=list[i];
+
+          os << std::left << std::setw(24) << e.operation << std::right << std::setw(8)
+             << e.count << std::setprecision(4) << std::setw(12) << e.seconds
+             << std::setprecision(2) << std::setw(12) << (e.seconds > 0 ? e.mpixel/e.seconds : 0)
+             << std::setw(12) << e.bytes/(1<<20) << std::endl;
+        }
+
+        std::ostringstream total;
+
+        total << "total";
+
+        if (name.size() == 0)
+        {
+          total << " (" << files << " files)";
+        }
+
+        os << std::left << std::setw(24) << total.str() << std::right << std::setw(8) << ""
+           << std::setprecision(4) << std::setw(12) << seconds << std::endl;
+
+        if (wall > 0)
+        {
+          os << std::left << std::setw(24) << "wall time" << std::right << std::setw(8) << ""
+             << std::setprecision(4) << std::setw(12) << wall << std::endl;
+        }
+      }
+
+      out << os.str();
+    }
+};
+
+/*
+ * Options for loading the images and for deciding about processing them in
+ * bands.
+ */
+
+struct LoadOptions
+{
+  int    ds;
+  long   x, y, w, h;
+  bool   rowlocal;
+  double streampixel;
+};
+
+/*
+ * Returns true if the image should be processed in bands of rows.
+ */
+
+bool useBands(long iw, long ih, const LoadOptions &opt)
+{
+  return opt.rowlocal && static_cast<double>(iw)*ih > opt.streampixel*1000000;
+}
+
+/*
+ * Estimates the memory in bytes that is needed for processing the image as
+ * twice the size of the loaded image as float. 0 is returned if the header
+ * cannot be read.
+ */
+
+double estimateMemory(const std::string &name, const LoadOptions &opt)
+{
+  long iw, ih;
+  int  id;
+
+  try
+  {
+    gimage::getImageIO().loadHeader(name.c_str(), iw, ih, id);
+  }
+  catch (const std::exception &)
+  {
+    return 0;
+  }
+
+  if (useBands(iw, ih, opt))
+  {
+    return 4.0*std::max(256.0*iw*id*4, 16.0*(1<<20));
+  }
+
+  iw=(iw+opt.ds-1)/opt.ds;
+  ih=(ih+opt.ds-1)/opt.ds;
+
+  if (opt.w >= 0 && opt.h >= 0)
+  {
+    iw=std::min(iw, opt.w);
+    ih=std::min(ih, opt.h);
+  }
+
+  return 2.0*iw*ih*id*sizeof(float);
+}
+
+/*
+ * Loads the image with the smallest possible pixel type and applies the
+ * options.
+ */
+
+void processFile(const std::string &name, const std::string &repl,
+                 const gutil::Parameter &param, const LoadOptions &opt,
+                 std::ostream &out, std::ostream &err)
+{
+  if (opt.rowlocal)
+  {
+    try
+    {
+      long iw, ih;
+      int  id;
+
+      gimage::getImageIO().loadHeader(name.c_str(), iw, ih, id);
+
+      if (useBands(iw, ih, opt))
+      {
+        processBands(name, param, repl, out, err);
+        return;
+      }
+    }
+    catch (const std::exception &ex)
+    {
+      err << ex.what() << std::endl;
+      return;
+    }
+  }
+
+  try
+  {
+    gimage::ImageU8 image;
+
+    gimage::getImageIO().load(image, name.c_str(), opt.ds, opt.x, opt.y, opt.w, opt.h);
+    process(image, param, repl, out, err);
+  }
+  catch (const std::exception &)
+  {
+    try
+    {
+      gimage::ImageU16 image;
+
+      gimage::getImageIO().load(image, name.c_str(), opt.ds, opt.x, opt.y, opt.w, opt.h);
+      process(image, param, repl, out, err);
+    }
+    catch (const std::exception &)
+    {
+      try
+      {
+        gimage::ImageFloat image;
+
+        gimage::getImageIO().load(image, name.c_str(), opt.ds, opt.x, opt.y, opt.w, opt.h);
+        process(image, param, repl, out, err);
+      }
+      catch (const std::exception &ex)
+      {
+        err << ex.what() << std::endl;
+      }
+    }
+  }
+}
+
+/*
+ * Processes the file and prints the measured operations in the given format
+ * (table or json), if the format is not empty. The measurements are also
+ * added to tc.
+ */
+
+void processFile(const std::string &name, const std::string &repl,
+                 const gutil::Parameter &param, const LoadOptions &opt,
+                 const std::string &format, TimingCollector &tc, std::ostream &out,
+                 std::ostream &err)
+{
+  if (format.size() == 0)
+  {
+    processFile(name, repl, param, opt, out, err);
+    return;
+  }
+
+  TimingCollector ftc;
+  double t=gutil::ProcTime::monotonic();
+
+  gimage::setTimingHook(&ftc);
+  processFile(name, repl, param, opt, out, err);
+  gimage::setTimingHook(0);
+
+  ftc.addFile(gutil::ProcTime::monotonic()-t);
+  ftc.print(out, format, name);
+
+  tc.add(ftc);
+}
+
+/*
+ * Processes a list of files with several threads. A file is only started if
+ * the estimated memory of all running files stays below the given budget,
+ * with the exception that one file is always permitted. The output of each
+ * file is collected and printed in the order of the list.
+ */
+
+class BatchProcessor : public gutil::ThreadFunction
+{
+  private:
+
+    struct Result
+    {
+      bool done;
+      std::ostringstream out, err;
+      TimingCollector tc;
+    };
+
+    const std::vector<std::string> &list;
+    const std::vector<std::string> &repl;
+    const gutil::Parameter &param;
+    const LoadOptions &opt;
+    const std::string &format;
+    double budget;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t next;
+    double used;
+    std::vector<std::unique_ptr<Result> > result;
+
+    BatchProcessor(const BatchProcessor &);
+    BatchProcessor &operator=(const BatchProcessor &);
+
+  public:
+
+    BatchProcessor(const std::vector<std::string> &_list, const std::vector<std::string> &_repl,
+                   const gutil::Parameter &_param, const LoadOptions &_opt,
+                   const std::string &_format, double _budget) :
+      list(_list), repl(_repl), param(_param), opt(_opt), format(_format)
+    {
+      budget=_budget;
+      next=0;
+      used=0;
+
+      for (size_t i=0; i<list.size(); i++)
+      {
+        result.push_back(std::unique_ptr<Result>(new Result()));
+        result.back()->done=false;
+      }
+    }
+
+    void run()
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+
+      while (next < list.size())
+      {
+        size_t i=next++;
+
+        lock.unlock();
+        double mem=estimateMemory(list[i], opt);
+        lock.lock();
+
+        while (used > 0 && used+mem > budget)
+        {
+          cv.wait(lock);
+        }
+
+        used+=mem;
+        lock.unlock();
+
+        Result &r=*result[i];
+
+        if (list.size() > 1)
+        {
+          r.out << list[i] << ":" << std::endl;
+        }
+
+        processFile(list[i], repl[i], param, opt, format, r.tc, r.out, r.err);
+
+        lock.lock();
+        used-=mem;
+        r.done=true;
+        cv.notify_all();
+      }
+    }
+
+    /**
+     * Processes all files with the given number of threads and prints the
+     * results in order to out and err. The measurements of all files are
+     * added to tc.
+     */
+
+    void process(int nthreads, TimingCollector &tc, std::ostream &out, std::ostream &err)
+    {
+      std::vector<std::unique_ptr<gutil::Thread> > thread;
+
+      for (int i=0; i<nthreads; i++)
+      {
+        thread.push_back(std::unique_ptr<gutil::Thread>(new gutil::Thread()));
+        thread.back()->create(*this);
+      }
+
+      for (size_t i=0; i<result.size(); i++)
+      {
+        {
+          std::unique_lock<std::mutex> lock(mtx);
+
+          while (!result[i]->done)
+          {
+            cv.wait(lock);
+          }
+        }
+
+        out << result[i]->out.str() << std::flush;
+        err << result[i]->err.str() << std::flush;
+
+        tc.add(result[i]->tc);
+
+        result[i].reset();
+      }
+
+      for (size_t i=0; i<thread.size(); i++)
+      {
+        thread[i]->join();
+      }
+    }
+};
+
+/*
+ * Divides the number of threads for processing single images by n while the
+ * object exists. The previous number is restored afterwards, so that
+ * repeated commands do not reduce it further.
+ */
+
+class ThreadShare
+{
+  private:
+
+    int prev;
+
+    ThreadShare(const ThreadShare &);
+    ThreadShare &operator=(const ThreadShare &);
+
+  public:
+
+    ThreadShare(int n)
+    {
+      prev=gutil::Thread::getMaxThreads();
+      gutil::Thread::setMaxThreads(std::max(1, prev/std::max(1, n)));
+    }
+
+    ~ThreadShare()
+    {
+      gutil::Thread::setMaxThreads(prev);
+    }
+};
+
+/*
+ * Executes the command that is given by the parameters after the program
+ * name and returns the exit code. Results are printed to out and errors to
+ * err. Files are only processed in parallel if this is permitted.
+ */
+
+int runCommand(gutil::Parameter &param, std::ostream &out, std::ostream &err, bool parallel)
+{
+  // get name
+
+  std::string p, prefix, suffix;
+
+  param.nextString(prefix);
+
+  // read optional parameters for batch processing
+
+  int    nthreads=1;
+  double budget=4096;
+  std::string format;
+
+  while (param.remaining() > 0)
+  {
+    param.nextParameter(p);
+
+    if (p == "-threads")
+    {
+      param.nextValue(nthreads);
+      nthreads=std::max(1, nthreads);
+    }
+    else if (p == "-memory")
+    {
+      param.nextValue(budget);
+    }
+    else if (p == "-timing")
+    {
+      param.nextString(format, "table|json");
+    }
+    else
+    {
+      param.previous();
+      break;
+    }
+  }
+
+  // read first two parameters, if they are -ds and -crop,
+  // because this can be considered while loading
+
+  std::set<std::string> files;
+  LoadOptions opt;
+
+  opt.ds=1;
+  opt.x=0;
+  opt.y=0;
+  opt.w=-1;
+  opt.h=-1;
+
+  if (param.remaining() > 0)
+  {
+    param.nextParameter(p);
+
+    if (p == "-ds")
+    {
+      param.nextValue(opt.ds);
+      opt.ds=std::max(1, opt.ds);
+    }
+    else
+    {
+      param.previous();
+    }
+  }
+
+  if (param.remaining() > 0)
+  {
+    param.nextParameter(p);
+
+    if (p == "-crop")
+    {
+      param.nextValue(opt.x);
+      param.nextValue(opt.y);
+      param.nextValue(opt.w);
+      param.nextValue(opt.h);
+    }
+    else
+    {
+      param.previous();
+    }
+  }
+
+  // determine list of files if the pattern character '%' is found in the
+  // file name
+
+  size_t pos=prefix.find('%');
+
+  if (pos < prefix.size())
+  {
+    suffix=prefix.substr(pos+1);
+    prefix=prefix.substr(0, pos);
+    gutil::getFileList(files, prefix, suffix);
+  }
+  else
+  {
+    files.insert(prefix);
+  }
+
+  std::vector<std::string> list, repl;
+
+  for (std::set<std::string>::iterator it=files.begin(); it!=files.end(); ++it)
+  {
+    list.push_back(*it);
+    repl.push_back(it->substr(prefix.size(), it->size()-prefix.size()-suffix.size()));
+  }
+
+  // images that are not reduced while loading can be processed in bands of
+  // rows, if all options permit this
+
+  opt.rowlocal=(opt.ds == 1 && opt.x == 0 && opt.y == 0 && opt.w < 0 && opt.h < 0 &&
+                isRowLocal(param));
+  opt.streampixel=64;
+
+  if (std::getenv("CVKIT_STREAM_MPIXEL") != 0)
+  {
+    opt.streampixel=std::atof(std::getenv("CVKIT_STREAM_MPIXEL"));
+  }
+
+  // process files in parallel, dividing the threads for processing single
+  // images among them
+
+  // commands of the server are already executed concurrently
+
+  if (!parallel)
+  {
+    nthreads=1;
+  }
+
+  nthreads=static_cast<int>(std::min(static_cast<size_t>(nthreads), list.size()));
+
+  TimingCollector tc;
+  double t=gutil::ProcTime::monotonic();
+
+  if (nthreads > 1)
+  {
+    ThreadShare share(nthreads);
+
+    BatchProcessor batch(list, repl, param, opt, format, budget*(1<<20));
+    batch.process(nthreads, tc, out, err);
+  }
+  else
+  {
+    // try loading with increasing data type and start processing using
+    // remainder of the command line
+
+    for (size_t i=0; i<list.size(); i++)
+    {
+      if (list.size() > 1)
+      {
+        out << list[i] << ":" << std::endl;
+      }
+
+      processFile(list[i], repl[i], param, opt, format, tc, out, err);
+    }
+  }
+
+  // print aggregated measurements of all files
+
+  if (format.size() > 0 && list.size() > 1)
+  {
+    tc.setWallTime(gutil::ProcTime::monotonic()-t);
+    tc.print(out, format, "");
+  }
+
+  return 0;
+}
+
+/*
+ * Splits a command line into arguments. Arguments are separated by white
+ * space, which can be included by single or double quotes or by a preceding
+ * backslash.
+ */
+
+void splitCommandLine(std::vector<std::string> &list, const std::string &line)
+{
+  std::string arg;
+  bool  inarg=false;
+  char  quote=0;
+
+  for (size_t i=0; i<line.size(); i++)
+  {
+    char c=line[i];
+
+    if (quote != 0)
+    {
+      if (c == quote)
+      {
+        quote=0;
+      }
+      else if (c == '\\' && quote == '"' && i+1 < line.size() &&
+               (line[i+1] == '"' || line[i+1] == '\\'))
+      {
+        arg+=line[++i];
+      }
+      else
+      {
+        arg+=c;
+      }
+    }
+    else if (c == '\'' || c == '"')
+    {
+      quote=c;
+      inarg=true;
+    }
+    else if (c == '\\' && i+1 < line.size())
+    {
+      arg+=line[++i];
+      inarg=true;
+    }
+    else if (std::isspace(static_cast<unsigned char>(c)))
+    {
+      if (inarg)
+      {
+        list.push_back(arg);
+        arg.clear();
+        inarg=false;
+      }
+    }
+    else
+    {
+      arg+=c;
+      inarg=true;
+    }
+  }
+
+  if (quote != 0)
+  {
+    throw gutil::IOException("Missing closing quote: "+line);
+  }
+
+  if (inarg)
+  {
+    list.push_back(arg);
+  }
+}
+
+/*
+ * Reads command lines from stdin and executes them with the given number of
+ * threads. A status line in JSON format is written to stdout for each
+ * command as soon as it is finished. Image buffers, cached image
+ * information and loaded tiles are kept between commands.
+ */
+
+class CommandServer : public gutil::ThreadFunction
+{
+  private:
+
+    const char **def;
+    size_t maxqueue;
+
+    std::mutex mtx, outmtx;
+    std::condition_variable cv;
+    std::deque<std::pair<long, std::string> > queue;
+    bool eof;
+
+    CommandServer(const CommandServer &);
+    CommandServer &operator=(const CommandServer &);
+
+    void execute(long id, const std::string &line)
+    {
+      std::ostringstream out, err;
+      int    ret=10;
+      double t=gutil::ProcTime::monotonic();
+
+      try
+      {
+        std::vector<std::string> arg;
+        std::vector<char *> argv;
+
+        arg.push_back("imgcmd");
+        splitCommandLine(arg, line);
+
+        for (size_t i=0; i<arg.size(); i++)
+        {
+          argv.push_back(const_cast<char *>(arg[i].c_str()));
+        }
+
+        argv.push_back(0);
+
+        gutil::Parameter param(static_cast<int>(arg.size()), argv.data(), def);
+
+        if (param.remaining() < 1 || param.isNextParameter())
+        {
+          err << "The first parameter must be the image file name!" << std::endl;
+        }
+        else
+        {
+          ret=runCommand(param, out, err, false);
+        }
+      }
+      catch (const std::exception &ex)
+      {
+        err << ex.what() << std::endl;
+      }
+
+      t=gutil::ProcTime::monotonic()-t;
+
+      // errors are reported by the commands only via the error output
+
+      std::string status="ok";
+
+      if (ret != 0 || err.str().size() > 0)
+      {
+        status="error";
+      }
+
+      std::ostringstream os;
+
+      os << "{\"id\": " << id << ", \"status\": \"" << status << "\", \"seconds\": " << t
+         << ", \"output\": " << jsonString(out.str()) << ", \"error\": "
+         << jsonString(err.str()) << "}";
+
+      std::lock_guard<std::mutex> lock(outmtx);
+      std::cout << os.str() << std::endl;
+    }
+
+  public:
+
+    CommandServer(const char *_def[], int nthreads)
+    {
+      def=_def;
+      maxqueue=2*static_cast<size_t>(nthreads);
+      eof=false;
+    }
+
+    void run()
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+
+      while (true)
+      {
+        while (queue.size() == 0 && !eof)
+        {
+          cv.wait(lock);
+        }
+
+        if (queue.size() == 0)
+        {
+          return;
+        }
+
+        std::pair<long, std::string> cmd=queue.front();
+        queue.pop_front();
+
+        cv.notify_all();
+        lock.unlock();
+
+        execute(cmd.first, cmd.second);
+
+        lock.lock();
+      }
+    }
+
+    /**
+     * Reads all commands from stdin and executes them. Empty lines are
+     * skipped. The id of each command is its line number.
+     */
+
+    void process(int nthreads)
+    {
+      std::vector<std::unique_ptr<gutil::Thread> > thread;
+
+      for (int i=0; i<nthreads; i++)
+      {
+        thread.push_back(std::unique_ptr<gutil::Thread>(new gutil::Thread()));
+        thread.back()->create(*this);
+      }
+
+      std::string line;
+      long id=0;
+
+      while (std::getline(std::cin, line))
+      {
+        id++;
+
+        gutil::trim(line);
+
+        if (line.size() > 0)
+        {
+          std::unique_lock<std::mutex> lock(mtx);
+
+          while (queue.size() >= maxqueue)
+          {
+            cv.wait(lock);
+          }
+
+          queue.push_back(std::make_pair(id, line));
+          cv.notify_all();
+        }
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        eof=true;
+      }
+
+      cv.notify_all();
+
+      for (size_t i=0; i<thread.size(); i++)
+      {
+        thread[i]->join();
+      }
+    }
+};
+
+}
+
+int main(int argc, char *argv[])
+{
+  // command line definition
+
+  const char *def[]=
+  {
+    "# imgcmd [-help | -version | -server <n>] <in> [<options>]",
+    "#",
+    "# The input and output names may contain the wildcard '%'.",
+    "#",
+    "# Images with more than CVKIT_STREAM_MPIXEL mega pixels (default 64, 0 for all images) are read, processed and stored in bands of rows, if all options only work on individual rows and the result is stored.",
+    "#",
+
+    "-help # Print help and exit.",
 
     "-version # Print version and exit.",
 
+    "-server # Reads commands from stdin, one per line with the same syntax as the parameters of imgcmd, but without -server. A JSON status line with id (i.e. line number), status (ok or error), seconds, output and error is written to stdout for every finished command.",
+    " <n> # Number of commands that are executed concurrently.",
+
+    "#",
+    "# The following options must directly follow <in>.",
+    "#",
+
+    "-threads # Processes the files of a name with wildcard in parallel. The printed results are given in the order of the file names.",
+    " <n> # Number of files that are processed at the same time.",
+
+    "-memory # Limits the number of files that are processed in parallel by their estimated memory consumption.",
+    " <mb> # Memory budget in mega bytes. Default is 4096.",
+
+    "-timing # Prints wall time, throughput and allocated image memory of loading, all options and saving for each file and summed up over all files.",
+    " table|json # Output format.",
+
     "#",
     "# All options are processed strictly in the order in which they appear on the command line. All options may appear multiple times. Options are:",
     "#",
@@ -499,6 +1858,10 @@ int main(int argc, char *argv[])
     "-dsm # Downscaling the image by computing the median.",
     " <ds> # Integer downscale factor.",
 
+    "-resize # Resampling the image to the given size.",
+    " <w> <h> # Width and height of the resulting image.",
+    " <kernel> # Interpolation kernel: bilinear, area or lanczos3.",
+
     "-crop # Selecting a part of the image.",
     " <x> <y> # Left upper corner of the image.",
     " <w> <h> # Width and height of the image.",
@@ -578,7 +1941,15 @@ int main(int argc, char *argv[])
     return 10;
   }
 
-  // check if the first two parameters are -help or -version
+  // keep released image buffers for reuse in subsequent processing steps,
+  // unless the capacity of the buffer pool is explicitly given
+
+  if (std::getenv("CVKIT_BUFFER_POOL") == 0)
+  {
+    gimage::getBufferPool().setCapacity(static_cast<size_t>(1024)<<20);
+  }
+
+  // check if the first two parameters are -help, -version or -server
 
   std::string p;
 
@@ -596,119 +1967,28 @@ int main(int argc, char *argv[])
       std::cout << "This program is part of cvkit version " << VERSION << std::endl;
       return 0;
     }
-    else
+    else if (p == "-server")
     {
-      std::cerr << "The first parameter must be the image file name!" << std::endl;
-      return 10;
-    }
-  }
-
-  // get name
-
-  std::string prefix, suffix;
-
-  param.nextString(prefix);
+      int n;
 
-  // read first two parameters, if they are -ds and -crop,
-  // because this can be considered while loading
+      param.nextValue(n);
+      n=std::max(1, n);
 
-  std::set<std::string> list;
-  int  ds=1;
-  long x=0, y=0, w=-1, h=-1;
-
-  if (param.remaining() > 0)
-  {
-    param.nextParameter(p);
+      // divide the threads for processing single images among the commands
 
-    if (p == "-ds")
-    {
-      param.nextValue(ds);
-      ds=std::max(1, ds);
-    }
-    else
-    {
-      param.previous();
-    }
-  }
+      ThreadShare share(n);
 
-  if (param.remaining() > 0)
-  {
-    param.nextParameter(p);
+      CommandServer server(def, n);
+      server.process(n);
 
-    if (p == "-crop")
-    {
-      param.nextValue(x);
-      param.nextValue(y);
-      param.nextValue(w);
-      param.nextValue(h);
+      return 0;
     }
     else
     {
-      param.previous();
-    }
-  }
-
-  // determine list of files if the pattern character '%' is found in the
-  // file name
-
-  size_t pos=prefix.find('%');
-
-  if (pos < prefix.size())
-  {
-    suffix=prefix.substr(pos+1);
-    prefix=prefix.substr(0, pos);
-    gutil::getFileList(list, prefix, suffix);
-  }
-  else
-  {
-    list.insert(prefix);
-  }
-
-  // try loading with increasing data type and start processing using
-  // remainder of the command line
-
-  for (std::set<std::string>::iterator it=list.begin(); it!=list.end(); ++it)
-  {
-    if (list.size() > 1)
-    {
-      std::cout << *it << ":" << std::endl;
-    }
-
-    std::string repl=it->substr(prefix.size(), it->size()-prefix.size()-
-                                suffix.size());
-
-    try
-    {
-      gimage::ImageU8 image;
-
-      gimage::getImageIO().load(image, it->c_str(), ds, x, y, w, h);
-      process(image, param, repl);
-    }
-    catch (const std::exception &)
-    {
-      try
-      {
-        gimage::ImageU16 image;
-
-        gimage::getImageIO().load(image, it->c_str(), ds, x, y, w, h);
-        process(image, param, repl);
-      }
-      catch (const std::exception &)
-      {
-        try
-        {
-          gimage::ImageFloat image;
-
-          gimage::getImageIO().load(image, it->c_str(), ds, x, y, w, h);
-          process(image, param, repl);
-        }
-        catch (const gutil::Exception &ex)
-        {
-          ex.print();
-        }
-      }
+      std::cerr << "The first parameter must be the image file name!" << std::endl;
+      return 10;
     }
   }
 
-  return 0;
+  return runCommand(param, std::cout, std::cerr, true);
 }
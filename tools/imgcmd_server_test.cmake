@@ -0,0 +1,109 @@
+# This file is part of the Computer Vision Toolkit (cvkit).
+#
+# Author: Heiko Hirschmueller
+#
+# Copyright (c) 2014, Institute of Robotics and Mechatronics, German Aerospace Center
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors
+# may be used to endorse or promote products derived from this software without
+# specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# Runs imgcmd in server mode with the number of threads given by threads on
+# a list of commands and checks the status lines. Called by ctest with
+# -Dimgcmd=<program> -Dtest_image=<image> -Dtmp=<directory> -Dthreads=<n>.
+
+file(MAKE_DIRECTORY ${tmp})
+file(REMOVE "${tmp}/crop out.ppm")
+
+# line 2 is empty and skipped, lines 4 and 5 must fail, line 6 uses a
+# quoted file name and lines 7 to 26 are the same command
+
+set(commands
+  "${test_image} -print width\n"
+  "\n"
+  "${test_image} -ds 2 -print width\n"
+  "${tmp}/missing.ppm -print width\n"
+  "${test_image} -undefined\n"
+  "${test_image} -crop 10 20 30 40 -out \"${tmp}/crop out.ppm\"\n"
+)
+
+foreach (i RANGE 7 26)
+  list(APPEND commands "${test_image} -ds 3 -print height\n")
+endforeach ()
+
+string(REPLACE ";" "" commands "${commands}")
+file(WRITE ${tmp}/commands.txt "${commands}")
+
+execute_process(COMMAND ${imgcmd} -server ${threads}
+  INPUT_FILE ${tmp}/commands.txt
+  OUTPUT_VARIABLE out
+  ERROR_VARIABLE err
+  RESULT_VARIABLE ret)
+
+if (NOT ret EQUAL 0)
+  message(FATAL_ERROR "imgcmd -server returned ${ret}: ${err}")
+endif ()
+
+# one status line for every non-empty command line
+
+string(REGEX MATCHALL "{\"id\": [0-9]+, [^\n]*}\n" lines "${out}")
+list(LENGTH lines n)
+
+if (NOT n EQUAL 25)
+  message(FATAL_ERROR "Expected 25 status lines, got ${n}:\n${out}")
+endif ()
+
+function(check_line id regex)
+  string(REGEX MATCH "{\"id\": ${id}, [^\n]*" line "${out}")
+
+  if (NOT line MATCHES "${regex}")
+    message(FATAL_ERROR "Unexpected status of command ${id}: ${line}")
+  endif ()
+endfunction()
+
+check_line(1 "\"status\": \"ok\".*\"output\": \"width=912\\\\u000a\", \"error\": \"\"")
+check_line(3 "\"status\": \"ok\".*\"output\": \"width=456\\\\u000a\"")
+check_line(4 "\"status\": \"error\".*\"error\": \"[^\"]+\"")
+check_line(5 "\"status\": \"error\".*\"error\": \".*-undefined")
+check_line(6 "\"status\": \"ok\"")
+
+foreach (i RANGE 7 26)
+  check_line(${i} "\"status\": \"ok\".*\"output\": \"height=228\\\\u000a\"")
+endforeach ()
+
+if (out MATCHES "{\"id\": 2,")
+  message(FATAL_ERROR "Empty line 2 must be skipped:\n${out}")
+endif ()
+
+# the image with the quoted name has been written
+
+execute_process(COMMAND ${imgcmd} "${tmp}/crop out.ppm" -print all
+  OUTPUT_VARIABLE out
+  RESULT_VARIABLE ret)
+
+if (NOT ret EQUAL 0 OR NOT out MATCHES "width=30\nheight=40\ndepth=3")
+  message(FATAL_ERROR "Cropped image is missing or wrong: ${out}")
+endif ()